@@ -0,0 +1,448 @@
+#ifndef _ADMIN_BATCH_
+#define _ADMIN_BATCH_
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <cctype>
+#include <climits>
+#include "Vending_Machine.h"
+#include "MachineStore.h"
+
+using namespace std;
+
+//what an admin command does
+enum AdminOp {
+	ADMIN_RESTOCK = 0,  //add units to a slot
+	ADMIN_PRICE,        //change the price of a slot
+	ADMIN_RESET,        //empty one slot or every slot
+	ADMIN_FUNDS         //add cash to the machine
+};
+
+//result of one command
+enum AdminStatus {
+	ADMIN_PENDING = 0,  //read, not applied yet
+	ADMIN_OK,           //applied
+	ADMIN_ERROR,        //bad command, nothing of its machine was applied
+	ADMIN_SKIPPED       //valid, but another command of the same machine was bad
+};
+
+//one line of a batch
+struct AdminCommand {
+	int line;           //line number in the input
+	int machine;        //machine number, 0 if the line did not name a valid machine
+	int op;             //AdminOp
+	int slot;           //1-based, 0 for every slot (RESET *) and for FUNDS
+	int units;          //RESTOCK
+	long long expiry;   //RESTOCK, 0 if the units do not expire
+	double amount;      //PRICE and FUNDS
+	int status;         //AdminStatus
+	string detail;      //what was done, or why not
+};
+
+/*
+ * Batch admin commands, one per line, for any number of machines:
+ *   <machine> RESTOCK <slot> <units> [expiry]   add units, expiry in seconds since 1970
+ *   <machine> PRICE <slot> <price>
+ *   <machine> RESET <slot>|*                     empty one slot or every slot
+ *   <machine> FUNDS <amount>
+ * Blank lines and lines starting with # are ignored.
+ *
+ * Every command is checked against the machine as it would be after the
+ * commands before it (a slot cannot be overfilled, a slot with held units
+ * cannot be reset). Commands are then grouped by machine and each machine
+ * takes its group in one pass, in input order, publishing a single new
+ * version at the end, so readers see all of it or none of it. A machine with
+ * any bad command applies nothing; the other machines are not affected.
+ *
+ * The machines come from a MachineStore: each machine is read from disk when
+ * its group is applied and released right after, so a batch can address a
+ * fleet far larger than memory.
+ */
+class AdminBatch {
+	private:
+		MachineStore* store;        //machines kept on disk
+		vector<AdminCommand> commands;
+		int numLines;               //lines read, blank lines and comments included
+		int numApplied;
+		int numErrors;
+		int numSkipped;
+
+		void parseLine(const string& text, int line);
+		bool hasMachine(long long id) const;
+		VendingMachine* acquire(int id);         //nullptr if the store cannot read it
+		void release(int id);
+		bool check(AdminCommand& c, VendingMachine* vm, vector<int>& stock) const;  //against the simulated stock of its machine
+		void execute(AdminCommand& c, VendingMachine* vm);
+		static bool readInt(const string& token, long long& value);
+		static bool readAmount(const string& token, double& value);
+
+		AdminBatch(const AdminBatch&);
+		AdminBatch& operator=(const AdminBatch&);
+
+	public:
+		AdminBatch(MachineStore* machineStore);
+
+		int load(istream& in);                   //read every command, returns how many
+		int addLine(const string& text);         //read one command, returns its index, -1 if blank or a comment
+		int apply();                             //check and apply everything loaded, returns commands applied
+		void printReport(ostream& out) const;    //one line per command, then the totals
+		void clear();
+
+		const vector<AdminCommand>& getCommands() const;
+		int getNumApplied() const;
+		int getNumErrors() const;
+		int getNumSkipped() const;
+};
+
+//------------------------------------------------------------------constructor-----------------------------------------------------------------
+AdminBatch::AdminBatch(MachineStore* machineStore) {
+	if (machineStore == nullptr) {
+		throw invalid_argument("Admin batch needs a machine store!");
+	}
+
+	store = machineStore;
+	numLines = 0;
+	numApplied = 0;
+	numErrors = 0;
+	numSkipped = 0;
+}
+
+//-----------------------------------------------------------------parsing-----------------------------------------------------------------
+int AdminBatch::load(istream& in) {
+	string text;
+	int read = 0;
+
+	while (getline(in, text)) {
+		if (!text.empty() && text[text.size() - 1] == '\r') {
+			text.erase(text.size() - 1);
+		}
+		if (addLine(text) >= 0) {
+			read++;
+		}
+	}
+	return read;
+}
+
+int AdminBatch::addLine(const string& text) {
+	size_t first = text.find_first_not_of(" \t");
+	numLines++;
+	if (first == string::npos || text[first] == '#') {
+		return -1;
+	}
+
+	parseLine(text, numLines);
+	return (int)commands.size() - 1;
+}
+
+void AdminBatch::parseLine(const string& text, int line) {
+	AdminCommand c;
+	c.line = line;
+	c.machine = 0;
+	c.op = ADMIN_RESTOCK;
+	c.slot = 0;
+	c.units = 0;
+	c.expiry = 0;
+	c.amount = 0.0;
+	c.status = ADMIN_PENDING;
+
+	//split into at most six words, anything past that is an error
+	vector<string> words;
+	for (size_t pos = 0; words.size() < 6; ) {
+		size_t start = text.find_first_not_of(" \t", pos);
+		if (start == string::npos) {
+			break;
+		}
+		pos = text.find_first_of(" \t", start);
+		words.push_back(text.substr(start, (pos == string::npos) ? string::npos : pos - start));
+	}
+
+	long long value = 0;
+	if (words.size() < 2 || !readInt(words[0], value)) {
+		c.status = ADMIN_ERROR;
+		c.detail = "expected <machine> <command>";
+	}
+	else if (!hasMachine(value)) {
+		c.status = ADMIN_ERROR;
+		c.detail = "no machine " + words[0];
+	}
+	else {
+		c.machine = (int)value;
+
+		string op = words[1];
+		for (size_t i = 0; i < op.size(); i++) {
+			op[i] = toupper(op[i]);
+		}
+
+		int args = (int)words.size() - 2;
+		long long slot = 1, units = 0;
+		if (op == "RESTOCK" && (args == 2 || args == 3)) {
+			c.op = ADMIN_RESTOCK;
+			if (!readInt(words[2], slot) || !readInt(words[3], units) || (args == 3 && !readInt(words[4], c.expiry))) {
+				c.status = ADMIN_ERROR;
+				c.detail = "expected RESTOCK <slot> <units> [expiry]";
+			}
+		}
+		else if (op == "PRICE" && args == 2) {
+			c.op = ADMIN_PRICE;
+			if (!readInt(words[2], slot) || !readAmount(words[3], c.amount)) {
+				c.status = ADMIN_ERROR;
+				c.detail = "expected PRICE <slot> <price>";
+			}
+		}
+		else if (op == "RESET" && args == 1) {
+			c.op = ADMIN_RESET;
+			if (words[2] == "*") {
+				slot = 0;
+			}
+			else if (!readInt(words[2], slot)) {
+				c.status = ADMIN_ERROR;
+				c.detail = "expected RESET <slot>|*";
+			}
+		}
+		else if (op == "FUNDS" && args == 1) {
+			c.op = ADMIN_FUNDS;
+			slot = 0;
+			if (!readAmount(words[2], c.amount)) {
+				c.status = ADMIN_ERROR;
+				c.detail = "expected FUNDS <amount>";
+			}
+		}
+		else if (op == "RESTOCK" || op == "PRICE" || op == "RESET" || op == "FUNDS") {
+			c.status = ADMIN_ERROR;
+			c.detail = "wrong number of arguments for " + op;
+		}
+		else {
+			c.status = ADMIN_ERROR;
+			c.detail = "unknown command " + words[1];
+		}
+
+		if (c.status == ADMIN_PENDING && (slot < 0 || (slot == 0 && c.op != ADMIN_FUNDS && words[2] != "*") || slot > 1000000)) {
+			c.status = ADMIN_ERROR;
+			c.detail = "no slot " + words[2];
+		}
+		c.slot = (int)slot;
+		c.units = (units < 0) ? -1 : (units > 1000000) ? 1000000 : (int)units; //larger than any slot either way
+	}
+
+	commands.push_back(c);
+}
+
+bool AdminBatch::readInt(const string& token, long long& value) {
+	char* end = nullptr;
+	value = strtoll(token.c_str(), &end, 10);
+	return !token.empty() && *end == '\0';
+}
+
+bool AdminBatch::readAmount(const string& token, double& value) {
+	char* end = nullptr;
+	value = strtod(token.c_str(), &end);
+	return !token.empty() && *end == '\0' && value - value == 0.0; //no trailing text, not NaN or infinite
+}
+
+//-----------------------------------------------------------------machines-----------------------------------------------------------------
+bool AdminBatch::hasMachine(long long id) const {
+	return id > 0 && id <= INT_MAX && store->contains((int)id);
+}
+
+VendingMachine* AdminBatch::acquire(int id) {
+	return store->acquire(id);
+}
+
+void AdminBatch::release(int id) {
+	store->release(id);
+}
+
+//-----------------------------------------------------------------applying-----------------------------------------------------------------
+bool AdminBatch::check(AdminCommand& c, VendingMachine* vm, vector<int>& stock) const {
+	int numQueue = vm->getNumQueue();
+	ostringstream msg;
+
+	if (c.slot > numQueue) {
+		msg << "no slot " << c.slot << " (machine has " << numQueue << ")";
+	}
+	else if (c.op == ADMIN_RESTOCK) {
+		int space = vm->getItem(c.slot - 1).getMaxSize() - stock[c.slot - 1];
+		if (c.units <= 0) {
+			msg << "units must be positive";
+		}
+		else if (c.units > space) {
+			msg << "only " << space << " units fit in slot " << c.slot;
+		}
+		else if (c.expiry < 0) {
+			msg << "bad expiry";
+		}
+		else {
+			stock[c.slot - 1] += c.units;
+		}
+	}
+	else if (c.op == ADMIN_PRICE && c.amount <= 0) {
+		msg << "price must be positive";
+	}
+	else if (c.op == ADMIN_FUNDS && c.amount <= 0) {
+		msg << "amount must be positive";
+	}
+	else if (c.op == ADMIN_RESET) {
+		int first = (c.slot == 0) ? 1 : c.slot;
+		int last = (c.slot == 0) ? numQueue : c.slot;
+		for (int s = first; s <= last; s++) {
+			int held = vm->getItem(s - 1).getNumStockQ() - vm->getAvailableStock(s);
+			if (held > 0) {
+				msg << held << " units of slot " << s << " are held by a customer";
+				break;
+			}
+		}
+		if (msg.str().empty()) {
+			for (int s = first; s <= last; s++) {
+				stock[s - 1] = 0;
+			}
+		}
+	}
+
+	if (!msg.str().empty()) {
+		c.status = ADMIN_ERROR;
+		c.detail = msg.str();
+		return false;
+	}
+	return true;
+}
+
+void AdminBatch::execute(AdminCommand& c, VendingMachine* vm) {
+	ostringstream msg;
+
+	if (c.op == ADMIN_RESTOCK) {
+		int added = vm->restockItem(c.slot, c.units, c.expiry);
+		msg << "added " << added << ", stock " << vm->getItem(c.slot - 1).getNumStockQ();
+	}
+	else if (c.op == ADMIN_PRICE) {
+		vm->setItemPrice(c.slot, c.amount);
+		msg << "price RM " << fixed << setprecision(2) << c.amount;
+	}
+	else if (c.op == ADMIN_RESET) {
+		int removed = 0;
+		for (int s = (c.slot == 0 ? 1 : c.slot); s <= (c.slot == 0 ? vm->getNumQueue() : c.slot); s++) {
+			removed += vm->clearItem(s);
+		}
+		msg << "removed " << removed;
+	}
+	else {
+		vm->addMoney(c.amount);
+		msg << "funds RM " << fixed << setprecision(2) << vm->getTotalMoney();
+	}
+
+	c.status = ADMIN_OK;
+	c.detail = msg.str();
+}
+
+int AdminBatch::apply() {
+	//group by machine, input order within a machine
+	map<int, vector<int> > byMachine;
+	for (size_t i = 0; i < commands.size(); i++) {
+		if (commands[i].machine > 0 && (commands[i].status == ADMIN_PENDING || commands[i].status == ADMIN_ERROR)) {
+			byMachine[commands[i].machine].push_back((int)i); //errors from parsing reject their machine too
+		}
+	}
+
+	for (map<int, vector<int> >::iterator it = byMachine.begin(); it != byMachine.end(); ++it) {
+		int m = it->first;
+		const vector<int>& group = it->second;
+
+		VendingMachine* vm = acquire(m);
+		if (vm == nullptr) {
+			for (size_t k = 0; k < group.size(); k++) {
+				AdminCommand& c = commands[group[k]];
+				if (c.status == ADMIN_PENDING) {
+					c.status = ADMIN_ERROR;
+					c.detail = "machine " + to_string(m) + " could not be loaded";
+				}
+			}
+			continue;
+		}
+
+		//check the whole group first, against the stock each command leaves behind
+		vector<int> stock(vm->getNumQueue());
+		for (int s = 0; s < (int)stock.size(); s++) {
+			stock[s] = vm->getItem(s).getNumStockQ();
+		}
+
+		int firstBad = 0;
+		for (size_t k = 0; k < group.size(); k++) {
+			AdminCommand& c = commands[group[k]];
+			if (c.status == ADMIN_PENDING) {
+				check(c, vm, stock);
+			}
+			if (c.status == ADMIN_ERROR && firstBad == 0) {
+				firstBad = c.line;
+			}
+		}
+
+		if (firstBad > 0) {
+			for (size_t k = 0; k < group.size(); k++) {
+				AdminCommand& c = commands[group[k]];
+				if (c.status == ADMIN_PENDING) {
+					c.status = ADMIN_SKIPPED;
+					c.detail = "machine " + to_string(m) + " rejected, see line " + to_string(firstBad);
+				}
+			}
+			release(m);
+			continue;
+		}
+
+		//one pass, one published version
+		vm->beginUpdate();
+		for (size_t k = 0; k < group.size(); k++) {
+			execute(commands[group[k]], vm);
+		}
+		vm->endUpdate();
+		release(m);
+	}
+
+	numApplied = numErrors = numSkipped = 0;
+	for (size_t i = 0; i < commands.size(); i++) {
+		numApplied += (commands[i].status == ADMIN_OK);
+		numErrors += (commands[i].status == ADMIN_ERROR);
+		numSkipped += (commands[i].status == ADMIN_SKIPPED);
+	}
+	return numApplied;
+}
+
+void AdminBatch::clear() {
+	commands.clear();
+	numLines = 0;
+	numApplied = 0;
+	numErrors = 0;
+	numSkipped = 0;
+}
+
+//-----------------------------------------------------------------report-----------------------------------------------------------------
+void AdminBatch::printReport(ostream& out) const {
+	for (size_t i = 0; i < commands.size(); i++) {
+		const AdminCommand& c = commands[i];
+		const char* status = (c.status == ADMIN_OK) ? "OK" : (c.status == ADMIN_ERROR) ? "ERROR" : (c.status == ADMIN_SKIPPED) ? "SKIPPED" : "PENDING";
+		out << c.line << '\t' << status << '\t' << c.detail << '\n';
+	}
+	out << "BATCH " << commands.size() << " commands, " << numApplied << " applied, "
+		<< numErrors << " errors, " << numSkipped << " skipped" << endl;
+}
+
+const vector<AdminCommand>& AdminBatch::getCommands() const {
+	return commands;
+}
+
+int AdminBatch::getNumApplied() const {
+	return numApplied;
+}
+
+int AdminBatch::getNumErrors() const {
+	return numErrors;
+}
+
+int AdminBatch::getNumSkipped() const {
+	return numSkipped;
+}
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef _AGGREGATE_
+#define _AGGREGATE_
+
+#include <windows.h>
+#include <atomic>
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+//running totals of one machine (or of a fleet), reading them is O(1)
+struct MachineTotals {
+	int machines;        //machines counted, 1 for a single machine
+	long long stock;     //units in stock
+	double money;        //cash inside, RM
+	long long sold;      //units sold
+	double revenue;      //money taken for sales, RM
+};
+
+//told about every change to the stock of an item, implemented by VendingMachine
+class StockListener {
+	public:
+		virtual ~StockListener() {}
+		virtual void stockChanged(int itemOpt, int delta) = 0;   //stock of a slot (1-based) changed by delta
+		virtual void priceChanged(int, double) {}               //price of a slot (1-based) changed
+		virtual void nameChanged(int) {}                        //name of a slot (1-based) changed
+};
+
+/*
+ * Live totals of many machines. Every machine pushes its changes here as
+ * deltas, so reading the fleet totals never walks the machines. Money is
+ * kept in whole cents to allow atomic adds from machines on other threads.
+ * rollUp() rebuilds the same totals from the machines with a parallel
+ * reduction; the server seeds and re-checks the live totals with resync().
+ */
+class FleetAggregate {
+	private:
+		atomic<int> machines;
+		atomic<long long> stock;
+		atomic<long long> moneyCents;
+		atomic<long long> sold;
+		atomic<long long> revenueCents;
+
+		static long long toCents(double amount);
+
+		template <class Machine>
+		struct Chunk {
+			Machine* const* machines;   //first machine of the chunk
+			int count;
+			MachineTotals result;
+		};
+
+		template <class Machine>
+		static DWORD WINAPI reduceChunk(LPVOID arg);
+		template <class Machine>
+		static void reduce(Chunk<Machine>& chunk);
+
+	public:
+		FleetAggregate();
+
+		void join(const MachineTotals& totals);                 //a machine starts reporting
+		void leave(const MachineTotals& totals);                //a machine stops reporting
+		void addStock(int delta);
+		void addMoney(double amount);
+		void addSale(double price, bool cash = true);           //one unit sold, the price is revenue, and money if paid in cash
+
+		MachineTotals getTotals() const;                        //live totals, O(1)
+
+		template <class Machine>
+		static MachineTotals rollUp(Machine* const* machines, int count, int numThreads); //sum getTotals() of every machine
+		template <class Machine>
+		void resync(Machine* const* machines, int count, int numThreads); //replace the live totals with a roll-up
+};
+
+//------------------------------------------------------------------constructor-----------------------------------------------------------------
+FleetAggregate::FleetAggregate() {
+	machines = 0;
+	stock = 0;
+	moneyCents = 0;
+	sold = 0;
+	revenueCents = 0;
+}
+
+long long FleetAggregate::toCents(double amount) {
+	return (long long)floor(amount * 100.0 + 0.5);
+}
+
+//-----------------------------------------------------------------deltas-----------------------------------------------------------------
+void FleetAggregate::join(const MachineTotals& totals) {
+	machines += totals.machines;
+	stock += totals.stock;
+	moneyCents += toCents(totals.money);
+	sold += totals.sold;
+	revenueCents += toCents(totals.revenue);
+}
+
+void FleetAggregate::leave(const MachineTotals& totals) {
+	machines -= totals.machines;
+	stock -= totals.stock;
+	moneyCents -= toCents(totals.money);
+	sold -= totals.sold;
+	revenueCents -= toCents(totals.revenue);
+}
+
+void FleetAggregate::addStock(int delta) {
+	stock += delta;
+}
+
+void FleetAggregate::addMoney(double amount) {
+	moneyCents += toCents(amount);
+}
+
+void FleetAggregate::addSale(double price, bool cash) {
+	long long cents = toCents(price);
+	if (cash) {
+		moneyCents += cents;
+	}
+	revenueCents += cents;
+	sold++;
+}
+
+MachineTotals FleetAggregate::getTotals() const {
+	MachineTotals t;
+	t.machines = machines.load();
+	t.stock = stock.load();
+	t.money = moneyCents.load() / 100.0;
+	t.sold = sold.load();
+	t.revenue = revenueCents.load() / 100.0;
+	return t;
+}
+
+//-----------------------------------------------------------------roll-up-----------------------------------------------------------------
+template <class Machine>
+void FleetAggregate::reduce(Chunk<Machine>& chunk) {
+	long long moneyTotal = 0;
+	long long revenueTotal = 0;
+	MachineTotals& r = chunk.result;
+
+	r.machines = 0;
+	r.stock = 0;
+	r.sold = 0;
+	for (int i = 0; i < chunk.count; i++) {
+		MachineTotals t = chunk.machines[i]->getTotals();
+		r.machines += t.machines;
+		r.stock += t.stock;
+		r.sold += t.sold;
+		moneyTotal += toCents(t.money);
+		revenueTotal += toCents(t.revenue);
+	}
+	r.money = moneyTotal / 100.0;
+	r.revenue = revenueTotal / 100.0;
+}
+
+template <class Machine>
+DWORD WINAPI FleetAggregate::reduceChunk(LPVOID arg) {
+	reduce(*static_cast<Chunk<Machine>*>(arg));
+	return 0;
+}
+
+template <class Machine>
+MachineTotals FleetAggregate::rollUp(Machine* const* machines, int count, int numThreads) {
+	if (numThreads < 1) {
+		numThreads = 1;
+	}
+	if (numThreads > count) {
+		numThreads = (count > 0) ? count : 1;
+	}
+
+	//one chunk per thread, the calling thread takes the first one
+	vector<Chunk<Machine> > chunks(numThreads);
+	vector<HANDLE> threads(numThreads, (HANDLE)NULL);
+	int per = count / numThreads;
+	int extra = count % numThreads;
+	int next = 0;
+
+	for (int i = 0; i < numThreads; i++) {
+		chunks[i].machines = machines + next;
+		chunks[i].count = per + (i < extra ? 1 : 0);
+		next += chunks[i].count;
+
+		if (i > 0) {
+			threads[i] = CreateThread(NULL, 0, reduceChunk<Machine>, &chunks[i], 0, NULL);
+			if (threads[i] == NULL) {
+				reduce(chunks[i]); //no thread available, do it here
+			}
+		}
+	}
+	reduce(chunks[0]);
+
+	//combine the partial totals
+	MachineTotals total = chunks[0].result;
+	long long moneyTotal = toCents(total.money);
+	long long revenueTotal = toCents(total.revenue);
+	for (int i = 1; i < numThreads; i++) {
+		if (threads[i] != NULL) {
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+		total.machines += chunks[i].result.machines;
+		total.stock += chunks[i].result.stock;
+		total.sold += chunks[i].result.sold;
+		moneyTotal += toCents(chunks[i].result.money);
+		revenueTotal += toCents(chunks[i].result.revenue);
+	}
+	total.money = moneyTotal / 100.0;
+	total.revenue = revenueTotal / 100.0;
+
+	return total;
+}
+
+template <class Machine>
+void FleetAggregate::resync(Machine* const* machines, int count, int numThreads) {
+	MachineTotals t = rollUp(machines, count, numThreads);
+	this->machines = t.machines;
+	stock = t.stock;
+	moneyCents = toCents(t.money);
+	sold = t.sold;
+	revenueCents = toCents(t.revenue);
+}
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef _ALERT_
+#define _ALERT_
+
+#include <windows.h>
+#include <vector>
+#include "Queue.h"
+
+using namespace std;
+
+//kinds of stock alerts
+enum AlertType {
+	ALERT_LOW_STOCK = 0,   //stock fell to the slot's threshold or below
+	ALERT_SOLD_OUT,        //last unit left the slot
+	ALERT_RESTOCKED        //stock rose above the threshold again
+};
+
+//one threshold crossing of a slot
+struct StockAlert {
+	int type;          //AlertType
+	int machine;       //machine id
+	int slot;          //item slot (1-based)
+	int stock;         //stock after the change
+	long long time;    //seconds since 1970
+};
+
+/*
+ * Alerts waiting for the back office. Machines post when a slot crosses a
+ * threshold, subscribers drain the queue when they get to it, possibly from
+ * another thread. The queue grows when full instead of dropping alerts.
+ */
+class AlertQueue {
+	private:
+		CRITICAL_SECTION lock;
+		Queue<StockAlert> alerts;
+
+		AlertQueue(const AlertQueue&);              //not copyable, owns the lock
+		AlertQueue& operator=(const AlertQueue&);
+
+	public:
+		AlertQueue(int capacity = 256);
+		~AlertQueue();
+
+		void post(const StockAlert& alert);         //add one alert
+		int drain(vector<StockAlert>& out);         //move every waiting alert to out, returns how many
+		int size();                                 //number of waiting alerts
+
+		static const char* getTypeName(int type);   //LOW_STOCK, SOLD_OUT or RESTOCKED
+};
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+AlertQueue::AlertQueue(int capacity) : alerts(capacity) {
+	InitializeCriticalSection(&lock);
+}
+
+AlertQueue::~AlertQueue() {
+	DeleteCriticalSection(&lock);
+}
+
+//-----------------------------------------------------------------alerts-----------------------------------------------------------------
+void AlertQueue::post(const StockAlert& alert) {
+	EnterCriticalSection(&lock);
+	if (alerts.isFull()) {
+		alerts.reserve(alerts.getCapacity() * 2);
+	}
+	alerts.enqueue(alert);
+	LeaveCriticalSection(&lock);
+}
+
+int AlertQueue::drain(vector<StockAlert>& out) {
+	EnterCriticalSection(&lock);
+	int count = alerts.getNumItem();
+	size_t first = out.size();
+	out.resize(first + count);
+	if (count > 0) {
+		alerts.dequeue_n(&out[first], count);
+	}
+	LeaveCriticalSection(&lock);
+	return count;
+}
+
+int AlertQueue::size() {
+	EnterCriticalSection(&lock);
+	int count = alerts.getNumItem();
+	LeaveCriticalSection(&lock);
+	return count;
+}
+
+const char* AlertQueue::getTypeName(int type) {
+	switch (type) {
+		case ALERT_LOW_STOCK: return "LOW_STOCK";
+		case ALERT_SOLD_OUT:  return "SOLD_OUT";
+		default:              return "RESTOCKED";
+	}
+}
+
+#endif
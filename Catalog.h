@@ -0,0 +1,278 @@
+#ifndef _CATALOG_
+#define _CATALOG_
+
+#include <windows.h>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "Epoch.h"
+
+using namespace std;
+
+//one item line of the catalog file
+struct CatalogEntry {
+	string name;     //item name, max 15 characters
+	double price;    //price in RM
+	int stock;       //starting stock, only used when the item is first added to a machine
+	int depth;       //slot capacity, 0 if the line has none (new slots take the default, existing ones keep theirs)
+};
+
+/*
+ * Immutable set of names and prices. A new Catalog object is built for every
+ * change and published as a whole, so a reader always sees one consistent
+ * version.
+ *
+ * File format, one item per line, '#' starts a comment:
+ *   title=INTI Vending Machine
+ *   Cola, 1.50, 19
+ *   Water, 1.20, 10, 30       optional fourth column: slot depth
+ */
+class Catalog {
+	public:
+		string title;                  //machine title, empty keeps the current one
+		vector<CatalogEntry> entries;  //item per slot, in slot order
+		unsigned long version;         //increases with every published catalog
+
+		Catalog();
+		static bool loadFile(const string& path, Catalog& catalog, string& error); //parse a catalog file
+};
+
+/*
+ * Watches the catalog file and publishes every valid new version with one
+ * atomic pointer swap. Readers (the machines) never lock: they load the
+ * current pointer inside an epoch section and copy what changed. Old versions
+ * are freed by the watcher once no machine can still be reading them.
+ */
+class CatalogWatcher {
+	private:
+		string path;                   //catalog file
+		string directory;              //folder watched for changes
+		FILETIME lastWrite;            //write time of the last loaded file
+		atomic<Catalog*> current;      //published catalog, nullptr until the first load
+		atomic<unsigned long> publishedVersion; //version of current, readable without entering
+		atomic<bool> running;
+		EpochDomain epochs;            //reclaims old catalogs
+		HANDLE thread;
+		unsigned long nextVersion;
+		unsigned long waitMs;          //how often the thread checks for stop()
+
+		static DWORD WINAPI threadMain(LPVOID arg);
+
+	public:
+		CatalogWatcher(const string& file, unsigned long wait = 100);
+		~CatalogWatcher();
+
+		bool checkNow();                         //reload if the file changed, true if a new version was published (not while started)
+		bool start();                            //watch the file in a background thread
+		void stop();
+
+		int registerReader();                    //reader slot for a machine
+		void unregisterReader(int reader);
+		const Catalog* enter(int reader);        //start reading, returns the current catalog (may be nullptr)
+		void exit(int reader);                   //done reading, the pointer must not be used after this
+		unsigned long getVersion() const;        //version of the published catalog, 0 if none
+};
+
+//-----------------------------------------------------------------catalog-----------------------------------------------------------------
+Catalog::Catalog() {
+	version = 0;
+}
+
+bool Catalog::loadFile(const string& path, Catalog& catalog, string& error) {
+	ifstream file(path.c_str());
+	if (!file) {
+		error = "cannot open " + path;
+		return false;
+	}
+
+	string line;
+	int lineNo = 0;
+	catalog.title = "";
+	catalog.entries.clear();
+
+	while (getline(file, line)) {
+		lineNo++;
+		if (!line.empty() && line[line.length() - 1] == '\r') {
+			line.erase(line.length() - 1);
+		}
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		if (line.compare(0, 6, "title=") == 0) {
+			catalog.title = line.substr(6);
+			continue;
+		}
+
+		//name, price, stock [, depth]
+		stringstream ss(line);
+		string name, priceText, stockText, depthText;
+		getline(ss, name, ',');
+		getline(ss, priceText, ',');
+		getline(ss, stockText, ',');
+		getline(ss, depthText);
+
+		//trim spaces around the name
+		size_t first = name.find_first_not_of(" \t");
+		size_t last = name.find_last_not_of(" \t");
+		name = (first == string::npos) ? "" : name.substr(first, last - first + 1);
+
+		CatalogEntry entry;
+		char* endPrice;
+		char* endStock;
+		char* endDepth;
+		entry.name = name;
+		entry.price = strtod(priceText.c_str(), &endPrice);
+		entry.stock = (int)strtol(stockText.c_str(), &endStock, 10);
+		entry.depth = (int)strtol(depthText.c_str(), &endDepth, 10); //0 if there is no fourth column
+
+		//only spaces may follow a number, "19x" is not 19
+		bool badStock = endStock == stockText.c_str() || strspn(endStock, " \t") != strlen(endStock);
+		bool badDepth = strspn(endDepth, " \t") != strlen(endDepth);
+
+		if (name.empty() || name.length() > 15 || priceText.empty() || stockText.empty() || badStock || badDepth ||
+			*endPrice != '\0' || entry.price <= 0 || entry.stock < 0 || entry.depth < 0 || entry.depth > 1000 ||
+			entry.stock > (entry.depth > 0 ? entry.depth : 20)) {
+			stringstream msg;
+			msg << path << ":" << lineNo << ": invalid item line";
+			error = msg.str();
+			return false;
+		}
+		catalog.entries.push_back(entry);
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+CatalogWatcher::CatalogWatcher(const string& file, unsigned long wait) {
+	path = file;
+	size_t slash = path.find_last_of("\\/");
+	directory = (slash == string::npos) ? "." : path.substr(0, slash);
+
+	lastWrite.dwLowDateTime = 0;
+	lastWrite.dwHighDateTime = 0;
+	current = nullptr;
+	publishedVersion = 0;
+	running = false;
+	thread = NULL;
+	nextVersion = 1;
+	waitMs = wait;
+}
+
+CatalogWatcher::~CatalogWatcher() {
+	stop();
+	delete current.load();
+}
+
+//-----------------------------------------------------------------watching-----------------------------------------------------------------
+bool CatalogWatcher::checkNow() {
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &info)) {
+		return false;
+	}
+	if (current.load() != nullptr && CompareFileTime(&info.ftLastWriteTime, &lastWrite) == 0) {
+		return false; //not modified since the last load
+	}
+
+	Catalog* next = new Catalog();
+	string error;
+	if (!Catalog::loadFile(path, *next, error)) {
+		//probably still being written, keep the current version and try on the next change
+		delete next;
+		return false;
+	}
+
+	lastWrite = info.ftLastWriteTime;
+	next->version = nextVersion++;
+
+	//publish, then free the old version once the machines moved on
+	Catalog* old = current.exchange(next);
+	publishedVersion = next->version;
+	epochs.retire(old);
+	epochs.reclaim();
+
+	return true;
+}
+
+bool CatalogWatcher::start() {
+	if (running) {
+		return true;
+	}
+
+	running = true;
+	thread = CreateThread(NULL, 0, threadMain, this, 0, NULL);
+	if (thread == NULL) {
+		running = false;
+		return false;
+	}
+	return true;
+}
+
+void CatalogWatcher::stop() {
+	if (!running) {
+		return;
+	}
+
+	running = false;
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+	thread = NULL;
+}
+
+DWORD WINAPI CatalogWatcher::threadMain(LPVOID arg) {
+	CatalogWatcher* self = static_cast<CatalogWatcher*>(arg);
+
+	//the system signals the handle when a file in the folder is written, like inotify on Linux
+	HANDLE change = FindFirstChangeNotification(self->directory.c_str(), FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+
+	while (self->running) {
+		if (change == INVALID_HANDLE_VALUE) {
+			Sleep(self->waitMs); //cannot watch the folder, fall back to polling
+			self->checkNow();
+			continue;
+		}
+
+		if (WaitForSingleObject(change, self->waitMs) == WAIT_OBJECT_0) {
+			self->checkNow();
+			FindNextChangeNotification(change);
+		}
+		else {
+			self->epochs.reclaim(); //free versions the machines have moved past
+		}
+	}
+
+	if (change != INVALID_HANDLE_VALUE) {
+		FindCloseChangeNotification(change);
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------readers-----------------------------------------------------------------
+int CatalogWatcher::registerReader() {
+	return epochs.registerReader();
+}
+
+void CatalogWatcher::unregisterReader(int reader) {
+	epochs.unregisterReader(reader);
+}
+
+const Catalog* CatalogWatcher::enter(int reader) {
+	epochs.enter(reader);
+	return current.load();
+}
+
+void CatalogWatcher::exit(int reader) {
+	epochs.exit(reader);
+}
+
+unsigned long CatalogWatcher::getVersion() const {
+	return publishedVersion.load();
+}
+
+#endif
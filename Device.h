@@ -0,0 +1,427 @@
+#ifndef _DEVICE_
+#define _DEVICE_
+
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include "Session.h"
+
+using namespace std;
+
+//kinds of device events
+enum DeviceEventType {
+	DEVICE_COIN = 1,    //coin accepted, value in sen
+	DEVICE_NOTE,        //note accepted, value in sen
+	DEVICE_KEY,         //keypad press, code '1'-'9' for an item or 'C' for cancel
+	DEVICE_DOOR         //service door, code 1 opened, 0 closed
+};
+
+//one event as the devices report it
+struct DeviceEvent {
+	int type;              //DeviceEventType
+	int code;              //key or door state
+	unsigned int value;    //cash in sen
+	unsigned int tick;     //GetTickCount() when the device raised it, 0 if unknown
+	unsigned short seq;    //increases by one per event, gaps mean lost events
+};
+
+/*
+ * Non-blocking reader for the binary event stream of the cash acceptor and
+ * keypad. Every event is a fixed 12-byte little-endian record:
+ *   type (1) code (1) seq (2) value (4) tick (4)
+ * poll() only takes the bytes already waiting in the pipe (PeekNamedPipe),
+ * keeps a partial record for the next call and never blocks, so the caller
+ * can handle timeouts and other work between events. A file (a recorded
+ * stream) is read as it is, it never blocks either.
+ */
+class DeviceStream {
+	private:
+		int fd;
+		HANDLE handle;
+		bool isPipe;
+		bool closed;              //writer went away or end of file
+		unsigned char partial[12];
+		int partialLength;
+		bool haveSeq;
+		unsigned short nextSeq;
+		int lost;                 //events missing from the sequence
+
+		DeviceStream(const DeviceStream&);
+		DeviceStream& operator=(const DeviceStream&);
+
+	public:
+		static const int RECORD_SIZE = 12;
+
+		DeviceStream(int fileDesc);                                  //switches fd to binary mode
+
+		int poll(vector<DeviceEvent>& out, int max = 64);            //events that arrived, -1 once closed and drained
+		bool isClosed() const;
+		int getLost() const;
+
+		static void encode(const DeviceEvent& e, unsigned char* record);
+		static void decode(const unsigned char* record, DeviceEvent& e);
+};
+
+/*
+ * Event-driven payment at a machine fitted with devices. Device events are
+ * turned into session events for one customer session, so coins, notes and
+ * keys can arrive in any order and at any time. The loop polls the stream,
+ * handles everything that arrived, delivers timeouts and only sleeps one
+ * tick when the stream was empty, which bounds the delay from coin drop to
+ * credit update by one scheduler tick plus the handling of the burst.
+ */
+class DeviceTerminal {
+	private:
+		VendingMachine* vm;
+		DeviceStream* stream;
+		SessionScheduler scheduler;
+		int customer;             //session id of the customer at the machine
+		bool doorOpen;            //cash is refused while the machine is being serviced
+
+		long long handled;
+		long long timed;          //events that carried a device tick
+		unsigned long long totalLatency;
+		unsigned long maxLatency;
+
+		void handle(const DeviceEvent& e, unsigned long now);
+		void show(int reply);
+		void cancel(unsigned long now);
+
+	public:
+		DeviceTerminal(VendingMachine* machine, DeviceStream* s, unsigned long timeoutMs = 60000);
+		~DeviceTerminal();
+
+		long long run();                                             //until the stream closes, returns events handled
+		void printStats() const;
+};
+
+/*
+ * Stand-in for the real devices: writes the events of made-up customers to
+ * fd. A customer presses an item key, then pays with a burst of coins or a
+ * note, a few change their mind and press cancel, and now and then the
+ * service door is opened for a refill.
+ */
+class DeviceEmulator {
+	private:
+		int fd;
+		mt19937 rng;
+		unsigned short seq;
+		int numItems;
+
+		bool send(int type, int code, unsigned int value);
+		int between(int low, int high);                              //uniform in [low, high]
+
+	public:
+		DeviceEmulator(int fileDesc, unsigned int seed, int items = 5);  //switches fd to binary mode
+
+		int run(int customers, double speed = 1.0);                  //returns events sent, speed 2 halves the gaps
+};
+
+//-----------------------------------------------------------------stream-----------------------------------------------------------------
+DeviceStream::DeviceStream(int fileDesc) {
+	fd = fileDesc;
+	_setmode(fd, _O_BINARY); //no newline translation, no end of file on 0x1A
+	handle = (HANDLE)_get_osfhandle(fd);
+	isPipe = (GetFileType(handle) == FILE_TYPE_PIPE);
+	closed = false;
+	partialLength = 0;
+	haveSeq = false;
+	nextSeq = 0;
+	lost = 0;
+}
+
+int DeviceStream::poll(vector<DeviceEvent>& out, int max) {
+	if (closed) {
+		return -1;
+	}
+
+	unsigned char chunk[RECORD_SIZE * 64];
+	int want = (max < 64 ? max : 64) * RECORD_SIZE - partialLength;
+
+	if (isPipe) {
+		DWORD waiting = 0;
+		if (!PeekNamedPipe(handle, NULL, 0, NULL, &waiting, NULL)) {
+			closed = true; //writer closed its end
+			return -1;
+		}
+		if (waiting == 0) {
+			return 0;
+		}
+		if ((int)waiting < want) {
+			want = (int)waiting;
+		}
+	}
+
+	int count = _read(fd, chunk, want);
+	if (count <= 0) {
+		closed = true;
+		return -1;
+	}
+
+	int found = 0;
+	for (int i = 0; i < count; i++) {
+		partial[partialLength++] = chunk[i];
+		if (partialLength < RECORD_SIZE) {
+			continue;
+		}
+
+		DeviceEvent e;
+		decode(partial, e);
+		partialLength = 0;
+
+		if (haveSeq && e.seq != nextSeq) {
+			lost += (unsigned short)(e.seq - nextSeq);
+		}
+		haveSeq = true;
+		nextSeq = e.seq + 1;
+
+		out.push_back(e);
+		found++;
+	}
+	return found;
+}
+
+bool DeviceStream::isClosed() const {
+	return closed;
+}
+
+int DeviceStream::getLost() const {
+	return lost;
+}
+
+void DeviceStream::encode(const DeviceEvent& e, unsigned char* record) {
+	record[0] = (unsigned char)e.type;
+	record[1] = (unsigned char)e.code;
+	record[2] = (unsigned char)(e.seq & 0xFF);
+	record[3] = (unsigned char)(e.seq >> 8);
+	for (int k = 0; k < 4; k++) {
+		record[4 + k] = (unsigned char)(e.value >> (8 * k));
+		record[8 + k] = (unsigned char)(e.tick >> (8 * k));
+	}
+}
+
+void DeviceStream::decode(const unsigned char* record, DeviceEvent& e) {
+	e.type = record[0];
+	e.code = record[1];
+	e.seq = (unsigned short)(record[2] | (record[3] << 8));
+	e.value = 0;
+	e.tick = 0;
+	for (int k = 0; k < 4; k++) {
+		e.value |= (unsigned int)record[4 + k] << (8 * k);
+		e.tick |= (unsigned int)record[8 + k] << (8 * k);
+	}
+}
+
+//-----------------------------------------------------------------terminal-----------------------------------------------------------------
+DeviceTerminal::DeviceTerminal(VendingMachine* machine, DeviceStream* s, unsigned long timeoutMs) : scheduler(timeoutMs) {
+	if (machine == nullptr || s == nullptr) {
+		throw invalid_argument ("Device terminal needs a machine and a stream!");
+	}
+
+	vm = machine;
+	stream = s;
+	customer = scheduler.open(vm);
+	doorOpen = false;
+	handled = 0;
+	timed = 0;
+	totalLatency = 0;
+	maxLatency = 0;
+}
+
+DeviceTerminal::~DeviceTerminal() {
+	scheduler.close(customer); //gives back a held unit
+}
+
+long long DeviceTerminal::run() {
+	vector<DeviceEvent> events;
+	vector<int> expired, replies;
+
+	for (;;) {
+		events.clear();
+		int count = stream->poll(events);
+		unsigned long now = GetTickCount();
+
+		for (size_t i = 0; i < events.size(); i++) {
+			handle(events[i], now);
+		}
+
+		expired.clear();
+		replies.clear();
+		scheduler.expire(now, expired, replies);
+		for (size_t i = 0; i < replies.size(); i++) {
+			if (replies[i] == REPLY_REFUNDED) {
+				cout << "TIMEOUT, ";
+			}
+			show(replies[i]);
+		}
+
+		if (count < 0) {
+			break;
+		}
+		if (count == 0) {
+			Sleep(1); //nothing waiting, give up the rest of the tick
+		}
+	}
+
+	cancel(GetTickCount()); //stream closed, hand back unspent credit
+	return handled;
+}
+
+void DeviceTerminal::handle(const DeviceEvent& e, unsigned long now) {
+	handled++;
+	if (e.tick != 0 && e.type != DEVICE_DOOR) {
+		unsigned long latency = now - e.tick;
+		timed++;
+		totalLatency += latency;
+		if (latency > maxLatency) {
+			maxLatency = latency;
+		}
+	}
+
+	switch (e.type) {
+		case DEVICE_COIN:
+		case DEVICE_NOTE: {
+			if (doorOpen) {
+				cout << "CASH RETURNED RM " << fixed << setprecision(2) << e.value / 100.0 << " (SERVICE DOOR OPEN)\n";
+				break;
+			}
+			SessionEvent ev = { EVENT_COIN, 0, e.value / 100.0 };
+			show(scheduler.post(customer, ev, now));
+			break;
+		}
+		case DEVICE_KEY:
+			if (e.code == 'C') {
+				cancel(now);
+			}
+			else if (!doorOpen) {
+				SessionEvent ev = { EVENT_KEY, e.code - '0', 0.0 };
+				show(scheduler.post(customer, ev, now));
+			}
+			break;
+		case DEVICE_DOOR:
+			if (e.code && !doorOpen) {
+				cancel(now); //the customer cannot finish while the machine is open
+				cout << "SERVICE DOOR OPEN\n";
+			}
+			else if (!e.code && doorOpen) {
+				cout << "SERVICE DOOR CLOSED\n";
+			}
+			doorOpen = (e.code != 0);
+			break;
+		default:
+			cout << "UNKNOWN DEVICE EVENT " << e.type << endl;
+			break;
+	}
+}
+
+void DeviceTerminal::cancel(unsigned long now) {
+	if (scheduler.get(customer).isIdle()) {
+		return;
+	}
+	SessionEvent ev = { EVENT_CANCEL, 0, 0.0 };
+	show(scheduler.post(customer, ev, now));
+}
+
+void DeviceTerminal::show(int reply) {
+	const CustomerSession& c = scheduler.get(customer);
+	cout << fixed << setprecision(2);
+
+	switch (reply) {
+		case REPLY_CREDIT:         cout << "CREDIT RM " << c.getAmount() << endl; break;
+		case REPLY_DUE:            cout << "PLEASE PAY RM " << c.getAmount() << endl; break;
+		case REPLY_VENDED:         cout << "!!!PAYMENT SUCCESSFUL!!! CHANGE RM " << c.getAmount() << endl; break;
+		case REPLY_REFUNDED:       cout << "REFUNDED RM " << c.getAmount() << endl; break;
+		case REPLY_INVALID_ITEM:   cout << "INVALID ITEM\n"; break;
+		case REPLY_OUT_OF_STOCK:   cout << "OUT OF STOCK\n"; break;
+		case REPLY_NO_CHANGE:      cout << "NOT ENOUGH CHANGE, REFUNDED RM " << c.getAmount() << endl; break;
+		case REPLY_INVALID_AMOUNT: cout << "CASH NOT ACCEPTED\n"; break;
+		default: break;
+	}
+}
+
+void DeviceTerminal::printStats() const {
+	cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
+	cout << left << setw(15) << "Events" << ": " << handled << endl;
+	cout << left << setw(15) << "Lost Events" << ": " << stream->getLost() << endl;
+	if (timed > 0) {
+		cout << left << setw(15) << "Mean Latency" << ": " << fixed << setprecision(1) << (double)totalLatency / timed << " ms\n";
+		cout << left << setw(15) << "Max Latency" << ": " << maxLatency << " ms\n";
+	}
+	cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
+}
+
+//-----------------------------------------------------------------emulator-----------------------------------------------------------------
+DeviceEmulator::DeviceEmulator(int fileDesc, unsigned int seed, int items) : rng(seed) {
+	fd = fileDesc;
+	_setmode(fd, _O_BINARY);
+	seq = 0;
+	numItems = (items > 0 && items <= 9) ? items : 5;
+}
+
+int DeviceEmulator::between(int low, int high) {
+	uniform_int_distribution<int> d(low, high);
+	return d(rng);
+}
+
+bool DeviceEmulator::send(int type, int code, unsigned int value) {
+	DeviceEvent e = { type, code, value, (unsigned int)GetTickCount(), seq++ };
+	unsigned char record[DeviceStream::RECORD_SIZE];
+	DeviceStream::encode(e, record);
+	return _write(fd, record, sizeof(record)) == (int)sizeof(record);
+}
+
+int DeviceEmulator::run(int customers, double speed) {
+	static const unsigned int coins[] = { 10, 20, 50 };       //sen
+	static const unsigned int notes[] = { 100, 500, 1000 };
+	int sent = 0;
+
+	if (speed <= 0) {
+		speed = 1.0;
+	}
+
+	for (int c = 0; c < customers; c++) {
+		Sleep((DWORD)(between(500, 3000) / speed)); //walk up to the machine
+
+		//one customer in twenty opens the door instead, it is the refill visit
+		if (between(1, 20) == 1) {
+			if (!send(DEVICE_DOOR, 1, 0)) return sent;
+			Sleep((DWORD)(between(2000, 5000) / speed));
+			if (!send(DEVICE_DOOR, 0, 0)) return sent + 1;
+			sent += 2;
+			continue;
+		}
+
+		if (!send(DEVICE_KEY, '0' + between(1, numItems), 0)) return sent;
+		sent++;
+		Sleep((DWORD)(between(300, 1500) / speed));
+
+		if (between(1, 3) == 1) {
+			//note, fed in one go
+			if (!send(DEVICE_NOTE, 0, notes[between(0, 2)])) return sent;
+			sent++;
+		}
+		else {
+			//burst of coins a fraction of a second apart
+			int n = between(3, 12);
+			for (int k = 0; k < n; k++) {
+				if (!send(DEVICE_COIN, 0, coins[between(0, 2)])) return sent;
+				sent++;
+				Sleep((DWORD)(between(60, 180) / speed));
+			}
+		}
+
+		//some give up before paying enough
+		if (between(1, 10) == 1) {
+			Sleep((DWORD)(between(500, 2000) / speed));
+			if (!send(DEVICE_KEY, 'C', 0)) return sent;
+			sent++;
+		}
+	}
+	return sent;
+}
+
+#endif
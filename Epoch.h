@@ -0,0 +1,140 @@
+#ifndef _EPOCH_
+#define _EPOCH_
+
+#include <atomic>
+#include <vector>
+#include <stdexcept>
+
+using namespace std;
+
+/*
+ * Epoch-based reclamation for data that is read without locks. A reader
+ * calls enter() before loading a shared pointer and exit() when it no longer
+ * uses it. The writer swaps the pointer, then hands the old object to
+ * retire(); it is deleted by reclaim() once every reader that might still see
+ * it has left. Readers never wait, the writer never waits on readers either,
+ * it only frees later.
+ */
+class EpochDomain {
+	private:
+		static const int MAX_READERS = 64;
+
+		struct Retired {
+			unsigned long epoch;       //global epoch when the object was unlinked
+			void* object;
+			void (*destroy)(void*);    //typed delete for the object
+		};
+
+		atomic<unsigned long> globalEpoch;
+		atomic<unsigned long> readerEpoch[MAX_READERS];  //epoch seen by a reader, 0 when outside
+		atomic<bool> readerUsed[MAX_READERS];
+		vector<Retired> retired;                          //writer side only
+
+		template <class T>
+		static void destroyObject(void* object);
+
+	public:
+		EpochDomain();
+		~EpochDomain();
+
+		int registerReader();                   //get a reader slot, throws when all are taken
+		void unregisterReader(int reader);
+		void enter(int reader);                 //start a read-side section
+		void exit(int reader);                  //end a read-side section
+
+		template <class T>
+		void retire(T* object);                 //writer: free object once no reader can see it
+		int reclaim();                          //writer: free what is safe, returns how many
+		int getNumRetired() const;
+};
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+EpochDomain::EpochDomain() {
+	globalEpoch = 1;
+	for (int i = 0; i < MAX_READERS; i++) {
+		readerEpoch[i] = 0;
+		readerUsed[i] = false;
+	}
+}
+
+EpochDomain::~EpochDomain() {
+	//no readers are left when the domain goes away
+	for (size_t i = 0; i < retired.size(); i++) {
+		retired[i].destroy(retired[i].object);
+	}
+}
+
+//-----------------------------------------------------------------readers-----------------------------------------------------------------
+int EpochDomain::registerReader() {
+	for (int i = 0; i < MAX_READERS; i++) {
+		bool expected = false;
+		if (readerUsed[i].compare_exchange_strong(expected, true)) {
+			return i;
+		}
+	}
+	throw runtime_error ("Too many epoch readers!");
+}
+
+void EpochDomain::unregisterReader(int reader) {
+	readerEpoch[reader] = 0;
+	readerUsed[reader] = false;
+}
+
+void EpochDomain::enter(int reader) {
+	readerEpoch[reader].store(globalEpoch.load()); //seq_cst, ordered before the reader's pointer load
+}
+
+void EpochDomain::exit(int reader) {
+	readerEpoch[reader].store(0, memory_order_release);
+}
+
+//-----------------------------------------------------------------writer-----------------------------------------------------------------
+template <class T>
+void EpochDomain::destroyObject(void* object) {
+	delete static_cast<T*>(object);
+}
+
+template <class T>
+void EpochDomain::retire(T* object) {
+	if (object == nullptr) {
+		return;
+	}
+
+	Retired r;
+	r.epoch = globalEpoch.fetch_add(1); //readers entering from now on cannot reach object
+	r.object = object;
+	r.destroy = &EpochDomain::destroyObject<T>;
+	retired.push_back(r);
+}
+
+int EpochDomain::reclaim() {
+	//oldest epoch any active reader may still be using
+	unsigned long oldest = globalEpoch.load();
+	for (int i = 0; i < MAX_READERS; i++) {
+		unsigned long e = readerEpoch[i].load();
+		if (e != 0 && e < oldest) {
+			oldest = e;
+		}
+	}
+
+	int freed = 0;
+	size_t kept = 0;
+	for (size_t i = 0; i < retired.size(); i++) {
+		if (retired[i].epoch < oldest) {
+			retired[i].destroy(retired[i].object);
+			freed++;
+		}
+		else {
+			retired[kept++] = retired[i];
+		}
+	}
+	retired.resize(kept);
+
+	return freed;
+}
+
+int EpochDomain::getNumRetired() const {
+	return (int)retired.size();
+}
+
+#endif
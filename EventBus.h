@@ -0,0 +1,145 @@
+#ifndef _EVENT_BUS_
+#define _EVENT_BUS_
+
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+//kinds of machine changes
+enum MachineEventType {
+	MACHINE_STOCK_CHANGED = 0,   //units in a slot changed
+	MACHINE_PRICE_CHANGED,       //catalog price of a slot changed
+	MACHINE_NAME_CHANGED,        //item in a slot was renamed
+	MACHINE_TITLE_CHANGED,       //machine title changed
+	MACHINE_CASH_CHANGED,        //money inside the machine changed
+	MACHINE_EVENT_TYPES
+};
+
+//subscription masks
+const int MACHINE_SLOT_EVENTS = (1 << MACHINE_STOCK_CHANGED) | (1 << MACHINE_PRICE_CHANGED) | (1 << MACHINE_NAME_CHANGED);
+const int MACHINE_ALL_EVENTS = (1 << MACHINE_EVENT_TYPES) - 1;
+
+//one change, slot events carry the whole slot so a subscriber never reads back
+struct MachineEvent {
+	int type;           //MachineEventType
+	int machine;        //machine id
+	int slot;           //item slot (1-based), 0 for title and cash
+	int stock;          //units in the slot
+	int capacity;       //maximum units of the slot
+	double value;       //price of the slot, or money inside for cash events
+	const char* text;   //item name, or title for title events, only valid during the call
+};
+
+class EventSubscriber {
+	public:
+		virtual ~EventSubscriber() {}
+		virtual void onEvent(const MachineEvent& e) = 0;
+};
+
+/*
+ * Publishes the changes of a machine to the subscribers of each event type.
+ * Every type keeps its own subscriber list, so a change costs one call per
+ * interested subscriber and nothing for the others. Events are delivered on
+ * the thread that changes the machine; subscribers must not subscribe or
+ * unsubscribe from inside onEvent().
+ */
+class EventBus {
+	private:
+		vector<EventSubscriber*> byType[MACHINE_EVENT_TYPES];
+		long long published;
+
+		EventBus(const EventBus&);
+		EventBus& operator=(const EventBus&);
+
+	public:
+		EventBus();
+
+		void subscribe(EventSubscriber* s, int mask = MACHINE_ALL_EVENTS);  //mask has bit (1 << type) for every wanted type
+		void unsubscribe(EventSubscriber* s);
+		void publish(const MachineEvent& e);
+		bool hasSubscribers(int type) const;
+		long long getNumPublished() const;
+
+		static const char* getTypeName(int type);   //STOCK, PRICE, NAME, TITLE or CASH
+};
+
+/*
+ * Metrics subscriber, counts the events of every type it is subscribed to.
+ */
+class EventCounter : public EventSubscriber {
+	private:
+		long long counts[MACHINE_EVENT_TYPES];
+
+	public:
+		EventCounter();
+
+		void onEvent(const MachineEvent& e);
+		long long getCount(int type) const;
+};
+
+//------------------------------------------------------------------constructor-----------------------------------------------------------------
+EventBus::EventBus() {
+	published = 0;
+}
+
+//-----------------------------------------------------------------subscribers-----------------------------------------------------------------
+void EventBus::subscribe(EventSubscriber* s, int mask) {
+	for (int t = 0; t < MACHINE_EVENT_TYPES; t++) {
+		vector<EventSubscriber*>& list = byType[t];
+		if ((mask & (1 << t)) && find(list.begin(), list.end(), s) == list.end()) {
+			list.push_back(s);
+		}
+	}
+}
+
+void EventBus::unsubscribe(EventSubscriber* s) {
+	for (int t = 0; t < MACHINE_EVENT_TYPES; t++) {
+		vector<EventSubscriber*>& list = byType[t];
+		list.erase(remove(list.begin(), list.end(), s), list.end());
+	}
+}
+
+//-----------------------------------------------------------------events-----------------------------------------------------------------
+void EventBus::publish(const MachineEvent& e) {
+	const vector<EventSubscriber*>& list = byType[e.type];
+	for (size_t i = 0; i < list.size(); i++) {
+		list[i]->onEvent(e);
+	}
+	published++;
+}
+
+bool EventBus::hasSubscribers(int type) const {
+	return !byType[type].empty();
+}
+
+long long EventBus::getNumPublished() const {
+	return published;
+}
+
+const char* EventBus::getTypeName(int type) {
+	switch (type) {
+		case MACHINE_STOCK_CHANGED: return "STOCK";
+		case MACHINE_PRICE_CHANGED: return "PRICE";
+		case MACHINE_NAME_CHANGED:  return "NAME";
+		case MACHINE_TITLE_CHANGED: return "TITLE";
+		default:                    return "CASH";
+	}
+}
+
+//-----------------------------------------------------------------counter-----------------------------------------------------------------
+EventCounter::EventCounter() {
+	for (int t = 0; t < MACHINE_EVENT_TYPES; t++) {
+		counts[t] = 0;
+	}
+}
+
+void EventCounter::onEvent(const MachineEvent& e) {
+	counts[e.type]++;
+}
+
+long long EventCounter::getCount(int type) const {
+	return counts[type];
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef _EXPIRY_
+#define _EXPIRY_
+
+#include <vector>
+#include <queue>
+#include <functional>
+
+using namespace std;
+
+//anything that holds perishable stock in slots, implemented by VendingMachine
+class ExpiryTarget {
+	public:
+		virtual ~ExpiryTarget() {}
+		virtual int purgeSlot(int itemOpt, long long now) = 0;   //remove expired units from a slot, returns how many
+};
+
+/*
+ * Expiry dates of every lot, sorted earliest first. A sweep only visits the
+ * slots whose earliest lot is due, so purging a whole fleet costs the number
+ * of expired lots, not the number of slots. Entries for lots that were sold
+ * before they expired are left in place and cost one empty purge later.
+ * One index can be shared by all machines of a process.
+ */
+class ExpiryIndex {
+	private:
+		struct Entry {
+			long long expiry;       //best-before time, seconds since 1970
+			ExpiryTarget* target;   //machine holding the lot
+			int itemOpt;            //slot of the lot (1-based)
+
+			bool operator>(const Entry& other) const { return expiry > other.expiry; }
+		};
+
+		priority_queue<Entry, vector<Entry>, greater<Entry> > entries;
+
+	public:
+		void add(long long expiry, ExpiryTarget* target, int itemOpt);  //index a new lot
+		int sweep(long long now);                                       //purge every due slot, returns units removed
+		void removeTarget(ExpiryTarget* target);                        //forget a machine that is going away
+		long long getNextExpiry() const;                                //earliest indexed expiry, 0 if none
+		int size() const;
+};
+
+//-----------------------------------------------------------------index-----------------------------------------------------------------
+void ExpiryIndex::add(long long expiry, ExpiryTarget* target, int itemOpt) {
+	if (expiry <= 0) {
+		return; //does not expire
+	}
+
+	Entry e;
+	e.expiry = expiry;
+	e.target = target;
+	e.itemOpt = itemOpt;
+	entries.push(e);
+}
+
+int ExpiryIndex::sweep(long long now) {
+	int removed = 0;
+
+	while (!entries.empty() && entries.top().expiry <= now) {
+		Entry e = entries.top();
+		entries.pop();
+		removed += e.target->purgeSlot(e.itemOpt, now);
+	}
+	return removed;
+}
+
+void ExpiryIndex::removeTarget(ExpiryTarget* target) {
+	vector<Entry> kept;
+
+	while (!entries.empty()) {
+		if (entries.top().target != target) {
+			kept.push_back(entries.top());
+		}
+		entries.pop();
+	}
+	for (size_t i = 0; i < kept.size(); i++) {
+		entries.push(kept[i]);
+	}
+}
+
+long long ExpiryIndex::getNextExpiry() const {
+	return entries.empty() ? 0 : entries.top().expiry;
+}
+
+int ExpiryIndex::size() const {
+	return (int)entries.size();
+}
+
+#endif
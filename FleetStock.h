@@ -0,0 +1,237 @@
+#ifndef _FLEET_STOCK_
+#define _FLEET_STOCK_
+
+#include <vector>
+#include <climits>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+/*
+ * Structure-of-arrays copy of the stock of every slot in a fleet, for route
+ * planning. Each machine owns a run of rows (one per slot it can hold) and
+ * keeps them current as its stock, prices and cash change, so a scan reads
+ * a few flat int arrays instead of walking items and their queues.
+ *
+ * The scans compare 8 rows at a time with AVX2, 4 with SSE2, or one at a time
+ * when the compiler targets neither. Unused rows have capacity 0 and never
+ * match.
+ */
+class FleetStock {
+	private:
+		vector<int> count;        //units in stock, per row
+		vector<int> capacity;     //maximum units, per row, 0 if the slot is unused
+		vector<int> priceCents;   //price, per row
+		vector<int> machineOf;    //machine of the row
+		vector<int> firstRow;     //first row of every machine
+		vector<int> cashCents;    //cash inside, per machine
+
+		static void collect(int bits, int first, int lanes, vector<int>* out); //append indices of set bits
+
+	public:
+		int addMachine(int numSlots);                        //reserve rows for a machine, returns the machine index
+		void removeMachine(int machine);                     //rows stop matching any scan
+		int getFirstRow(int machine) const;
+		int getMachine(int row) const;
+		int getSlot(int row) const;                          //slot of the row in its machine (1-based)
+		int getCount(int row) const;
+		int getNumRows() const;
+		int getNumMachines() const;
+
+		void setSlot(int row, int units, int maxUnits, int cents);  //fill a whole row
+		void setCount(int row, int units);
+		void setPrice(int row, int cents);
+		void setCash(int machine, int cents);
+
+		int scanLowStock(int percent, vector<int>* rows) const;    //rows with stock below percent of capacity
+		int scanLowCash(int cents, vector<int>* machines) const;   //machines with less cash than cents
+};
+
+//-----------------------------------------------------------------rows-----------------------------------------------------------------
+int FleetStock::addMachine(int numSlots) {
+	int machine = (int)firstRow.size();
+
+	firstRow.push_back((int)count.size());
+	cashCents.push_back(0);
+	for (int i = 0; i < numSlots; i++) {
+		count.push_back(0);
+		capacity.push_back(0);
+		priceCents.push_back(0);
+		machineOf.push_back(machine);
+	}
+	return machine;
+}
+
+void FleetStock::removeMachine(int machine) {
+	int end = (machine + 1 < (int)firstRow.size()) ? firstRow[machine + 1] : (int)count.size();
+
+	for (int row = firstRow[machine]; row < end; row++) {
+		count[row] = 0;
+		capacity[row] = 0;
+	}
+	cashCents[machine] = INT_MAX;
+}
+
+int FleetStock::getFirstRow(int machine) const {
+	return firstRow[machine];
+}
+
+int FleetStock::getMachine(int row) const {
+	return machineOf[row];
+}
+
+int FleetStock::getSlot(int row) const {
+	return row - firstRow[machineOf[row]] + 1;
+}
+
+int FleetStock::getCount(int row) const {
+	return count[row];
+}
+
+int FleetStock::getNumRows() const {
+	return (int)count.size();
+}
+
+int FleetStock::getNumMachines() const {
+	return (int)firstRow.size();
+}
+
+void FleetStock::setSlot(int row, int units, int maxUnits, int cents) {
+	count[row] = units;
+	capacity[row] = maxUnits;
+	priceCents[row] = cents;
+}
+
+void FleetStock::setCount(int row, int units) {
+	count[row] = units;
+}
+
+void FleetStock::setPrice(int row, int cents) {
+	priceCents[row] = cents;
+}
+
+void FleetStock::setCash(int machine, int cents) {
+	cashCents[machine] = cents;
+}
+
+//-----------------------------------------------------------------scans-----------------------------------------------------------------
+void FleetStock::collect(int bits, int first, int lanes, vector<int>* out) {
+	for (int k = 0; k < lanes; k++) {
+		if (bits & (1 << k)) {
+			out->push_back(first + k);
+		}
+	}
+}
+
+int FleetStock::scanLowStock(int percent, vector<int>* rows) const {
+	const int* c = count.data();
+	const int* cap = capacity.data();
+	int n = (int)count.size();
+	int found = 0;
+	int i = 0;
+
+	//count * 100 < percent * capacity, in float so no 32-bit multiply is needed (exact for these sizes)
+#if defined(__AVX2__)
+	__m256 hundred = _mm256_set1_ps(100.0f);
+	__m256 pct = _mm256_set1_ps((float)percent);
+	__m256i zero = _mm256_setzero_si256();
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i cv = _mm256_loadu_si256((const __m256i*)(c + i));
+		__m256i capv = _mm256_loadu_si256((const __m256i*)(cap + i));
+		__m256 low = _mm256_cmp_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(cv), hundred),
+			_mm256_mul_ps(_mm256_cvtepi32_ps(capv), pct), _CMP_LT_OQ);
+		__m256 used = _mm256_castsi256_ps(_mm256_cmpgt_epi32(capv, zero));
+		int bits = _mm256_movemask_ps(_mm256_and_ps(low, used));
+
+		if (bits) {
+			found += __builtin_popcount(bits);
+			if (rows) {
+				collect(bits, i, 8, rows);
+			}
+		}
+	}
+#elif defined(__SSE2__)
+	__m128 hundred = _mm_set1_ps(100.0f);
+	__m128 pct = _mm_set1_ps((float)percent);
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i cv = _mm_loadu_si128((const __m128i*)(c + i));
+		__m128i capv = _mm_loadu_si128((const __m128i*)(cap + i));
+		__m128 low = _mm_cmplt_ps(_mm_mul_ps(_mm_cvtepi32_ps(cv), hundred), _mm_mul_ps(_mm_cvtepi32_ps(capv), pct));
+		__m128 used = _mm_castsi128_ps(_mm_cmpgt_epi32(capv, zero));
+		int bits = _mm_movemask_ps(_mm_and_ps(low, used));
+
+		if (bits) {
+			found += __builtin_popcount(bits);
+			if (rows) {
+				collect(bits, i, 4, rows);
+			}
+		}
+	}
+#endif
+
+	for (; i < n; i++) {
+		if (cap[i] > 0 && (long long)c[i] * 100 < (long long)percent * cap[i]) {
+			found++;
+			if (rows) {
+				rows->push_back(i);
+			}
+		}
+	}
+	return found;
+}
+
+int FleetStock::scanLowCash(int cents, vector<int>* machines) const {
+	const int* cash = cashCents.data();
+	int n = (int)cashCents.size();
+	int found = 0;
+	int i = 0;
+
+#if defined(__AVX2__)
+	__m256i limit = _mm256_set1_epi32(cents);
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i low = _mm256_cmpgt_epi32(limit, _mm256_loadu_si256((const __m256i*)(cash + i)));
+		int bits = _mm256_movemask_ps(_mm256_castsi256_ps(low));
+
+		if (bits) {
+			found += __builtin_popcount(bits);
+			if (machines) {
+				collect(bits, i, 8, machines);
+			}
+		}
+	}
+#elif defined(__SSE2__)
+	__m128i limit = _mm_set1_epi32(cents);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i low = _mm_cmplt_epi32(_mm_loadu_si128((const __m128i*)(cash + i)), limit);
+		int bits = _mm_movemask_ps(_mm_castsi128_ps(low));
+
+		if (bits) {
+			found += __builtin_popcount(bits);
+			if (machines) {
+				collect(bits, i, 4, machines);
+			}
+		}
+	}
+#endif
+
+	for (; i < n; i++) {
+		if (cash[i] < cents) {
+			found++;
+			if (machines) {
+				machines->push_back(i);
+			}
+		}
+	}
+	return found;
+}
+
+#endif
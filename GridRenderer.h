@@ -0,0 +1,141 @@
+#ifndef _GRID_RENDERER_
+#define _GRID_RENDERER_
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cctype>
+#include "EventBus.h"
+
+using namespace std;
+
+/*
+ * Renderer subscriber for the item grid of a machine. Each column (header and
+ * one cell per stock row) is formatted when an event touches its slot, and
+ * the whole frame is joined again only after a change, so showing the grid
+ * between changes is a single write of the cached text.
+ */
+class GridRenderer : public EventSubscriber {
+	private:
+		struct Column {
+			string name;
+			char symbol;           //first letter of the name, drawn for each unit
+			int stock;
+			int capacity;
+			string header;         //name and index, 20 characters wide
+			vector<string> cells;  //one per stock row, top row first
+		};
+
+		vector<Column> columns;
+		string title;
+		string frame;              //text of the last drawn grid
+
+		int getRows() const;       //all slots share the capacity of the first
+		void formatColumn(int index);
+		void join();
+
+	public:
+		void onEvent(const MachineEvent& e);
+		void draw(ostream& out) const;
+		const string& getFrame() const;
+};
+
+//-----------------------------------------------------------------events-----------------------------------------------------------------
+void GridRenderer::onEvent(const MachineEvent& e) {
+	if (e.type == MACHINE_TITLE_CHANGED) {
+		title = e.text;
+		join();
+		return;
+	}
+	if (e.slot < 1) {
+		return;
+	}
+
+	if (e.slot > (int)columns.size()) {
+		columns.resize(e.slot);
+	}
+	Column& c = columns[e.slot - 1];
+	int rows = getRows();
+
+	c.name = e.text;
+	c.symbol = c.name.empty() ? ' ' : (char)toupper(c.name[0]);
+	c.stock = e.stock;
+	c.capacity = e.capacity;
+
+	if (getRows() != rows) {
+		for (int i = 0; i < (int)columns.size(); i++) {
+			formatColumn(i); //row count changed, every column gets taller or shorter
+		}
+	}
+	else {
+		formatColumn(e.slot - 1);
+	}
+	join();
+}
+
+//-----------------------------------------------------------------drawing-----------------------------------------------------------------
+int GridRenderer::getRows() const {
+	return columns.empty() ? 0 : columns[0].capacity;
+}
+
+void GridRenderer::formatColumn(int index) {
+	Column& c = columns[index];
+	int rows = getRows();
+	ostringstream header;
+
+	string name = c.name + " [" + to_string(index + 1) + "] ";
+	int midpoint = name.length() / 2;
+	header << left << setw(15) << name << string(5, ' ');
+	c.header = header.str();
+
+	//units stand at the bottom of the column, under the middle of the name
+	c.cells.resize(rows);
+	for (int i = 0; i < rows; i++) {
+		if (c.stock == 0) {
+			c.cells[i] = (i == 0) ? "<Out of Stock> " + string(5, ' ') : string(20, ' ');
+		}
+		else if (i < rows - c.stock) {
+			c.cells[i] = string(20, ' ');
+		}
+		else {
+			c.cells[i] = string(midpoint, ' ') + c.symbol + string(19 - midpoint, ' ');
+		}
+	}
+}
+
+void GridRenderer::join() {
+	int rows = getRows();
+	int n = (int)columns.size();
+
+	frame = "\n\n\t\t\t\t\t\t[" + title + "] \n\n\n\t\t";
+	for (int j = 0; j < n; j++) {
+		frame += columns[j].header;
+	}
+	frame += "\n\t\t";
+	if (n > 0) {
+		frame += string(20 * n - 10, '-');
+	}
+	frame += "\n";
+
+	for (int i = 0; i < rows; i++) {
+		frame += "\t\t";
+		for (int j = 0; j < n; j++) {
+			frame += columns[j].cells[i];
+		}
+		frame += "\n";
+	}
+	frame += "\n";
+}
+
+void GridRenderer::draw(ostream& out) const {
+	out << left << frame; //menus after the grid expect left alignment to stay set
+	out.flush();
+}
+
+const string& GridRenderer::getFrame() const {
+	return frame;
+}
+
+#endif
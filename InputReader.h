@@ -0,0 +1,289 @@
+#ifndef _INPUT_READER_
+#define _INPUT_READER_
+
+#include <iostream>
+#include <cstring>
+#include <io.h>
+
+using namespace std;
+
+//result codes for every read
+enum ReadResult {
+	READ_OK = 0,     //value parsed
+	READ_INVALID,    //line does not hold a valid value, the line is consumed
+	READ_OVERFLOW,   //line longer than the buffer, the line is consumed
+	READ_EOF         //no more input
+};
+
+/*
+ * Buffered line reader for the menus. Input is read from a file descriptor
+ * in large chunks and every prompt consumes exactly one line, which is parsed
+ * in place inside the buffer (no string is created). Works the same for the
+ * console, a pipe or a redirected script file.
+ */
+class InputReader {
+	private:
+		int fd;             //file descriptor to read from
+		char* buffer;       //chunk buffer
+		int bufferSize;
+		int start;          //first unread byte
+		int end;            //one past the last byte read
+		bool eof;           //no more data from fd
+		ostream* tied;      //flushed before blocking, so prompts are shown
+
+		bool fill();                                            //read more bytes, false if nothing new
+
+	public:
+		InputReader(int fileDesc, int size = 65536, ostream* tie = nullptr);
+		~InputReader();
+
+		int nextLine(const char* &line, int &length);           //next line without the newline, valid until the next read
+		int readInt(int &value);                                //line holding one integer
+		int readMoney(double &value);                           //line holding an amount like 1, 1.5 or 1.50
+		int readYesNo(char &answer);                            //line holding Y or N (any case), answer is 'Y' or 'N'
+		int readText(char* text, int size);                     //copy a whole line, trimmed, into text
+
+		static int parseInt(const char* s, int length, int &value);     //parse a trimmed token
+		static int parseCents(const char* s, int length, long &cents);  //parse money to whole cents
+		static void trim(const char* &s, int &length);                  //drop spaces, tabs and '\r' at both ends
+};
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+InputReader::InputReader(int fileDesc, int size, ostream* tie) {
+	fd = fileDesc;
+	bufferSize = size;
+	buffer = new char[bufferSize];
+	start = 0;
+	end = 0;
+	eof = false;
+	tied = tie;
+}
+
+InputReader::~InputReader() {
+	delete[] buffer;
+}
+
+//-----------------------------------------------------------------buffer-----------------------------------------------------------------
+bool InputReader::fill() {
+	if (eof) {
+		return false;
+	}
+
+	//move the unread part to the front to make room
+	if (start > 0) {
+		memmove(buffer, buffer + start, end - start);
+		end -= start;
+		start = 0;
+	}
+	if (end == bufferSize) {
+		return false; //buffer full of one line
+	}
+
+	if (tied) {
+		tied->flush();
+	}
+
+	int count = _read(fd, buffer + end, bufferSize - end);
+	if (count <= 0) {
+		eof = true;
+		return false;
+	}
+
+	end += count;
+	return true;
+}
+
+int InputReader::nextLine(const char* &line, int &length) {
+	int scanFrom = start;
+
+	while (true) {
+		char* newline = (char*)memchr(buffer + scanFrom, '\n', end - scanFrom);
+
+		if (newline) {
+			line = buffer + start;
+			length = (int)(newline - line);
+			start += length + 1;
+			return READ_OK;
+		}
+
+		scanFrom = end - start; //only scan the new bytes next time, fill() moves data to the front
+		if (!fill()) {
+			if (end == bufferSize) {
+				//line does not fit, drop it up to the next newline
+				start = end = 0;
+				while (fill()) {
+					newline = (char*)memchr(buffer, '\n', end);
+					if (newline) {
+						start = (int)(newline - buffer) + 1;
+						return READ_OVERFLOW;
+					}
+					start = end = 0;
+				}
+				return READ_OVERFLOW;
+			}
+			if (start == end) {
+				return READ_EOF;
+			}
+
+			//last line without a newline
+			line = buffer + start;
+			length = end - start;
+			start = end;
+			return READ_OK;
+		}
+	}
+}
+
+//-----------------------------------------------------------------typed reads-----------------------------------------------------------------
+int InputReader::readInt(int &value) {
+	const char* line;
+	int length;
+	int result = nextLine(line, length);
+
+	if (result != READ_OK) {
+		return result;
+	}
+	trim(line, length);
+	return parseInt(line, length, value);
+}
+
+int InputReader::readMoney(double &value) {
+	const char* line;
+	int length;
+	long cents;
+	int result = nextLine(line, length);
+
+	if (result != READ_OK) {
+		return result;
+	}
+	trim(line, length);
+
+	result = parseCents(line, length, cents);
+	if (result == READ_OK) {
+		value = cents / 100.0;
+	}
+	return result;
+}
+
+int InputReader::readYesNo(char &answer) {
+	const char* line;
+	int length;
+	int result = nextLine(line, length);
+
+	if (result != READ_OK) {
+		return result;
+	}
+	trim(line, length);
+
+	if (length == 1 && (toupper(line[0]) == 'Y' || toupper(line[0]) == 'N')) {
+		answer = toupper(line[0]);
+		return READ_OK;
+	}
+	return READ_INVALID;
+}
+
+int InputReader::readText(char* text, int size) {
+	const char* line;
+	int length;
+	int result = nextLine(line, length);
+
+	if (result != READ_OK) {
+		return result;
+	}
+	trim(line, length);
+
+	if (length >= size) {
+		return READ_OVERFLOW;
+	}
+	memcpy(text, line, length);
+	text[length] = '\0';
+	return READ_OK;
+}
+
+//-----------------------------------------------------------------parsing-----------------------------------------------------------------
+void InputReader::trim(const char* &s, int &length) {
+	while (length > 0 && (s[0] == ' ' || s[0] == '\t' || s[0] == '\r')) {
+		s++;
+		length--;
+	}
+	while (length > 0 && (s[length - 1] == ' ' || s[length - 1] == '\t' || s[length - 1] == '\r')) {
+		length--;
+	}
+}
+
+int InputReader::parseInt(const char* s, int length, int &value) {
+	int i = 0;
+	bool negative = false;
+	long long result = 0;
+
+	if (i < length && (s[i] == '-' || s[i] == '+')) {
+		negative = (s[i] == '-');
+		i++;
+	}
+	if (i == length) {
+		return READ_INVALID;
+	}
+
+	for (; i < length; i++) {
+		if (s[i] < '0' || s[i] > '9') {
+			return READ_INVALID;
+		}
+		result = result * 10 + (s[i] - '0');
+		if (result > 2147483647LL) {
+			return READ_INVALID;
+		}
+	}
+
+	value = negative ? -(int)result : (int)result;
+	return READ_OK;
+}
+
+int InputReader::parseCents(const char* s, int length, long &cents) {
+	int i = 0;
+	bool negative = false;
+	bool digits = false;
+	long whole = 0;
+	long fraction = 0;
+	int fractionDigits = 0;
+
+	if (i < length && (s[i] == '-' || s[i] == '+')) {
+		negative = (s[i] == '-');
+		i++;
+	}
+
+	for (; i < length && s[i] >= '0' && s[i] <= '9'; i++) {
+		whole = whole * 10 + (s[i] - '0');
+		digits = true;
+		if (whole > 10000000L) {
+			return READ_INVALID; //no one pays RM 10 million in a vending machine
+		}
+	}
+
+	if (i < length && s[i] == '.') {
+		for (i++; i < length && s[i] >= '0' && s[i] <= '9'; i++) {
+			//keep one digit more than cents for rounding
+			if (fractionDigits < 3) {
+				fraction = fraction * 10 + (s[i] - '0');
+				fractionDigits++;
+			}
+			digits = true;
+		}
+	}
+
+	if (!digits || i != length) {
+		return READ_INVALID;
+	}
+
+	while (fractionDigits < 3) {
+		fraction *= 10;
+		fractionDigits++;
+	}
+
+	cents = whole * 100 + (fraction + 5) / 10;
+	if (negative) {
+		cents = -cents;
+	}
+	return READ_OK;
+}
+
+#endif
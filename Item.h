@@ -5,21 +5,38 @@
 #include <cctype>
 #include <iomanip>
 #include <stdexcept>
+#include <vector>
 #include "Queue.h"
+#include "Aggregate.h"
+#include "MemoryAccount.h"
 
 using namespace std;
 
+//one replenishment of an item, units are sold from the oldest lot first
+struct Lot {
+	int quantity;        //units received in this replenishment
+	long long expiry;    //best-before time (seconds since 1970), 0 if it does not expire
+};
+
 class Item {
 	private:
 		string itemName;
 		double itemPrice;
 		char itemChar;
 		Queue<Item> *itemQueue;
+		Queue<Lot> *lotQueue;    //lots in the order they were added
+		int frontLotUsed;        //units already sold from the oldest lot
 		int maxSize;
+		StockListener* listener; //told about every stock change, nullptr if none
+		int slot;                //slot number reported to the listener (1-based)
+		int memoryAccount;       //account charged for the queues and name, 0 if none
+		
+		void consumeLots(int count);                      //take count units off the oldest lots
+		void notify(int delta);                           //report a stock change to the listener
 		
 	public:
 		Item();
-		Item(string name, double price, int size); 		  //overloaded constructor
+		Item(string name, double price, int size, int depth = 20); //overloaded constructor, depth is the slot capacity
 		
 		void setName(string n);   						  //set name for the item (admin function)
 		void setPrice(double p);  						  //set price for the item (admin function)
@@ -28,14 +45,25 @@ class Item {
 		double getPrice() const;  						  //get price for the item
 		char getChar() const;     						  //get char to represent item in the item interface
 		int getMaxSize() const;                           //get maximum size of queue
+		void setListener(StockListener* l, int itemOpt);  //report stock changes of this slot to l
+		void setMemoryAccount(int account);               //charge the queues to account, moves them into it
 		
 		//methods to interact with the queue (use dynamic pointer)
-		int addStockToQ(int stock);                       //add item to queue
+		int addStockToQ(int stock, long long expiry = 0); //add item to queue as one lot
         void removeStockFromQ(Item item);                 //remove item from queue
         bool isItemQFull() const;                         //check if item queue is full
         bool isItemQEmpty() const;                        //check if item queue is empty
         void clearItemQ();                                //clear the item queue
+        void releaseQ();                                  //free the queues, only for the owner of the last copy
         int getNumStockQ() const;                         //get the number of stock in queue
+        int getLots(vector<Lot>& out) const;              //copy the lots with stock left, oldest first, returns units
+        int takeLots(vector<Lot>& out);                   //move every unit out as lots, oldest first, returns units moved
+        bool setDepth(int depth);                         //change the slot capacity, false if the stock would not fit
+        
+        //lots
+        int purgeExpired(long long now);                  //remove every unit of expired lots, returns how many
+        long long getNextExpiry() const;                  //earliest expiry of the stock left, 0 if none expires
+        int getNumLots() const;                           //number of lots with stock left
 };
 
 Item::Item(){
@@ -43,32 +71,51 @@ Item::Item(){
 	itemPrice = 0.00;
 	itemChar = ' ';
 	itemQueue = nullptr;
+	lotQueue = nullptr;
+	frontLotUsed = 0;
 	maxSize = 20;
+	listener = nullptr;
+	slot = 0;
+	memoryAccount = 0;
 }
 
-Item::Item(string name, double price, int stock){
-	maxSize = 20;
+Item::Item(string name, double price, int stock, int depth){
+	if (depth <= 0) {
+		throw invalid_argument ("Invalid depth!");
+	}
+	
+	maxSize = depth;
 	itemName = name;
 	itemPrice = price;
 	itemChar = toupper(itemName[0]);
 	itemQueue = new Queue<Item>(maxSize);
+	lotQueue = new Queue<Lot>(maxSize); //every lot has at least one unit
+	frontLotUsed = 0;
+	listener = nullptr;
+	slot = 0;
+	memoryAccount = 0;
 	
 	if (stock > maxSize){
 		throw invalid_argument ("Invalid size! Stock cannot exceed maximum."); //cannot run if size is over maximum 
 	}
 	
-	for (int i=0; i<stock; i++){
-        itemQueue->enqueue(*this);
-    }	
+	addStockToQ(stock); //starting stock is one lot without expiry
 }
 
 void Item::setName(string n){
+	MemoryScope scope(memoryAccount, MEM_ITEMS, slot);
 	itemName = n;
 	itemChar = toupper(itemName[0]);
+	if (listener){
+		listener->nameChanged(slot);
+	}
 }
 
 void Item::setPrice(double p){
 	itemPrice = p;
+	if (listener){
+		listener->priceChanged(slot, p);
+	}
 }
 
 string Item::getName() const{
@@ -87,19 +134,46 @@ int Item::getMaxSize() const{
 	return maxSize;
 }
 
+void Item::setListener(StockListener* l, int itemOpt){
+	listener = l;
+	slot = itemOpt;
+}
+
+void Item::setMemoryAccount(int account){
+	memoryAccount = account;
+	if (itemQueue == nullptr){
+		return;
+	}
+	
+	//the queues were allocated by whoever built the item, copy them into the account
+	MemoryScope stock(memoryAccount, MEM_STOCK, slot);
+	itemQueue->resize(itemQueue->getCapacity());
+	MemoryScope lots(memoryAccount, MEM_LOTS, slot);
+	lotQueue->resize(lotQueue->getCapacity());
+}
+
+void Item::notify(int delta){
+	if (listener && delta != 0){
+		listener->stockChanged(slot, delta);
+	}
+}
+
 //------------------------------methods to interact with the queue------------------------------
-int Item::addStockToQ(int stock){
-    int addedCount = 0;  //counter for successfully added items
-
-    for (int i=0; i<stock; ++i){
-        if (!isItemQFull()) {
-            itemQueue->enqueue(*this);
-            addedCount++;
-        }
-        else{
-        	break;
-		}
-    }
+int Item::addStockToQ(int stock, long long expiry){
+    //add as many as fit in one bulk operation, the copies are charged to the slot
+    int addedCount = 0;
+    if (stock > 0) {
+    	MemoryScope scope(memoryAccount, MEM_STOCK, slot);
+    	addedCount = itemQueue->enqueue_n(stock, *this);
+	}
+    
+    if (addedCount > 0) {
+    	Lot lot;
+    	lot.quantity = addedCount;
+    	lot.expiry = expiry;
+    	lotQueue->enqueue(lot);
+    	notify(addedCount);
+	}
     
     if (addedCount < stock){
     	cout << setw(10) << "\n\n\t\t\t" << "   [ QUEUE IS FULL ]" << setw(10) << endl;
@@ -112,6 +186,8 @@ void Item::removeStockFromQ(Item item){
 	
 	if (!isItemQEmpty()){
 		itemQueue->dequeue(item);	
+		consumeLots(1);
+		notify(-1);
 	}
 }
 
@@ -124,11 +200,135 @@ bool Item::isItemQEmpty() const{
 }
 
 void Item::clearItemQ(){
+    int removed = itemQueue->getNumItem();
+    
     itemQueue->clear();
+    lotQueue->clear();
+    frontLotUsed = 0;
+    notify(-removed);
 }
 
 int Item::getNumStockQ() const{
 	return itemQueue->getNumItem();
 }
 
+int Item::getLots(vector<Lot>& out) const{
+	if (lotQueue == nullptr){
+		return 0;
+	}
+	
+	bool first = true;
+	for (const Lot& lot : *lotQueue){
+		Lot left = lot;
+		if (first){
+			left.quantity -= frontLotUsed;
+			first = false;
+		}
+		out.push_back(left);
+	}
+	return itemQueue->getNumItem();
+}
+
+void Item::releaseQ(){
+	//copies share the queues, so whoever frees them must be the last one using them
+	delete itemQueue;
+	delete lotQueue;
+	itemQueue = nullptr;
+	lotQueue = nullptr;
+	frontLotUsed = 0;
+}
+
+int Item::takeLots(vector<Lot>& out){
+	int removed = getLots(out);
+	
+	itemQueue->clear();
+	lotQueue->clear();
+	frontLotUsed = 0;
+	notify(-removed);
+	return removed;
+}
+
+bool Item::setDepth(int depth){
+	if (depth <= 0 || depth < getNumStockQ()){
+		return false;
+	}
+	
+	//every lot has at least one unit, so the lot queue never needs more room than the stock
+	MemoryScope stock(memoryAccount, MEM_STOCK, slot);
+	itemQueue->resize(depth);
+	MemoryScope lots(memoryAccount, MEM_LOTS, slot);
+	lotQueue->resize(depth);
+	maxSize = depth;
+	return true;
+}
+
+//------------------------------methods to interact with the lots------------------------------
+void Item::consumeLots(int count){
+	Lot front;
+	
+	while (count > 0 && lotQueue->peek(front)){
+		int left = front.quantity - frontLotUsed;
+		
+		if (count >= left){
+			lotQueue->dequeue(front); //oldest lot sold out
+			frontLotUsed = 0;
+			count -= left;
+		}
+		else{
+			frontLotUsed += count;
+			count = 0;
+		}
+	}
+}
+
+int Item::purgeExpired(long long now){
+	MemoryScope scope(memoryAccount, MEM_LOTS, slot);
+	vector<Lot> kept;
+	int expired = 0;
+	bool first = true;
+	
+	for (const Lot& lot : *lotQueue){
+		Lot left = lot;
+		if (first){
+			left.quantity -= frontLotUsed;
+			first = false;
+		}
+		
+		if (lot.expiry != 0 && lot.expiry <= now){
+			expired += left.quantity;
+		}
+		else{
+			kept.push_back(left);
+		}
+	}
+	
+	if (expired == 0){
+		return 0;
+	}
+	
+	//units are identical, so removing the count from the queue is enough
+	itemQueue->dequeue_n(nullptr, expired);
+	lotQueue->clear();
+	lotQueue->enqueue_n(kept.data(), (int)kept.size());
+	frontLotUsed = 0;
+	notify(-expired);
+	
+	return expired;
+}
+
+long long Item::getNextExpiry() const{
+	long long next = 0;
+	
+	for (const Lot& lot : *lotQueue){
+		if (lot.expiry != 0 && (next == 0 || lot.expiry < next)){
+			next = lot.expiry;
+		}
+	}
+	return next;
+}
+
+int Item::getNumLots() const{
+	return lotQueue->getNumItem();
+}
+
 #endif
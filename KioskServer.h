@@ -0,0 +1,809 @@
+#ifndef _KIOSK_SERVER_
+#define _KIOSK_SERVER_
+
+//winsock must be included before windows.h (pulled in by Vending_Machine.h)
+#ifndef FD_SETSIZE
+#define FD_SETSIZE 4096     //sockets per select() call, the default of 64 is far too small
+#endif
+#include <winsock2.h>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Vending_Machine.h"
+#include "Session.h"
+#include "Payment.h"
+
+using namespace std;
+
+/*
+ * Line protocol, one command per line, every reply ends with "OK ..." or "ERR ...":
+ *   LIST                  ITEM <index> <price> <stock> <name> lines, then OK <count>
+ *   MACHINE <n>           switch this session to machine n (1-based)
+ *   INSERT <amount>       add cash credit, OK <credit> (or OK VENDED <change> if an item was held)
+ *   BUY <index>           OK VENDED <change>, or OK DUE <amount> and the item is held until paid
+ *   REFUND                return the session credit, OK <amount>
+ *   CARD <index> <account> [key]
+ *                         pay by card or e-wallet, the item is held and OK AUTHORIZING <price> <key>
+ *                         comes back at once; CARD VENDED <code>, CARD DECLINED <reason>,
+ *                         CARD TIMEOUT or CARD REVERSED <reason> follows when the processor answers.
+ *                         A key already in use gets ERR payment in progress, one already
+ *                         paid ERR already paid <code>, so a retried purchase is never charged twice
+ *   RESTOCK <index> <qty> OK <added>
+ *   PRICE <index> <price> OK <price>
+ *   FUNDS <amount>        OK <total money>
+ *                         admin commands run through the session's admin session
+ *   SUMMARY               OK <total stock> <total money>
+ *   SNAPSHOT              SLOT <index> <price> <stock> <sold> <name> lines, then
+ *                         OK <version> <total stock> <total money>, all from one version of the machine
+ *   PLAN                  FILL <machine> <item> <stock> <depth> <fill> for every item below its
+ *                         recommended depth, then OK <units to bring>
+ *   FLEET                 OK <machines> <total stock> <total money> <units sold> <revenue>,
+ *                         rolled up from the machines so the live totals cannot drift
+ *   THRESHOLD <index> <n> low stock alert when the item falls to n, OK <n>
+ *   SUBSCRIBE             OK, then ALERT <type> <machine> <item> <stock> lines as slots cross thresholds
+ *   WATCH                 OK, then EVENT STOCK|PRICE|NAME <machine> <item> <value> and
+ *                         EVENT TITLE|CASH <machine> <value> lines as the machines change
+ *   STATS                 OK <stock> <price> <name> <title> <cash> events published by all machines
+ *   MEMORY                MEM <machine> <subsystem> <bytes> <blocks> and SLOTMEM <machine> <item> <bytes> <blocks>
+ *                         lines, then OK <bytes> <blocks> over all machines
+ *   SCAN <percent> <cash> LOW <machine> <item> <stock> for every item below percent of its capacity,
+ *                         CASH <machine> <money> for every machine with less cash, then OK <low items> <low cash>
+ *   QUIT                  close the session, OK <refund>
+ * A held purchase that gets no input for SESSION_TIMEOUT_MS is cancelled and
+ * the server sends TIMEOUT <refund> on its own. A client that does not read
+ * gets at most MAX_OUTPUT bytes queued: past that its commands wait unread,
+ * and ALERT and EVENT lines are dropped and counted in a DROPPED <lines> line
+ * sent once there is room again. Card payments are authorized
+ * on other threads, so a slow processor never holds up the event loop.
+ */
+class KioskServer : public EventSubscriber {
+	private:
+		struct Session {
+			SOCKET sock;        //client socket
+			string inBuf;       //received bytes not yet forming a full line
+			string outBuf;      //replies waiting to be sent
+			int machineIndex;   //machine this session is talking to
+			int customer;       //id of the customer session in the scheduler
+			bool closing;       //close once outBuf is flushed
+			bool subscribed;    //receives ALERT lines
+			bool watching;      //receives EVENT lines
+			int dropped;        //ALERT and EVENT lines dropped since outBuf was full
+			long long payment;  //card authorization in flight, -1 if none
+			int cardMachine;    //machine, item and held unit it pays for
+			int cardItem;
+			long long cardHold;
+			string cardKey;     //idempotency key of the payment
+		};
+
+		VendingMachine** machines;  //machines served by this server
+		int numMachines;
+		SOCKET listenSock;
+		vector<Session> sessions;
+		SessionScheduler scheduler; //purchase state of every connected client
+		vector<int> ownerOf;        //customer id -> index in sessions
+		FleetAggregate fleet;       //live totals of all machines
+		AlertQueue alerts;          //threshold crossings of all machines
+		FleetStock stockMirror;     //flat slot data of all machines for SCAN
+		ExpiryIndex expiry;         //lots of all machines, one sweep purges the fleet
+		EventCounter metrics;       //events of all machines, for STATS
+		int numWatching;            //sessions receiving EVENT lines
+		PaymentClient* payments;    //card and e-wallet authorizations, nullptr if cash only
+		long long nextPayKey;       //makes idempotency keys unique when the client sends none
+		map<string, string> cardKeys; //keys being authorized (empty) or paid (authorization code)
+		deque<string> paidKeys;     //paid keys, oldest first, only the last MAX_PAID_KEYS are kept
+		fd_set readSet;             //kept as members, they are large with FD_SETSIZE 4096
+		fd_set writeSet;
+		bool running;
+
+		void acceptClients();                               //accept all pending connections
+		bool readSession(Session& s);                       //read and process full lines, false if closed
+		void processLines(Session& s);                      //run the complete lines of inBuf while outBuf has room
+		void push(Session& s, const string& lines);         //queue ALERT or EVENT lines, dropped if outBuf is full
+		bool writeSession(Session& s);                      //flush pending replies, false if closed
+		void closeSession(int index);                       //close the socket and drop the session
+		void expireSessions();                              //cancel held purchases that timed out
+		void publishAlerts();                               //send waiting alerts to subscribed sessions
+		void finishPayments();                              //complete card purchases whose authorization came back
+		string formatReply(int reply, const CustomerSession& c); //protocol line for a session reply
+		bool runAdmin(Session& s, int option, int itemOpt, double value, double& result); //one admin operation, false if refused
+		string handleCommand(Session& s, const string& line); //run one protocol command
+
+	public:
+		static const unsigned long SESSION_TIMEOUT_MS = 60000;
+		static const int MAX_PAID_KEYS = 4096;
+		static const size_t MAX_OUTPUT = 262144;             //bytes queued for one client before it is throttled
+		static const int ROLLUP_THREADS = 4;                 //threads summing the machines for FLEET
+
+		KioskServer(VendingMachine* vms[], int size);        //constructor
+		~KioskServer();                                      //destructor
+		bool start(unsigned short port);                     //listen on 127.0.0.1:port
+		void run();                                          //event loop, returns after stop()
+		void stop();                                         //ask the event loop to finish
+		int getNumSessions() const;                          //number of connected clients
+		void setPayments(PaymentClient* client);             //accept CARD payments through client, nullptr for cash only
+		void onEvent(const MachineEvent& e);                 //forward a machine change to watching sessions
+};
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+KioskServer::KioskServer(VendingMachine* vms[], int size) : scheduler(SESSION_TIMEOUT_MS) {
+	if (size <= 0) {
+		throw invalid_argument ("Server needs at least one vending machine!");
+	}
+
+	machines = vms;
+	numMachines = size;
+	listenSock = INVALID_SOCKET;
+	running = false;
+	numWatching = 0;
+	payments = nullptr;
+	nextPayKey = 1;
+	
+	for (int i = 0; i < numMachines; i++) {
+		machines[i]->setFleet(&fleet);
+		machines[i]->setAlerts(&alerts);
+		machines[i]->setFleetStock(&stockMirror); //machine i gets index i
+		machines[i]->setExpiryIndex(&expiry);
+		machines[i]->subscribe(&metrics);
+		machines[i]->subscribe(this);
+	}
+	fleet.resync(machines, numMachines, ROLLUP_THREADS); //seed the live totals from the machines
+}
+
+KioskServer::~KioskServer() {
+	for (int i = (int)sessions.size() - 1; i >= 0; i--) {
+		closeSession(i);
+	}
+	if (listenSock != INVALID_SOCKET) {
+		closesocket(listenSock);
+		WSACleanup();
+	}
+	for (int i = 0; i < numMachines; i++) {
+		machines[i]->setFleet(nullptr);
+		machines[i]->setAlerts(nullptr);
+		machines[i]->setFleetStock(nullptr);
+		machines[i]->setExpiryIndex(nullptr);
+		machines[i]->unsubscribe(&metrics);
+		machines[i]->unsubscribe(this);
+	}
+}
+
+//-----------------------------------------------------------------event loop-----------------------------------------------------------------
+bool KioskServer::start(unsigned short port) {
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		return false;
+	}
+
+	listenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSock == INVALID_SOCKET) {
+		WSACleanup();
+		return false;
+	}
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); //local clients only
+
+	u_long nonBlocking = 1;
+	if (bind(listenSock, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+		listen(listenSock, SOMAXCONN) == SOCKET_ERROR ||
+		ioctlsocket(listenSock, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+		closesocket(listenSock);
+		listenSock = INVALID_SOCKET;
+		WSACleanup();
+		return false;
+	}
+
+	running = true;
+	return true;
+}
+
+void KioskServer::run() {
+	while (running) {
+		FD_ZERO(&readSet);
+		FD_ZERO(&writeSet);
+
+		//keep one entry for the listening socket
+		if ((int)sessions.size() < FD_SETSIZE - 1) {
+			FD_SET(listenSock, &readSet);
+		}
+		for (size_t i = 0; i < sessions.size(); i++) {
+			if (sessions[i].outBuf.length() < MAX_OUTPUT) {
+				FD_SET(sessions[i].sock, &readSet); //a client that does not read its replies is not read either
+			}
+			if (!sessions[i].outBuf.empty()) {
+				FD_SET(sessions[i].sock, &writeSet);
+			}
+		}
+
+		timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 200000; //wake up regularly so stop() is noticed
+		if (payments != nullptr && payments->getNumPending() > 0) {
+			timeout.tv_usec = 5000; //authorizations come back on other threads, pick them up soon
+		}
+
+		int ready = select(0, &readSet, &writeSet, NULL, &timeout);
+		if (ready == SOCKET_ERROR) {
+			cout << "select() failed with error " << WSAGetLastError() << endl;
+			break;
+		}
+		expireSessions();
+		finishPayments();
+
+		if (ready == 0) {
+			continue;
+		}
+
+		if (FD_ISSET(listenSock, &readSet)) {
+			acceptClients();
+		}
+
+		//walk backwards so closed sessions can be removed in place
+		for (int i = (int)sessions.size() - 1; i >= 0; i--) {
+			Session& s = sessions[i];
+			bool alive = true;
+
+			if (FD_ISSET(s.sock, &readSet)) {
+				alive = readSession(s);
+			}
+			if (alive && !s.outBuf.empty()) {
+				alive = writeSession(s); //try to reply straight away
+				processLines(s);         //commands that waited for room in outBuf
+			}
+			if (!alive || (s.closing && s.outBuf.empty())) {
+				closeSession(i);
+			}
+		}
+		publishAlerts(); //raised by this round of commands, sent on the next select()
+	}
+}
+
+void KioskServer::stop() {
+	running = false;
+}
+
+int KioskServer::getNumSessions() const {
+	return (int)sessions.size();
+}
+
+void KioskServer::setPayments(PaymentClient* client) {
+	payments = client;
+}
+
+void KioskServer::acceptClients() {
+	while ((int)sessions.size() < FD_SETSIZE - 1) {
+		SOCKET client = accept(listenSock, NULL, NULL);
+		if (client == INVALID_SOCKET) {
+			break; //WSAEWOULDBLOCK, no more pending connections
+		}
+
+		u_long nonBlocking = 1;
+		ioctlsocket(client, FIONBIO, &nonBlocking);
+
+		Session s;
+		s.sock = client;
+		s.machineIndex = 0;
+		s.customer = scheduler.open(machines[0]);
+		s.closing = false;
+		s.subscribed = false;
+		s.watching = false;
+		s.dropped = 0;
+		s.payment = -1;
+		s.cardMachine = 0;
+		s.cardItem = 0;
+		s.cardHold = -1;
+		sessions.push_back(s);
+
+		if (s.customer >= (int)ownerOf.size()) {
+			ownerOf.resize(s.customer + 1);
+		}
+		ownerOf[s.customer] = (int)sessions.size() - 1;
+	}
+}
+
+bool KioskServer::readSession(Session& s) {
+	char buffer[4096];
+	int received = recv(s.sock, buffer, sizeof(buffer), 0);
+
+	if (received == 0) {
+		return false; //client closed the connection
+	}
+	if (received == SOCKET_ERROR) {
+		return WSAGetLastError() == WSAEWOULDBLOCK;
+	}
+
+	s.inBuf.append(buffer, received);
+	processLines(s);
+
+	//a client that never sends a newline must not grow the buffer forever
+	if (s.inBuf.length() > 1024 && s.inBuf.find('\n') == string::npos) {
+		s.outBuf += "ERR line too long\n";
+		s.closing = true;
+		s.inBuf.clear();
+	}
+	return true;
+}
+
+void KioskServer::processLines(Session& s) {
+	//process complete lines, keep the rest for later; lines left while outBuf is full
+	//run once the client has read some replies, and nothing more is read until then
+	size_t start = 0;
+	size_t end;
+	while (!s.closing && s.outBuf.length() < MAX_OUTPUT && (end = s.inBuf.find('\n', start)) != string::npos) {
+		string line = s.inBuf.substr(start, end - start);
+		if (!line.empty() && line[line.length() - 1] == '\r') {
+			line.erase(line.length() - 1);
+		}
+		s.outBuf += handleCommand(s, line);
+		start = end + 1;
+	}
+	s.inBuf.erase(0, start);
+}
+
+void KioskServer::push(Session& s, const string& lines) {
+	if (s.outBuf.length() + lines.length() > MAX_OUTPUT) {
+		s.dropped += (int)count(lines.begin(), lines.end(), '\n');
+		return;
+	}
+	if (s.dropped > 0) {
+		s.outBuf += "DROPPED " + to_string(s.dropped) + '\n'; //the client knows to catch up with SNAPSHOT
+		s.dropped = 0;
+	}
+	s.outBuf += lines;
+}
+
+bool KioskServer::writeSession(Session& s) {
+	int sent = send(s.sock, s.outBuf.data(), (int)s.outBuf.length(), 0);
+
+	if (sent == SOCKET_ERROR) {
+		return WSAGetLastError() == WSAEWOULDBLOCK;
+	}
+
+	s.outBuf.erase(0, sent);
+	return true;
+}
+
+void KioskServer::closeSession(int index) {
+	closesocket(sessions[index].sock);
+	scheduler.close(sessions[index].customer);
+	if (sessions[index].payment >= 0) {
+		payments->cancel(sessions[index].payment); //voided if it was approved
+		machines[sessions[index].cardMachine]->releaseItem(sessions[index].cardHold);
+		cardKeys.erase(sessions[index].cardKey);
+	}
+	if (sessions[index].watching) {
+		numWatching--;
+	}
+
+	//order of sessions does not matter, so swap with the last one
+	sessions[index] = sessions.back();
+	ownerOf[sessions[index].customer] = index;
+	sessions.pop_back();
+}
+
+void KioskServer::expireSessions() {
+	unsigned long now = GetTickCount();
+	vector<int> expired, replies;
+	
+	for (int i = 0; i < numMachines; i++) {
+		machines[i]->syncCatalog();
+		machines[i]->expireHolds(now); //units held by stalled clients become available again
+	}
+	expiry.sweep(time(NULL)); //only the slots with a due lot, whatever the fleet size
+	scheduler.expire(now, expired, replies);
+
+	for (size_t i = 0; i < expired.size(); i++) {
+		if (replies[i] == REPLY_REFUNDED) {
+			ostringstream out;
+			out << fixed << setprecision(2) << "TIMEOUT " << scheduler.get(expired[i]).getAmount() << '\n';
+			sessions[ownerOf[expired[i]]].outBuf += out.str();
+		}
+	}
+	publishAlerts(); //expired lots can empty a slot
+}
+
+void KioskServer::publishAlerts() {
+	vector<StockAlert> pending;
+	if (alerts.drain(pending) == 0) {
+		return;
+	}
+
+	ostringstream out;
+	for (size_t i = 0; i < pending.size(); i++) {
+		out << "ALERT " << AlertQueue::getTypeName(pending[i].type) << ' ' << pending[i].machine << ' '
+			<< pending[i].slot << ' ' << pending[i].stock << '\n';
+	}
+	for (size_t i = 0; i < sessions.size(); i++) {
+		if (sessions[i].subscribed) {
+			push(sessions[i], out.str());
+		}
+	}
+}
+
+void KioskServer::finishPayments() {
+	vector<PaymentResult> results;
+	if (payments == nullptr || payments->poll(results) == 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const PaymentResult& r = results[i];
+		int index = (r.tag >= 0 && r.tag < (int)ownerOf.size()) ? ownerOf[r.tag] : -1;
+		if (index < 0 || index >= (int)sessions.size() || sessions[index].customer != r.tag || sessions[index].payment != r.id) {
+			if (r.status == PAY_APPROVED) {
+				payments->reverse(r.key, "", r.amount); //nobody left to vend to
+			}
+			continue;
+		}
+
+		Session& s = sessions[index];
+		VendingMachine& vm = *machines[s.cardMachine];
+		ostringstream out;
+		if (r.status == PAY_APPROVED) {
+			int result = vm.sellCashless(s.cardHold, s.cardItem, r.amount);
+			if (result == SALE_OK) {
+				out << "CARD VENDED " << r.code << '\n';
+				cardKeys[r.key] = r.code;
+				paidKeys.push_back(r.key);
+				if ((int)paidKeys.size() > MAX_PAID_KEYS) {
+					cardKeys.erase(paidKeys.front());
+					paidKeys.pop_front();
+				}
+			}
+			else {
+				payments->reverse(r.key, "", r.amount);
+				out << "CARD REVERSED " << (result == SALE_OUT_OF_STOCK ? "out of stock" : "price changed") << '\n';
+			}
+		}
+		else {
+			vm.releaseItem(s.cardHold);
+			out << (r.status == PAY_DECLINED ? "CARD DECLINED " + r.code : string("CARD TIMEOUT")) << '\n';
+		}
+		if (cardKeys[r.key].empty()) {
+			cardKeys.erase(r.key); //not paid, the key may be tried again
+		}
+		s.payment = -1;
+		s.cardHold = -1;
+		s.outBuf += out.str();
+	}
+	publishAlerts(); //a card sale can empty a slot
+}
+
+void KioskServer::onEvent(const MachineEvent& e) {
+	if (numWatching == 0) {
+		return; //nobody to format the line for
+	}
+
+	ostringstream out;
+	out << fixed << setprecision(2) << "EVENT " << EventBus::getTypeName(e.type) << ' ' << e.machine << ' ';
+	switch (e.type) {
+		case MACHINE_STOCK_CHANGED: out << e.slot << ' ' << e.stock; break;
+		case MACHINE_PRICE_CHANGED: out << e.slot << ' ' << e.value; break;
+		case MACHINE_NAME_CHANGED:  out << e.slot << ' ' << e.text; break;
+		case MACHINE_TITLE_CHANGED: out << e.text; break;
+		default:                    out << e.value; break;
+	}
+	out << '\n';
+
+	for (size_t i = 0; i < sessions.size(); i++) {
+		if (sessions[i].watching) {
+			push(sessions[i], out.str());
+		}
+	}
+}
+
+//-----------------------------------------------------------------protocol-----------------------------------------------------------------
+string KioskServer::handleCommand(Session& s, const string& line) {
+	istringstream in(line);
+	ostringstream out;
+	string cmd;
+	in >> cmd;
+
+	for (char &c : cmd) {
+		c = toupper(c);
+	}
+
+	CustomerSession& customer = scheduler.get(s.customer);
+	VendingMachine& vm = *machines[s.machineIndex];
+	vm.syncCatalog(); //a new catalog applies from the next command on
+	out << fixed << setprecision(2);
+
+	if (cmd.empty()) {
+		return "";
+	}
+	else if (cmd == "LIST") {
+		for (int i = 0; i < vm.getNumQueue(); i++) {
+			const Item& item = vm.getItem(i);
+			out << "ITEM " << i + 1 << ' ' << vm.getCurrentPrice(i + 1) << ' ' << item.getNumStockQ() << ' ' << item.getName() << '\n';
+		}
+		out << "OK " << vm.getNumQueue() << '\n';
+	}
+	else if (cmd == "MACHINE") {
+		int n;
+		if (!(in >> n) || n < 1 || n > numMachines) {
+			out << "ERR invalid machine\n";
+		}
+		else if (!customer.isIdle() || s.payment >= 0) {
+			out << "ERR purchase in progress\n";
+		}
+		else {
+			s.machineIndex = n - 1;
+			customer.setMachine(machines[s.machineIndex]);
+			scheduler.getAdmin(s.customer).setMachine(machines[s.machineIndex]);
+			out << "OK " << machines[s.machineIndex]->getTitle() << '\n';
+		}
+	}
+	else if (cmd == "INSERT") {
+		SessionEvent ev = { EVENT_COIN, 0, 0.0 };
+		if (s.payment >= 0) {
+			out << "ERR card payment in progress\n";
+		}
+		else if (!(in >> ev.amount)) {
+			out << "ERR invalid amount\n";
+		}
+		else {
+			out << formatReply(scheduler.post(s.customer, ev, GetTickCount()), customer);
+		}
+	}
+	else if (cmd == "BUY") {
+		SessionEvent ev = { EVENT_KEY, 0, 0.0 };
+		if (s.payment >= 0) {
+			out << "ERR card payment in progress\n";
+		}
+		else if (!(in >> ev.key)) {
+			out << "ERR invalid item\n";
+		}
+		else {
+			out << formatReply(scheduler.post(s.customer, ev, GetTickCount()), customer);
+		}
+	}
+	else if (cmd == "REFUND") {
+		SessionEvent ev = { EVENT_CANCEL, 0, 0.0 };
+		out << formatReply(scheduler.post(s.customer, ev, GetTickCount()), customer);
+	}
+	else if (cmd == "CARD") {
+		int itemOpt;
+		string account, key;
+		if (payments == nullptr) {
+			out << "ERR cashless payments not available\n";
+		}
+		else if (!(in >> itemOpt >> account) || itemOpt < 1 || itemOpt > vm.getNumQueue()) {
+			out << "ERR invalid card payment\n";
+		}
+		else if (!customer.isIdle() || s.payment >= 0) {
+			out << "ERR purchase in progress\n";
+		}
+		else if ((in >> key) && cardKeys.count(key) > 0) {
+			if (cardKeys[key].empty()) {
+				out << "ERR payment in progress\n";
+			}
+			else {
+				out << "ERR already paid " << cardKeys[key] << '\n';
+			}
+		}
+		else {
+			//the unit stays held until the processor answers, even if it answers late
+			unsigned long now = GetTickCount();
+			long long hold = vm.reserveItem(itemOpt, now, payments->getTimeout() + 5000);
+			if (hold < 0) {
+				out << "ERR out of stock\n";
+			}
+			else {
+				if (key.empty()) {
+					ostringstream made;
+					made << 'm' << s.machineIndex + 1 << '-' << time(NULL) << '-' << nextPayKey++;
+					key = made.str();
+				}
+				cardKeys[key] = "";
+				double price = vm.getHoldPrice(hold);
+				s.payment = payments->authorize(key, account, price, s.customer);
+				s.cardMachine = s.machineIndex;
+				s.cardItem = itemOpt;
+				s.cardHold = hold;
+				s.cardKey = key;
+				out << "OK AUTHORIZING " << price << ' ' << key << '\n';
+			}
+		}
+	}
+	else if (cmd == "RESTOCK") {
+		int itemOpt, stock;
+		double added;
+		if (!(in >> itemOpt >> stock) || !runAdmin(s, 1, itemOpt, stock, added)) {
+			out << "ERR invalid restock\n";
+		}
+		else {
+			out << "OK " << (int)added << '\n';
+		}
+	}
+	else if (cmd == "PRICE") {
+		int itemOpt;
+		double price, set;
+		if (!(in >> itemOpt >> price) || !runAdmin(s, 2, itemOpt, price, set)) {
+			out << "ERR invalid price\n";
+		}
+		else {
+			out << "OK " << set << '\n';
+		}
+	}
+	else if (cmd == "FUNDS") {
+		double amount, total;
+		if (!(in >> amount) || !runAdmin(s, 3, 0, amount, total)) {
+			out << "ERR invalid amount\n";
+		}
+		else {
+			out << "OK " << total << '\n';
+		}
+	}
+	else if (cmd == "SUMMARY") {
+		out << "OK " << vm.getTotalStock() << ' ' << vm.getTotalMoney() << '\n';
+	}
+	else if (cmd == "SNAPSHOT") {
+		const MachineVersion* v = vm.enterSnapshot(vm.getOwnReader());
+		for (int i = 0; i < v->numSlots; i++) {
+			const SlotView& slot = v->getSlot(i);
+			out << "SLOT " << i + 1 << ' ' << slot.price << ' ' << slot.stock << ' ' << slot.sold << ' ' << slot.name << '\n';
+		}
+		out << "OK " << v->version << ' ' << v->totals.stock << ' ' << v->totals.money << '\n';
+		vm.exitSnapshot(vm.getOwnReader());
+	}
+	else if (cmd == "THRESHOLD") {
+		int itemOpt, threshold;
+		if (!(in >> itemOpt >> threshold) || !vm.setLowStockThreshold(itemOpt, threshold)) {
+			out << "ERR invalid threshold\n";
+		}
+		else {
+			out << "OK " << threshold << '\n';
+		}
+	}
+	else if (cmd == "SUBSCRIBE") {
+		s.subscribed = true;
+		out << "OK\n";
+	}
+	else if (cmd == "WATCH") {
+		if (!s.watching) {
+			s.watching = true;
+			numWatching++;
+		}
+		out << "OK\n";
+	}
+	else if (cmd == "MEMORY") {
+		MemoryUsage total = { 0, 0 };
+		for (int i = 0; i < numMachines; i++) {
+			int account = machines[i]->getMemoryAccount();
+			for (int sub = 0; sub < MEM_SUBSYSTEMS; sub++) {
+				MemoryUsage u = MemoryRegistry::getUsage(account, sub);
+				out << "MEM " << i + 1 << ' ' << MemoryRegistry::getSubsystemName(sub) << ' ' << u.bytes << ' ' << u.blocks << '\n';
+			}
+			for (int slot = 1; slot <= machines[i]->getNumQueue() && slot <= MemoryRegistry::MAX_SLOTS; slot++) {
+				MemoryUsage u = MemoryRegistry::getSlotUsage(account, slot);
+				out << "SLOTMEM " << i + 1 << ' ' << slot << ' ' << u.bytes << ' ' << u.blocks << '\n';
+			}
+			MemoryUsage u = MemoryRegistry::getUsage(account);
+			total.bytes += u.bytes;
+			total.blocks += u.blocks;
+		}
+		out << "OK " << total.bytes << ' ' << total.blocks << '\n';
+	}
+	else if (cmd == "STATS") {
+		out << "OK";
+		for (int t = 0; t < MACHINE_EVENT_TYPES; t++) {
+			out << ' ' << metrics.getCount(t);
+		}
+		out << '\n';
+	}
+	else if (cmd == "SCAN") {
+		double percent, cash;
+		vector<int> rows, poor;
+		if (!(in >> percent >> cash) || percent < 0 || cash < 0) {
+			out << "ERR invalid scan\n";
+		}
+		else {
+			stockMirror.scanLowStock((int)percent, &rows);
+			stockMirror.scanLowCash((int)(cash * 100 + 0.5), &poor);
+			for (size_t i = 0; i < rows.size(); i++) {
+				out << "LOW " << stockMirror.getMachine(rows[i]) + 1 << ' ' << stockMirror.getSlot(rows[i]) << ' '
+					<< stockMirror.getCount(rows[i]) << '\n';
+			}
+			for (size_t i = 0; i < poor.size(); i++) {
+				out << "CASH " << poor[i] + 1 << ' ' << machines[poor[i]]->getTotalMoney() << '\n';
+			}
+			out << "OK " << rows.size() << ' ' << poor.size() << '\n';
+		}
+	}
+	else if (cmd == "PLAN") {
+		int units = 0;
+		for (int m = 0; m < numMachines; m++) {
+			vector<FillLine> lines;
+			units += machines[m]->getFillList(lines);
+			for (size_t i = 0; i < lines.size(); i++) {
+				out << "FILL " << m + 1 << ' ' << lines[i].slot << ' ' << lines[i].stock << ' ' << lines[i].depth << ' ' << lines[i].fill << '\n';
+			}
+		}
+		out << "OK " << units << '\n';
+	}
+	else if (cmd == "FLEET") {
+		fleet.resync(machines, numMachines, ROLLUP_THREADS); //on the server thread, no sale can run meanwhile
+		MachineTotals t = fleet.getTotals();
+		out << "OK " << t.machines << ' ' << t.stock << ' ' << t.money << ' ' << t.sold << ' ' << t.revenue << '\n';
+	}
+	else if (cmd == "QUIT") {
+		SessionEvent ev = { EVENT_CANCEL, 0, 0.0 }; //hand back any unspent credit
+		out << formatReply(scheduler.post(s.customer, ev, GetTickCount()), customer);
+		s.closing = true;
+	}
+	else {
+		out << "ERR unknown command\n";
+	}
+
+	return out.str();
+}
+
+bool KioskServer::runAdmin(Session& s, int option, int itemOpt, double value, double& result) {
+	unsigned long now = GetTickCount();
+	SessionEvent choose = { EVENT_KEY, option, 0.0 };
+	SessionEvent item = { EVENT_KEY, itemOpt, 0.0 };
+	SessionEvent enter = { EVENT_COIN, 0, value };
+
+	//the whole operation arrives in one line, so feed every step at once
+	int reply = scheduler.postAdmin(s.customer, choose, now);
+	if (reply == REPLY_NONE && option != 3) {
+		reply = scheduler.postAdmin(s.customer, item, now);
+	}
+	if (reply == REPLY_NONE) {
+		reply = scheduler.postAdmin(s.customer, enter, now);
+	}
+
+	if (reply != REPLY_DONE) {
+		SessionEvent cancel = { EVENT_CANCEL, 0, 0.0 }; //start over, the next command begins with its option
+		scheduler.postAdmin(s.customer, cancel, now);
+		return false;
+	}
+	result = scheduler.getAdmin(s.customer).getAmount();
+	return true;
+}
+
+string KioskServer::formatReply(int reply, const CustomerSession& c) {
+	ostringstream out;
+	out << fixed << setprecision(2);
+
+	switch (reply) {
+		case REPLY_CREDIT:
+		case REPLY_REFUNDED:
+			out << "OK " << c.getAmount() << '\n';
+			break;
+		case REPLY_DUE:
+			out << "OK DUE " << c.getAmount() << '\n';
+			break;
+		case REPLY_VENDED:
+			out << "OK VENDED " << c.getAmount() << '\n';
+			break;
+		case REPLY_INVALID_ITEM:
+			out << "ERR invalid item\n";
+			break;
+		case REPLY_OUT_OF_STOCK:
+			out << "ERR out of stock\n";
+			break;
+		case REPLY_NO_CHANGE:
+			out << "ERR not enough change " << c.getAmount() << '\n';
+			break;
+		case REPLY_INVALID_AMOUNT:
+			out << "ERR invalid amount\n";
+			break;
+		default:
+			out << "OK\n";
+	}
+	return out.str();
+}
+
+#endif
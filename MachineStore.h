@@ -0,0 +1,289 @@
+#ifndef _MACHINE_STORE_
+#define _MACHINE_STORE_
+
+#include <windows.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <list>
+#include <map>
+#include <set>
+#include <cstdio>
+#include "Vending_Machine.h"
+
+using namespace std;
+
+/*
+ * Machines of a large fleet, kept on disk and built on first use. A machine
+ * is read from <folder>/m<id>.state when acquire() first asks for it and
+ * stays in memory while it is used. At most maxResident machines are kept:
+ * past that, the least recently used machine nobody holds is written back,
+ * only if it changed since it was read, and deleted. Files are written to a
+ * temporary name and renamed, so a crash never leaves half a machine behind.
+ *
+ * open() only lists the folder, so startup time and memory follow the
+ * machines in use, not the size of the fleet. Not thread safe: use the store
+ * from the thread that runs its machines.
+ */
+class MachineStore {
+	private:
+		//a machine in memory, and the subscriber that notices it changing
+		struct Resident : public EventSubscriber {
+			int id;
+			VendingMachine* vm;
+			int pins;                   //acquire() calls not released yet
+			bool dirty;                 //changed since it was read or written
+			list<int>::iterator recent; //place in the use order
+
+			void onEvent(const MachineEvent& e);
+		};
+
+		string folder;
+		int maxResident;
+		set<int> known;                 //every machine in the folder or added since
+		map<int, Resident*> resident;   //machines in memory
+		list<int> useOrder;             //resident ids, most recently used first
+		long long numLoads;
+		long long numEvictions;
+		long long numWrites;
+		long long numFailed;            //files that could not be read or written
+
+		string pathOf(int id) const;
+		Resident* load(int id);                      //read a machine from its file, nullptr if unreadable
+		bool save(Resident* r);                      //write a machine to its file
+		void makeResident(int id, VendingMachine* vm, bool dirty);
+		void evict();                                //drop cold machines until at most maxResident are left
+
+		MachineStore(const MachineStore&);
+		MachineStore& operator=(const MachineStore&);
+
+	public:
+		MachineStore(const string& dir, int resident = 64);
+		~MachineStore();                             //writes back every changed machine
+
+		int open();                                  //list the machines in the folder, returns how many
+		bool contains(int id) const;
+		int getNumMachines() const;
+		int getNumResident() const;
+
+		VendingMachine* acquire(int id);             //the machine, read from disk if needed, nullptr if unknown or unreadable
+		void release(int id);                        //done for now, the machine may be written back and deleted
+		bool add(int id, VendingMachine* vm);        //a new machine, the store owns it from now on; false if the id is taken
+		void markChanged(int id);                    //for changes that post no event, such as thresholds
+		int flush();                                 //write back every changed machine, returns how many
+
+		void printStats(ostream& out) const;
+};
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+MachineStore::MachineStore(const string& dir, int resident) {
+	if (resident < 1) {
+		throw invalid_argument("Store must keep at least one machine!");
+	}
+
+	folder = dir;
+	maxResident = resident;
+	numLoads = 0;
+	numEvictions = 0;
+	numWrites = 0;
+	numFailed = 0;
+}
+
+MachineStore::~MachineStore() {
+	flush();
+	for (map<int, Resident*>::iterator it = resident.begin(); it != resident.end(); ++it) {
+		it->second->vm->unsubscribe(it->second);
+		delete it->second->vm;
+		delete it->second;
+	}
+}
+
+//-----------------------------------------------------------------folder-----------------------------------------------------------------
+string MachineStore::pathOf(int id) const {
+	ostringstream path;
+	path << folder << "/m" << id << ".state";
+	return path.str();
+}
+
+int MachineStore::open() {
+	WIN32_FIND_DATA found;
+	HANDLE h = FindFirstFile((folder + "/m*.state").c_str(), &found);
+	if (h == INVALID_HANDLE_VALUE) {
+		return (int)known.size();
+	}
+
+	do {
+		int id;
+		char end;
+		if (sscanf(found.cFileName, "m%d.stat%c", &id, &end) == 2 && end == 'e' && id > 0) {
+			known.insert(id);
+		}
+	} while (FindNextFile(h, &found));
+	FindClose(h);
+
+	return (int)known.size();
+}
+
+bool MachineStore::contains(int id) const {
+	return known.count(id) > 0;
+}
+
+int MachineStore::getNumMachines() const {
+	return (int)known.size();
+}
+
+int MachineStore::getNumResident() const {
+	return (int)resident.size();
+}
+
+//-----------------------------------------------------------------loading & eviction-----------------------------------------------------------------
+void MachineStore::Resident::onEvent(const MachineEvent&) {
+	dirty = true; //any change makes the file stale
+}
+
+MachineStore::Resident* MachineStore::load(int id) {
+	ifstream file(pathOf(id).c_str());
+	string word;
+	int fileId = 0, slots = 0;
+
+	if (!(file >> word >> fileId >> slots) || word != "MACHINE" || fileId != id) {
+		numFailed++;
+		return nullptr;
+	}
+
+	VendingMachine* vm = nullptr;
+	try {
+		vm = new VendingMachine(slots);
+	}
+	catch (const invalid_argument&) {
+		numFailed++;
+		return nullptr; //more slots than a machine has
+	}
+	if (!vm->loadState(file)) {
+		delete vm;
+		numFailed++;
+		return nullptr;
+	}
+
+	numLoads++;
+	makeResident(id, vm, false);
+	return resident[id];
+}
+
+bool MachineStore::save(Resident* r) {
+	string path = pathOf(r->id);
+	string temp = path + ".tmp";
+
+	ofstream file(temp.c_str());
+	file << "MACHINE " << r->id << ' ' << r->vm->getNumSlots() << '\n';
+	r->vm->saveState(file);
+	file.close();
+
+	if (!file || !MoveFileEx(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFile(temp.c_str());
+		numFailed++;
+		return false;
+	}
+
+	numWrites++;
+	r->dirty = false;
+	return true;
+}
+
+void MachineStore::makeResident(int id, VendingMachine* vm, bool dirty) {
+	Resident* r = new Resident;
+	r->id = id;
+	r->vm = vm;
+	r->pins = 0;
+	r->dirty = dirty;
+	useOrder.push_front(id);
+	r->recent = useOrder.begin();
+	resident[id] = r;
+	vm->subscribe(r); //after loading, so reading the file does not count as a change
+}
+
+void MachineStore::evict() {
+	list<int>::iterator it = useOrder.end();
+
+	while ((int)resident.size() > maxResident && it != useOrder.begin()) {
+		--it;
+		Resident* r = resident[*it];
+		if (r->pins > 0 || (r->dirty && !save(r))) {
+			continue; //in use, or cannot be written: keep it rather than lose it
+		}
+
+		r->vm->unsubscribe(r);
+		delete r->vm;
+		resident.erase(r->id);
+		it = useOrder.erase(it);
+		delete r;
+		numEvictions++;
+	}
+}
+
+//-----------------------------------------------------------------access-----------------------------------------------------------------
+VendingMachine* MachineStore::acquire(int id) {
+	Resident* r;
+	map<int, Resident*>::iterator found = resident.find(id);
+
+	if (found != resident.end()) {
+		r = found->second;
+		useOrder.splice(useOrder.begin(), useOrder, r->recent); //most recent now, iterators stay valid
+	}
+	else {
+		if (!contains(id) || (r = load(id)) == nullptr) {
+			return nullptr;
+		}
+	}
+
+	r->pins++;
+	evict(); //r is pinned, so never the one to go
+	return r->vm;
+}
+
+void MachineStore::release(int id) {
+	map<int, Resident*>::iterator found = resident.find(id);
+	if (found == resident.end() || found->second->pins == 0) {
+		return;
+	}
+
+	found->second->pins--;
+	evict();
+}
+
+bool MachineStore::add(int id, VendingMachine* vm) {
+	if (id < 1 || vm == nullptr || contains(id)) {
+		return false;
+	}
+
+	known.insert(id);
+	makeResident(id, vm, true); //nothing on disk yet
+	evict();
+	return true;
+}
+
+void MachineStore::markChanged(int id) {
+	map<int, Resident*>::iterator found = resident.find(id);
+	if (found != resident.end()) {
+		found->second->dirty = true;
+	}
+}
+
+int MachineStore::flush() {
+	int written = 0;
+	for (map<int, Resident*>::iterator it = resident.begin(); it != resident.end(); ++it) {
+		if (it->second->dirty && save(it->second)) {
+			written++;
+		}
+	}
+	return written;
+}
+
+//-----------------------------------------------------------------stats-----------------------------------------------------------------
+void MachineStore::printStats(ostream& out) const {
+	out << "STORE " << known.size() << " machines, " << resident.size() << " in memory, " << numLoads << " loaded, "
+		<< numEvictions << " evicted, " << numWrites << " written, " << numFailed << " failed" << endl;
+}
+
+#endif
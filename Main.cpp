@@ -1,27 +1,261 @@
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <fstream>
+#include "KioskServer.h" //before Vending_Machine.h, winsock2 must come before windows.h
 #include "Item.h"
 #include "Vending_Machine.h"
+#include "Simulator.h"
+#include "Device.h"
+#include "Replication.h"
+#include "AdminBatch.h"
+#include "MachineStore.h"
 
-int main() {
+//the console menu leaves through exit(), so the replication publisher is stopped from here
+static DeltaPublisher* publisher = nullptr;
+
+static void stopPublisher() {
+	if (publisher != nullptr) {
+		publisher->stop(); //ships the last window of changes
+		delete publisher;
+		publisher = nullptr;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	//device emulator: Vending_Machine.exe --device-emulator [customers] [seed], binary events on stdout
+	if (argc > 1 && string(argv[1]) == "--device-emulator") {
+		int customers = (argc > 2) ? atoi(argv[2]) : 20;
+		unsigned int seed = (argc > 3) ? atoi(argv[3]) : GetTickCount();
+		DeviceEmulator emulator(_fileno(stdout), seed); //nothing else may be written to stdout
+		emulator.run(customers);
+		return 0;
+	}
+	
+	//aggregator: Vending_Machine.exe --aggregator [spool], mirrors every machine that replicates into the spool
+	if (argc > 1 && string(argv[1]) == "--aggregator") {
+		string spool = (argc > 2) ? argv[2] : "spool";
+		CreateDirectory(spool.c_str(), NULL); //fails harmlessly if it exists
+		DeltaAggregator aggregator(spool);
+		cout << "Mirroring the fleet from " << spool << endl;
+		aggregator.run();
+		return 0;
+	}
+	
+	//fleet mode: Vending_Machine.exe --fleet <folder> [file] [machines in memory], admin batch against machines kept
+	//on disk, each read only when a command names it; commands from stdin if no file or "-"
+	if (argc > 2 && string(argv[1]) == "--fleet") {
+		MachineStore store(argv[2], (argc > 4 && atoi(argv[4]) > 0) ? atoi(argv[4]) : 64);
+		if (store.open() == 0) {
+			cout << "No machines in " << argv[2] << ", see --fleet-init" << endl;
+			return 1;
+		}
+		AdminBatch batch(&store);
+		
+		if (argc > 3 && string(argv[3]) != "-") {
+			ifstream file(argv[3]);
+			if (!file) {
+				cout << "Unable to open " << argv[3] << endl;
+				return 1;
+			}
+			batch.load(file);
+		}
+		else {
+			batch.load(cin);
+		}
+		batch.apply();
+		store.flush();
+		batch.printReport(cout);
+		store.printStats(cout);
+		return (batch.getNumErrors() > 0) ? 1 : 0;
+	}
+	
+	//items, prices and the title come from catalog.txt, which is reloaded whenever it is saved
+	CatalogWatcher catalog("catalog.txt");
+	
+	//every sale is appended to sales.dat and kept in memory for the reports
+	SalesHistory history;
+	history.open("sales.dat");
+	
+	//sales rates per slot, fill lists are recomputed in the background
+	RestockPlanner planner;
+	
+	//optional price rules, see pricing.txt
+	PricingEngine pricing;
+	string pricingError;
+	bool dynamicPricing = pricing.loadFile("pricing.txt", pricingError);
+	
     //create a vending machine with capacity for 5 items
 	VendingMachine vm(5); 
+	vm.setHistory(&history, 1);
+	vm.setPlanner(&planner);
+	planner.start();
+	if (dynamicPricing) {
+		vm.setPricing(&pricing);
+	}
+	else if (pricingError.compare(0, 11, "cannot open") != 0) {
+		cout << pricingError << endl; //file exists but has a bad rule
+	}
+	
+	if (catalog.checkNow()) {
+		vm.attachCatalog(&catalog);
+		catalog.start();
+	}
+	else {
+	    //no catalog file, create some items to add to the vending machine
+	    Item item1("Cola", 1.50, 19);
+	    Item item2("Sprite", 1.50, 0);
+	    Item item3("Milo", 1.00, 3);
+	    Item item4("Chocolate", 2.00, 20);
+	    Item item5("Tea", 2.50, 12);
+	
+	    //add items to the vending machine
+	    vm.addItem(item1);
+	    vm.addItem(item2);
+	    vm.addItem(item3);
+	    vm.addItem(item4);
+	    vm.addItem(item5);
+	}
+
+    //stock alerts are shown on the admin menu
+    AlertQueue alerts;
+    vm.setAlerts(&alerts);
+
+    //server mode: Vending_Machine.exe --server [port] [card latency ms], cards go to a local mock processor
+    if (argc > 1 && string(argv[1]) == "--server") {
+    	unsigned short port = (argc > 2) ? atoi(argv[2]) : 5050;
+    	unsigned long latency = (argc > 3) ? atoi(argv[3]) : 300;
+    	VendingMachine* machines[] = { &vm };
+    	MockProcessor processor(latency, latency / 3);
+    	PaymentClient payments(&processor); //outlives the server, which cancels what its sessions leave behind
+    	KioskServer server(machines, 1);
+    	if (payments.start()) {
+    		server.setPayments(&payments);
+		}
+    	
+    	if (!server.start(port)) {
+    		cout << "Unable to listen on port " << port << endl;
+    		return 1;
+		}
+		cout << "Serving on 127.0.0.1:" << port << endl;
+		server.run();
+		return 0;
+	}
+
+    //memory mode: Vending_Machine.exe --memory, live memory of every account as tab separated lines
+    if (argc > 1 && string(argv[1]) == "--memory") {
+    	MemoryRegistry::dump(cout);
+    	return 0;
+	}
+
+    //report mode: Vending_Machine.exe --report [days], all sales if days is 0 or missing
+    if (argc > 1 && string(argv[1]) == "--report") {
+    	int days = (argc > 2) ? atoi(argv[2]) : 0;
+    	long long to = time(NULL) + 1;
+    	vm.printSalesReport((days > 0) ? to - days * 86400LL : 0, to);
+    	return 0;
+	}
+
+    //fleet setup: Vending_Machine.exe --fleet-init <folder> <count>, machines 1 to count with the items of this one
+    if (argc > 3 && string(argv[1]) == "--fleet-init") {
+    	int count = atoi(argv[3]);
+    	CreateDirectory(argv[2], NULL); //fails harmlessly if it exists
+    	MachineStore store(argv[2], 1);
+    	if (store.open() > 0) {
+    		cout << argv[2] << " already holds a fleet" << endl;
+    		return 1;
+		}
+		
+		for (int id = 1; id <= count; id++) {
+			VendingMachine* machine = new VendingMachine(vm.getNumSlots());
+			for (int s = 0; s < vm.getNumQueue(); s++) {
+				const Item& item = vm.getItem(s);
+				machine->addItem(Item(item.getName(), item.getPrice(), item.getNumStockQ(), item.getMaxSize())); //own queues, copies share them
+			}
+			store.add(id, machine); //written out as soon as the next one is added
+		}
+		store.flush();
+		store.printStats(cout);
+		return 0;
+	}
+
+    //simulation mode: Vending_Machine.exe --simulate [threads], settings from simulation.txt
+    if (argc > 1 && string(argv[1]) == "--simulate") {
+    	SimSettings settings;
+    	string simError;
+    	if (!settings.loadFile("simulation.txt", simError) && simError.compare(0, 11, "cannot open") != 0) {
+    		cout << simError << endl;
+    		return 1;
+		}
+		
+		int threads = (argc > 2) ? atoi(argv[2]) : Simulator::getNumProcessors();
+		Simulator sim(vm, settings);
+		DWORD started = GetTickCount();
+		int runs = sim.run(threads);
+		sim.printReport();
+		cout << runs << " runs on " << threads << " threads in " << (GetTickCount() - started) / 1000.0 << " s\n";
+		return 0;
+	}
+
+    //planogram mode: Vending_Machine.exe --planogram [days] [threads], slot plan of every machine from the sales of the last days
+    if (argc > 1 && string(argv[1]) == "--planogram") {
+    	int days = (argc > 2 && atoi(argv[2]) > 0) ? atoi(argv[2]) : 7;
+    	int threads = (argc > 3) ? atoi(argv[3]) : Simulator::getNumProcessors();
+    	long long to = time(NULL) + 1;
+    	VendingMachine* machines[] = { &vm };
+    	int ids[] = { 1 };
+    	vector<Planogram> plans(1);
+    	
+    	for (size_t m = 0; m < plans.size(); m++) {
+    		vector<SlotSales> top;
+    		vector<double> rates(machines[m]->getNumQueue(), 0.0);
+    		history.getTopSellers(to - days * 86400LL, to, ids[m], (int)rates.size(), top);
+    		for (size_t i = 0; i < top.size(); i++) {
+    			if (top[i].slot >= 1 && top[i].slot <= (int)rates.size()) {
+    				rates[top[i].slot - 1] = top[i].units / (days * 24.0);
+				}
+			}
+			machines[m]->fillPlanogram(plans[m], rates);
+		}
+		
+		PlanogramOptimizer optimizer;
+		optimizer.solveFleet(plans, threads);
+		for (size_t m = 0; m < plans.size(); m++) {
+			cout << "Machine " << ids[m] << endl;
+			PlanogramOptimizer::printPlan(plans[m], cout);
+			cout << endl;
+		}
+		return 0;
+	}
+
+    //device mode: Vending_Machine.exe --device-emulator | Vending_Machine.exe --device
+    if (argc > 1 && string(argv[1]) == "--device") {
+    	DeviceStream stream(_fileno(stdin));
+    	DeviceTerminal terminal(&vm, &stream);
+    	vm.printItems();
+    	terminal.run();
+    	terminal.printStats();
+    	return 0;
+	}
+
+    //replicated mode: Vending_Machine.exe --replicate [machine] [spool], changes are shipped to the aggregator
+    if (argc > 1 && string(argv[1]) == "--replicate") {
+    	int id = (argc > 2) ? atoi(argv[2]) : 1;
+    	string spool = (argc > 3) ? argv[3] : "spool";
+    	CreateDirectory(spool.c_str(), NULL);
+    	publisher = new DeltaPublisher(id, spool);
+    	if (!publisher->start(&vm)) {
+    		cout << "Unable to replicate to " << spool << endl;
+    		return 1;
+		}
+		atexit(stopPublisher);
+	}
 
-    //create some items to add to the vending machine
-    Item item1("Cola", 1.50, 19);
-    Item item2("Sprite", 1.50, 0);
-    Item item3("Milo", 1.00, 3);
-    Item item4("Chocolate", 2.00, 20);
-    Item item5("Tea", 2.50, 12);
-
-    //add items to the vending machine
-    vm.addItem(item1);
-    vm.addItem(item2);
-    vm.addItem(item3);
-    vm.addItem(item4);
-    vm.addItem(item5);
-
-    //print the vending machine interface
+    //print the vending machine interface, the only place that reads the keyboard
+    InputReader console(_fileno(stdin), 65536, &cout);
+    vm.setInput(&console);
     vm.mainMenu();
+    stopPublisher(); //in case the menu ever returns
      
     return 0;
 }
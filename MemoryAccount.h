@@ -0,0 +1,353 @@
+#ifndef _MEMORY_ACCOUNT_
+#define _MEMORY_ACCOUNT_
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+//what a block of memory is used for
+enum MemorySubsystem {
+	MEM_OTHER = 0,      //machine object, input buffer, timers, anything not listed below
+	MEM_ITEMS,          //item array and item names
+	MEM_STOCK,          //stock queues, one Item per unit
+	MEM_LOTS,           //lot queues for expiry
+	MEM_STATE,          //published snapshot versions and pages
+	MEM_EVENTS,         //event delivery, the grid renderer and other subscribers
+	MEM_SUBSYSTEMS
+};
+
+//live memory of an account, a subsystem or a slot
+struct MemoryUsage {
+	long long bytes;
+	long long blocks;
+};
+
+/*
+ * Memory accounts for machines. Every block from operator new carries a
+ * small header naming the account, subsystem and slot it was charged to,
+ * taken from the MemoryScope of the allocating thread; operator delete
+ * reads the header back, so a block is credited to the right account even
+ * when another thread or scope frees it. Account 0 gets everything
+ * allocated outside a scope.
+ *
+ * An account that is closed while it still holds blocks (memory its owner
+ * leaked) stays listed until they are freed. An owner opened while all
+ * MAX_ACCOUNTS are taken is charged to account 0; the first time that
+ * happens a warning goes to cerr, and dump() reports how many were refused. Build with NO_MEMORY_HOOK to
+ * leave operator new alone; every account then reads zero.
+ */
+class MemoryRegistry {
+	public:
+		static const int MAX_ACCOUNTS = 256;
+		static const int MAX_SLOTS = 8;          //slot 0 is memory not tied to a slot
+
+	private:
+		struct Account {
+			char name[24];
+			atomic<bool> open;
+			atomic<long long> bytes[MEM_SUBSYSTEMS];
+			atomic<long long> blocks[MEM_SUBSYSTEMS];
+			atomic<long long> slotBytes[MAX_SLOTS + 1];
+			atomic<long long> slotBlocks[MAX_SLOTS + 1];
+			atomic<long long> allocations;       //every allocation so far, freed or not
+		};
+
+		//in front of every block, keeps the block 16-byte aligned
+		union Header {
+			struct {
+				size_t size;
+				unsigned short account;
+				unsigned char subsystem;
+				unsigned char slot;
+			} tag;
+			char pad[16];
+		};
+
+		static Account accounts[MAX_ACCOUNTS];  //static storage, usable before main()
+		static atomic<int> lock;                //guards open() and close()
+		static atomic<long long> refused;       //open() calls that found the table full
+
+		static long long live(const Account& a);
+
+	public:
+		static int open(const char* name);                          //new account, 0 if the table is full
+		static void close(int account);                             //owner is gone, kept while blocks remain
+
+		static MemoryUsage getUsage(int account);                   //all subsystems
+		static MemoryUsage getUsage(int account, int subsystem);
+		static MemoryUsage getSlotUsage(int account, int slot);
+		static long long getAllocations(int account);
+		static long long getNumRefused();                           //owners charged to account 0 because the table was full
+		static const char* getSubsystemName(int subsystem);
+
+		static void dump(ostream& out);                             //one line per account and subsystem, tab separated
+
+		//allocator hook
+		static void* allocate(size_t size);
+		static void release(void* block);
+};
+
+/*
+ * Charges the allocations of this thread to an account until the scope ends.
+ * Scopes nest, the previous one is restored.
+ */
+class MemoryScope {
+	private:
+		unsigned int saved;
+
+	public:
+		MemoryScope(int account, int subsystem, int slot = 0);
+		~MemoryScope();
+
+		static thread_local unsigned int current; //account << 16 | subsystem << 8 | slot, one per thread
+};
+
+/*
+ * Base of an object with its own memory account. Everything allocated while
+ * the object and its members are constructed is charged to the account,
+ * until the constructor calls constructed().
+ */
+class MemoryOwner {
+	private:
+		unsigned int saved;
+		bool constructing;
+
+		MemoryOwner(const MemoryOwner&);
+		MemoryOwner& operator=(const MemoryOwner&);
+
+	protected:
+		int memoryAccount;
+
+		MemoryOwner(const char* name);
+		~MemoryOwner();
+		void constructed();                      //stop charging the caller's allocations
+};
+
+MemoryRegistry::Account MemoryRegistry::accounts[MemoryRegistry::MAX_ACCOUNTS];
+atomic<int> MemoryRegistry::lock(0);
+atomic<long long> MemoryRegistry::refused(0);
+thread_local unsigned int MemoryScope::current = 0;
+
+//-----------------------------------------------------------------accounts-----------------------------------------------------------------
+long long MemoryRegistry::live(const Account& a) {
+	long long total = 0;
+	for (int s = 0; s < MEM_SUBSYSTEMS; s++) {
+		total += a.blocks[s].load(memory_order_relaxed);
+	}
+	return total;
+}
+
+int MemoryRegistry::open(const char* name) {
+	int found = 0;
+
+	while (lock.exchange(1, memory_order_acquire)) {
+	}
+	for (int i = 1; i < MAX_ACCOUNTS; i++) {
+		Account& a = accounts[i];
+		if (!a.open && live(a) == 0) {
+			strncpy(a.name, name, sizeof(a.name) - 1);
+			a.name[sizeof(a.name) - 1] = '\0';
+			a.allocations = 0;
+			a.open = true;
+			found = i;
+			break;
+		}
+	}
+	lock.store(0, memory_order_release);
+
+	if (found == 0 && refused.fetch_add(1, memory_order_relaxed) == 0) {
+		cerr << "Memory accounts: all " << MAX_ACCOUNTS << " in use, " << name << " and later owners are counted as unattributed\n";
+	}
+	return found;
+}
+
+void MemoryRegistry::close(int account) {
+	if (account > 0 && account < MAX_ACCOUNTS) {
+		accounts[account].open = false;
+	}
+}
+
+MemoryUsage MemoryRegistry::getUsage(int account) {
+	MemoryUsage total = { 0, 0 };
+	for (int s = 0; s < MEM_SUBSYSTEMS; s++) {
+		MemoryUsage u = getUsage(account, s);
+		total.bytes += u.bytes;
+		total.blocks += u.blocks;
+	}
+	return total;
+}
+
+MemoryUsage MemoryRegistry::getUsage(int account, int subsystem) {
+	const Account& a = accounts[account];
+	MemoryUsage u = { a.bytes[subsystem].load(memory_order_relaxed), a.blocks[subsystem].load(memory_order_relaxed) };
+	return u;
+}
+
+MemoryUsage MemoryRegistry::getSlotUsage(int account, int slot) {
+	const Account& a = accounts[account];
+	MemoryUsage u = { a.slotBytes[slot].load(memory_order_relaxed), a.slotBlocks[slot].load(memory_order_relaxed) };
+	return u;
+}
+
+long long MemoryRegistry::getAllocations(int account) {
+	return accounts[account].allocations.load(memory_order_relaxed);
+}
+
+long long MemoryRegistry::getNumRefused() {
+	return refused.load(memory_order_relaxed);
+}
+
+const char* MemoryRegistry::getSubsystemName(int subsystem) {
+	switch (subsystem) {
+		case MEM_OTHER:  return "machine";
+		case MEM_ITEMS:  return "items";
+		case MEM_STOCK:  return "stock";
+		case MEM_LOTS:   return "lots";
+		case MEM_STATE:  return "snapshots";
+		default:         return "events";
+	}
+}
+
+void MemoryRegistry::dump(ostream& out) {
+	out << "account\tname\tstate\tsubsystem\tbytes\tblocks\n";
+	for (int i = 0; i < MAX_ACCOUNTS; i++) {
+		const Account& a = accounts[i];
+		bool open = (i == 0) || a.open;
+		if (!open && live(a) == 0) {
+			continue;
+		}
+
+		for (int s = 0; s < MEM_SUBSYSTEMS; s++) {
+			MemoryUsage u = getUsage(i, s);
+			if (u.blocks == 0) {
+				continue;
+			}
+			out << i << '\t' << (i == 0 ? "unattributed" : a.name) << '\t' << (open ? "open" : "leaked") << '\t'
+				<< getSubsystemName(s) << '\t' << u.bytes << '\t' << u.blocks << '\n';
+		}
+	}
+	if (getNumRefused() > 0) {
+		out << "# " << getNumRefused() << " owners found all " << MAX_ACCOUNTS << " accounts in use, their memory is in unattributed\n";
+	}
+}
+
+//-----------------------------------------------------------------allocator hook-----------------------------------------------------------------
+void* MemoryRegistry::allocate(size_t size) {
+	Header* h = (Header*)malloc(sizeof(Header) + size);
+	if (h == nullptr) {
+		return nullptr;
+	}
+
+	unsigned int tag = MemoryScope::current;
+	h->tag.size = size;
+	h->tag.account = (unsigned short)(tag >> 16);
+	h->tag.subsystem = (unsigned char)((tag >> 8) & 0xFF);
+	h->tag.slot = (unsigned char)(tag & 0xFF);
+
+	Account& a = accounts[h->tag.account];
+	a.bytes[h->tag.subsystem].fetch_add(size, memory_order_relaxed);
+	a.blocks[h->tag.subsystem].fetch_add(1, memory_order_relaxed);
+	a.slotBytes[h->tag.slot].fetch_add(size, memory_order_relaxed);
+	a.slotBlocks[h->tag.slot].fetch_add(1, memory_order_relaxed);
+	a.allocations.fetch_add(1, memory_order_relaxed);
+
+	return h + 1;
+}
+
+void MemoryRegistry::release(void* block) {
+	if (block == nullptr) {
+		return;
+	}
+
+	Header* h = (Header*)block - 1;
+	Account& a = accounts[h->tag.account];
+	a.bytes[h->tag.subsystem].fetch_sub(h->tag.size, memory_order_relaxed);
+	a.blocks[h->tag.subsystem].fetch_sub(1, memory_order_relaxed);
+	a.slotBytes[h->tag.slot].fetch_sub(h->tag.size, memory_order_relaxed);
+	a.slotBlocks[h->tag.slot].fetch_sub(1, memory_order_relaxed);
+
+	free(h);
+}
+
+//-----------------------------------------------------------------scopes-----------------------------------------------------------------
+MemoryScope::MemoryScope(int account, int subsystem, int slot) {
+	saved = current;
+	if (account < 0 || account >= MemoryRegistry::MAX_ACCOUNTS) {
+		account = 0;
+	}
+	if (subsystem < 0 || subsystem >= MEM_SUBSYSTEMS) {
+		subsystem = MEM_OTHER;
+	}
+	if (slot < 0 || slot > MemoryRegistry::MAX_SLOTS) {
+		slot = 0;
+	}
+	current = ((unsigned int)account << 16) | ((unsigned int)subsystem << 8) | (unsigned int)slot;
+}
+
+MemoryScope::~MemoryScope() {
+	current = saved;
+}
+
+MemoryOwner::MemoryOwner(const char* name) {
+	memoryAccount = MemoryRegistry::open(name);
+	saved = MemoryScope::current;
+	constructing = true;
+	MemoryScope::current = (unsigned int)memoryAccount << 16; //MEM_OTHER, no slot
+}
+
+MemoryOwner::~MemoryOwner() {
+	constructed(); //the constructor threw before getting there
+	MemoryRegistry::close(memoryAccount);
+}
+
+void MemoryOwner::constructed() {
+	if (constructing) {
+		MemoryScope::current = saved;
+		constructing = false;
+	}
+}
+
+#ifndef NO_MEMORY_HOOK
+//-----------------------------------------------------------------operator new & delete-----------------------------------------------------------------
+void* operator new(size_t size) {
+	void* p = MemoryRegistry::allocate(size);
+	if (p == nullptr) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+	return MemoryRegistry::allocate(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+	return MemoryRegistry::allocate(size);
+}
+
+void operator delete(void* block) noexcept {
+	MemoryRegistry::release(block);
+}
+
+void operator delete[](void* block) noexcept {
+	MemoryRegistry::release(block);
+}
+
+void operator delete(void* block, const nothrow_t&) noexcept {
+	MemoryRegistry::release(block);
+}
+
+void operator delete[](void* block, const nothrow_t&) noexcept {
+	MemoryRegistry::release(block);
+}
+#endif
+
+#endif
@@ -0,0 +1,632 @@
+#ifndef _PAYMENT_
+#define _PAYMENT_
+
+#include <windows.h>
+#include <atomic>
+#include <map>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+//what a request asks the processor to do
+enum PaymentOp {
+	PAY_AUTHORIZE = 0,  //take the amount from the account
+	PAY_VOID            //give back an authorization, or refuse it if it has not arrived yet
+};
+
+//outcome of an authorization
+enum PaymentStatus {
+	PAY_APPROVED = 0,   //money taken, code is the authorization code
+	PAY_DECLINED,       //refused by the processor, code is the reason
+	PAY_TIMEOUT         //no answer in time, any approval that still arrives is voided
+};
+
+//one request on the wire
+struct PaymentRequest {
+	long long id;       //client id, answers refer to it
+	int op;             //PaymentOp
+	string key;         //idempotency key, the same on every retry
+	string account;     //card or e-wallet token
+	double amount;
+};
+
+//one answer on the wire
+struct PaymentReply {
+	long long id;
+	bool approved;
+	string code;        //authorization code, or why it was declined
+};
+
+//finished authorization, handed to the caller by poll()
+struct PaymentResult {
+	long long id;       //returned by authorize()
+	int tag;            //caller's value from authorize()
+	int status;         //PaymentStatus
+	string key;
+	double amount;
+	string code;
+};
+
+/*
+ * Connection to a payment processor. process() makes one round trip for a
+ * whole batch and may block for as long as timeoutMs. A request left without
+ * a reply was not answered (the call failed, timed out or lost it) and is
+ * sent again with the same key, so the processor must not charge a key twice.
+ */
+class PaymentProcessor {
+	public:
+		virtual ~PaymentProcessor() {}
+		virtual bool process(const vector<PaymentRequest>& batch, vector<PaymentReply>& replies, unsigned long timeoutMs) = 0;
+};
+
+/*
+ * Local stand-in for a processor. Every call takes latencyMs plus up to
+ * jitterMs; failPercent of the calls fail before reaching it and dropPercent
+ * of the replies are lost after the charge was made. Accounts ending in 0
+ * are declined, like the test cards of real processors. Keys are remembered,
+ * so a retried authorization gets the first answer again, and a void that
+ * arrives before its authorization makes it decline.
+ */
+class MockProcessor : public PaymentProcessor {
+	private:
+		struct Charge {
+			bool approved;
+			bool voided;
+			double amount;
+			string code;
+		};
+
+		map<string, Charge> charges;  //by idempotency key
+		CRITICAL_SECTION lock;        //processor threads share the mock
+		mt19937 rng;
+		unsigned long latencyMs;
+		unsigned long jitterMs;
+		int failPercent;
+		int dropPercent;
+		long long numCalls;
+		long long numCharges;         //approved authorizations, each key once
+		long long numVoids;
+		double charged;               //money taken and not given back
+
+		MockProcessor(const MockProcessor&);
+		MockProcessor& operator=(const MockProcessor&);
+
+	public:
+		MockProcessor(unsigned long latency = 300, unsigned long jitter = 100, int failures = 0, int drops = 0, unsigned int seed = 1);
+		~MockProcessor();
+
+		bool process(const vector<PaymentRequest>& batch, vector<PaymentReply>& replies, unsigned long timeoutMs);
+		void setLatency(unsigned long latency, unsigned long jitter);
+
+		long long getNumCalls();
+		long long getNumCharges();
+		long long getNumVoids();
+		double getCharged();                   //what customers paid in total
+};
+
+/*
+ * Pipelined authorizations for many sessions. authorize() only queues the
+ * request and poll() only collects finished ones, so neither waits for the
+ * processor. Up to numPipelines worker threads each take every queued request
+ * (at most maxBatch) and send it as one batch, so calls overlap and a slow one
+ * holds back only its own batch.
+ *
+ * A request without a reply is retried with the same key after retryMs,
+ * doubling each time. One still unanswered after timeoutMs is reported as
+ * PAY_TIMEOUT and then voided, in case the processor approved it after all.
+ * A cancelled request is dropped if it was never sent, voided if it was.
+ */
+class PaymentClient {
+	private:
+		struct Pending {
+			PaymentRequest request;
+			int tag;                  //caller's value, -1 for voids
+			unsigned long deadline;   //tick count when the caller stops waiting
+			unsigned long nextTry;    //not sent again before this tick count
+			int attempts;             //times sent
+			bool inFlight;            //in a batch a worker is sending
+			bool abandoned;           //cancelled or timed out, an approval is voided
+		};
+
+		PaymentProcessor* processor;
+		map<long long, Pending> pending;     //by request id
+		vector<PaymentResult> finished;      //waiting for poll()
+		CRITICAL_SECTION lock;               //guards pending, finished and the counters
+		HANDLE wake;                         //set when a request can be sent
+		vector<HANDLE> threads;
+		atomic<bool> running;
+		atomic<int> numPending;              //authorizations the caller has not got back yet
+		long long nextId;
+		int numPipelines;
+		int maxBatch;
+		unsigned long timeoutMs;
+		unsigned long retryMs;
+		long long numBatches;
+		long long numRetries;
+		long long numTimeouts;
+		long long numLostVoids;              //voids that never got an answer
+		int largestBatch;
+
+		static DWORD WINAPI threadMain(LPVOID arg);
+		void work();
+		void expire(unsigned long now);      //time out and give up, under the lock
+		void abandon(long long id, unsigned long now); //void or forget a request nobody waits for, under the lock
+
+		PaymentClient(const PaymentClient&);
+		PaymentClient& operator=(const PaymentClient&);
+
+	public:
+		PaymentClient(PaymentProcessor* p, int pipelines = 4, int batchSize = 32, unsigned long timeout = 15000, unsigned long retry = 250);
+		~PaymentClient();
+
+		bool start();
+		void stop();                         //requests still queued are dropped
+
+		long long authorize(const string& key, const string& account, double amount, int tag); //queue, returns the request id
+		void cancel(long long id);           //the caller no longer waits, the result is never reported
+		void reverse(const string& key, const string& account, double amount); //give an approved payment back
+		int poll(vector<PaymentResult>& out); //finished authorizations, returns how many
+
+		int getNumPending() const;
+		unsigned long getTimeout() const;
+		void printStats(ostream& out);
+};
+
+//------------------------------------------------------------------mock processor-----------------------------------------------------------------
+MockProcessor::MockProcessor(unsigned long latency, unsigned long jitter, int failures, int drops, unsigned int seed) : rng(seed) {
+	if (failures < 0 || failures > 100 || drops < 0 || drops > 100) {
+		throw invalid_argument("Failure rates must be between 0 and 100 percent!");
+	}
+
+	InitializeCriticalSection(&lock);
+	latencyMs = latency;
+	jitterMs = jitter;
+	failPercent = failures;
+	dropPercent = drops;
+	numCalls = 0;
+	numCharges = 0;
+	numVoids = 0;
+	charged = 0.0;
+}
+
+MockProcessor::~MockProcessor() {
+	DeleteCriticalSection(&lock);
+}
+
+bool MockProcessor::process(const vector<PaymentRequest>& batch, vector<PaymentReply>& replies, unsigned long timeoutMs) {
+	EnterCriticalSection(&lock);
+	numCalls++;
+	unsigned long delay = latencyMs + (jitterMs > 0 ? rng() % (jitterMs + 1) : 0);
+	bool failed = (int)(rng() % 100) < failPercent;
+	LeaveCriticalSection(&lock);
+
+	//a call that fails never reaches the processor, one that is too slow does
+	//the work but the caller has given up on the replies
+	bool late = delay > timeoutMs;
+	Sleep(late ? timeoutMs : delay);
+	if (failed) {
+		return false;
+	}
+
+	EnterCriticalSection(&lock);
+	for (size_t i = 0; i < batch.size(); i++) {
+		const PaymentRequest& r = batch[i];
+		map<string, Charge>::iterator found = charges.find(r.key);
+		PaymentReply reply;
+		reply.id = r.id;
+
+		if (r.op == PAY_VOID) {
+			if (found == charges.end()) {
+				Charge c = { false, true, r.amount, "voided" }; //the authorization is refused if it turns up
+				charges[r.key] = c;
+			}
+			else if (found->second.approved && !found->second.voided) {
+				found->second.voided = true;
+				charged -= found->second.amount;
+				numVoids++;
+			}
+			reply.approved = true;
+			reply.code = "voided";
+		}
+		else {
+			if (found == charges.end()) {
+				Charge c;
+				c.approved = r.amount > 0 && !r.account.empty() && r.account[r.account.size() - 1] != '0';
+				c.voided = false;
+				c.amount = r.amount;
+				if (c.approved) {
+					char code[24]; //"A" and any long long
+					snprintf(code, sizeof(code), "A%06lld", ++numCharges);
+					c.code = code;
+					charged += r.amount;
+				}
+				else {
+					c.code = "declined";
+				}
+				found = charges.insert(make_pair(r.key, c)).first;
+			}
+			reply.approved = found->second.approved && !found->second.voided;
+			reply.code = found->second.code; //a retry gets the first answer
+		}
+
+		if ((int)(rng() % 100) >= dropPercent && !late) {
+			replies.push_back(reply);
+		}
+	}
+	LeaveCriticalSection(&lock);
+
+	return !late;
+}
+
+void MockProcessor::setLatency(unsigned long latency, unsigned long jitter) {
+	EnterCriticalSection(&lock);
+	latencyMs = latency;
+	jitterMs = jitter;
+	LeaveCriticalSection(&lock);
+}
+
+long long MockProcessor::getNumCalls() {
+	EnterCriticalSection(&lock);
+	long long n = numCalls;
+	LeaveCriticalSection(&lock);
+	return n;
+}
+
+long long MockProcessor::getNumCharges() {
+	EnterCriticalSection(&lock);
+	long long n = numCharges;
+	LeaveCriticalSection(&lock);
+	return n;
+}
+
+long long MockProcessor::getNumVoids() {
+	EnterCriticalSection(&lock);
+	long long n = numVoids;
+	LeaveCriticalSection(&lock);
+	return n;
+}
+
+double MockProcessor::getCharged() {
+	EnterCriticalSection(&lock);
+	double total = charged;
+	LeaveCriticalSection(&lock);
+	return total;
+}
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+PaymentClient::PaymentClient(PaymentProcessor* p, int pipelines, int batchSize, unsigned long timeout, unsigned long retry) {
+	if (p == nullptr || pipelines < 1 || batchSize < 1 || timeout == 0) {
+		throw invalid_argument("Invalid payment client settings!");
+	}
+
+	InitializeCriticalSection(&lock);
+	processor = p;
+	wake = NULL;
+	running = false;
+	numPending = 0;
+	nextId = 1;
+	numPipelines = pipelines;
+	maxBatch = batchSize;
+	timeoutMs = timeout;
+	retryMs = retry;
+	numBatches = 0;
+	numRetries = 0;
+	numTimeouts = 0;
+	numLostVoids = 0;
+	largestBatch = 0;
+}
+
+PaymentClient::~PaymentClient() {
+	stop();
+	DeleteCriticalSection(&lock);
+}
+
+//-----------------------------------------------------------------workers-----------------------------------------------------------------
+bool PaymentClient::start() {
+	if (running) {
+		return true;
+	}
+
+	wake = CreateEvent(NULL, FALSE, FALSE, NULL); //auto-reset, wakes one worker
+	if (wake == NULL) {
+		return false;
+	}
+
+	running = true;
+	for (int i = 0; i < numPipelines; i++) {
+		HANDLE t = CreateThread(NULL, 0, threadMain, this, 0, NULL);
+		if (t != NULL) {
+			threads.push_back(t);
+		}
+	}
+	if (threads.empty()) {
+		running = false;
+		CloseHandle(wake);
+		wake = NULL;
+		return false;
+	}
+	return true;
+}
+
+void PaymentClient::stop() {
+	if (!running) {
+		return;
+	}
+
+	running = false;
+	for (size_t i = 0; i < threads.size(); i++) {
+		SetEvent(wake); //one per worker, each wakes one
+	}
+	for (size_t i = 0; i < threads.size(); i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+	threads.clear();
+	CloseHandle(wake);
+	wake = NULL;
+}
+
+DWORD WINAPI PaymentClient::threadMain(LPVOID arg) {
+	static_cast<PaymentClient*>(arg)->work();
+	return 0;
+}
+
+void PaymentClient::work() {
+	vector<PaymentRequest> batch;
+	vector<PaymentReply> replies;
+
+	while (running) {
+		//take every request that is due, up to a full batch
+		batch.clear();
+		bool more = false;
+		unsigned long now = GetTickCount();
+		EnterCriticalSection(&lock);
+		expire(now);
+		for (map<long long, Pending>::iterator it = pending.begin(); it != pending.end(); ++it) {
+			Pending& p = it->second;
+			if (p.inFlight || (long)(p.nextTry - now) > 0) {
+				continue;
+			}
+			if ((int)batch.size() == maxBatch) {
+				more = true;
+				break;
+			}
+			p.inFlight = true;
+			p.attempts++;
+			batch.push_back(p.request);
+		}
+		if (!batch.empty()) {
+			numBatches++;
+			largestBatch = max(largestBatch, (int)batch.size());
+		}
+		LeaveCriticalSection(&lock);
+
+		if (more) {
+			SetEvent(wake); //another worker takes the rest
+		}
+		if (batch.empty()) {
+			WaitForSingleObject(wake, 50); //retries and timeouts are due within a few ticks
+			continue;
+		}
+
+		//the round trip, without the lock so other batches go out meanwhile
+		replies.clear();
+		processor->process(batch, replies, timeoutMs / 3); //leaves time to retry a call that hangs
+
+		now = GetTickCount();
+		EnterCriticalSection(&lock);
+		for (size_t i = 0; i < replies.size(); i++) {
+			map<long long, Pending>::iterator it = pending.find(replies[i].id);
+			if (it == pending.end() || !it->second.inFlight) {
+				continue; //answered already, or unknown
+			}
+			Pending& p = it->second;
+			p.inFlight = false;
+
+			if (p.request.op == PAY_VOID || (p.abandoned && !replies[i].approved)) {
+				pending.erase(it);
+				continue;
+			}
+			if (p.abandoned) {
+				abandon(it->first, now); //approved after the caller stopped waiting
+				continue;
+			}
+
+			PaymentResult r;
+			r.id = it->first;
+			r.tag = p.tag;
+			r.status = replies[i].approved ? PAY_APPROVED : PAY_DECLINED;
+			r.key = p.request.key;
+			r.amount = p.request.amount;
+			r.code = replies[i].code;
+			finished.push_back(r);
+			pending.erase(it);
+		}
+
+		//everything still in flight from this batch went unanswered
+		for (size_t i = 0; i < batch.size(); i++) {
+			map<long long, Pending>::iterator it = pending.find(batch[i].id);
+			if (it != pending.end() && it->second.inFlight) {
+				Pending& p = it->second;
+				p.inFlight = false;
+				p.nextTry = now + (retryMs << min(p.attempts - 1, 5));
+				numRetries++;
+			}
+		}
+		expire(now);
+		LeaveCriticalSection(&lock);
+	}
+}
+
+void PaymentClient::expire(unsigned long now) {
+	vector<long long> due;
+
+	for (map<long long, Pending>::iterator it = pending.begin(); it != pending.end(); ++it) {
+		if ((long)(now - it->second.deadline) >= 0) {
+			due.push_back(it->first);
+		}
+	}
+
+	for (size_t i = 0; i < due.size(); i++) {
+		Pending& p = pending[due[i]];
+		if (p.request.op == PAY_VOID) {
+			if (!p.inFlight) {
+				numLostVoids++;
+				pending.erase(due[i]);
+			}
+			continue;
+		}
+		if (!p.abandoned) {
+			PaymentResult r;
+			r.id = due[i];
+			r.tag = p.tag;
+			r.status = PAY_TIMEOUT;
+			r.key = p.request.key;
+			r.amount = p.request.amount;
+			finished.push_back(r);
+			numTimeouts++;
+			p.abandoned = true;
+		}
+		if (!p.inFlight) {
+			abandon(due[i], now);
+		}
+	}
+}
+
+void PaymentClient::abandon(long long id, unsigned long now) {
+	Pending& p = pending[id];
+
+	p.abandoned = true;
+	if (p.inFlight) {
+		return; //decided when the reply comes back
+	}
+	if (p.attempts == 0) {
+		pending.erase(id); //never reached the processor
+		return;
+	}
+
+	//the processor may have approved it: the same key as a void, sent until answered
+	p.request.op = PAY_VOID;
+	p.tag = -1;
+	p.attempts = 0;
+	p.nextTry = now;
+	p.deadline = now + timeoutMs * 4;
+	if (wake != NULL) {
+		SetEvent(wake);
+	}
+}
+
+//-----------------------------------------------------------------requests-----------------------------------------------------------------
+long long PaymentClient::authorize(const string& key, const string& account, double amount, int tag) {
+	unsigned long now = GetTickCount();
+	Pending p;
+	p.request.op = PAY_AUTHORIZE;
+	p.request.key = key;
+	p.request.account = account;
+	p.request.amount = amount;
+	p.tag = tag;
+	p.deadline = now + timeoutMs;
+	p.nextTry = now;
+	p.attempts = 0;
+	p.inFlight = false;
+	p.abandoned = false;
+
+	EnterCriticalSection(&lock);
+	long long id = nextId++;
+	p.request.id = id;
+	pending[id] = p;
+	LeaveCriticalSection(&lock);
+
+	numPending++;
+	if (wake != NULL) {
+		SetEvent(wake);
+	}
+	return id;
+}
+
+void PaymentClient::cancel(long long id) {
+	EnterCriticalSection(&lock);
+	map<long long, Pending>::iterator it = pending.find(id);
+	if (it != pending.end() && it->second.request.op == PAY_AUTHORIZE && !it->second.abandoned) {
+		numPending--;
+		abandon(id, GetTickCount());
+	}
+	else {
+		//already finished: drop the result if it has not been collected
+		for (size_t i = 0; i < finished.size(); i++) {
+			if (finished[i].id == id) {
+				if (finished[i].status == PAY_APPROVED) {
+					reverse(finished[i].key, "", finished[i].amount);
+				}
+				finished.erase(finished.begin() + i);
+				numPending--;
+				break;
+			}
+		}
+	}
+	LeaveCriticalSection(&lock);
+}
+
+void PaymentClient::reverse(const string& key, const string& account, double amount) {
+	unsigned long now = GetTickCount();
+	Pending p;
+	p.request.op = PAY_VOID;
+	p.request.key = key;
+	p.request.account = account;
+	p.request.amount = amount;
+	p.tag = -1;
+	p.deadline = now + timeoutMs * 4;
+	p.nextTry = now;
+	p.attempts = 0;
+	p.inFlight = false;
+	p.abandoned = true;
+
+	EnterCriticalSection(&lock);
+	p.request.id = nextId++;
+	pending[p.request.id] = p;
+	LeaveCriticalSection(&lock);
+
+	if (wake != NULL) {
+		SetEvent(wake);
+	}
+}
+
+int PaymentClient::poll(vector<PaymentResult>& out) {
+	if (numPending == 0) {
+		return 0;
+	}
+
+	EnterCriticalSection(&lock);
+	expire(GetTickCount()); //report timeouts even while every worker is stuck in a call
+	int count = (int)finished.size();
+	out.insert(out.end(), finished.begin(), finished.end());
+	finished.clear();
+	LeaveCriticalSection(&lock);
+
+	numPending -= count;
+	return count;
+}
+
+//-----------------------------------------------------------------stats-----------------------------------------------------------------
+int PaymentClient::getNumPending() const {
+	return numPending;
+}
+
+unsigned long PaymentClient::getTimeout() const {
+	return timeoutMs;
+}
+
+void PaymentClient::printStats(ostream& out) {
+	EnterCriticalSection(&lock);
+	out << "batches " << numBatches << ", largest " << largestBatch << ", retries " << numRetries
+		<< ", timeouts " << numTimeouts << ", voids lost " << numLostVoids << endl;
+	LeaveCriticalSection(&lock);
+}
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef _PLANOGRAM_
+#define _PLANOGRAM_
+
+#include <windows.h>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std;
+
+//one item to place, with its demand
+struct PlanItem {
+	string name;
+	double price;
+	double rate;            //units sold per hour
+	int facings;            //result: slots given to the item, 0 if it did not fit
+};
+
+//one slot of the machine
+struct PlanSlot {
+	int depth;              //units the slot holds
+	int item;               //index into items, -1 if empty
+};
+
+//placement of one machine: the optimizer reads the slots as the current
+//layout and replaces them with the new one
+struct Planogram {
+	int machine;
+	vector<PlanItem> items;
+	vector<PlanSlot> slots;
+	double hoursBefore;     //result: hours until the first item runs out with the old layout, -1 if nothing sells
+	double hours;           //result: the same with the new layout
+
+	int findItem(const string& name) const; //index of the item, -1 if not in the plan
+};
+
+/*
+ * Slot optimizer. A machine is restocked when its first item runs out, so
+ * the plan maximises the shortest time any selling item lasts (units it
+ * holds over units sold per hour), then the next shortest, and so on.
+ *
+ * The fastest items get one slot each, deepest slots first (the slowest are
+ * left out if there are more items than slots); every other slot goes to the
+ * item that would run out first. Local search then swaps the items of two
+ * slots, or moves a facing to another item, while that improves the plan;
+ * when neither does, it gives the item that runs out first one more slot and
+ * tries every swap after that.
+ * A machine takes well under a millisecond; a fleet is planned on several
+ * threads, one machine at a time each.
+ */
+class PlanogramOptimizer {
+	private:
+		vector<Planogram>* fleet;   //plans being solved by solveFleet()
+		atomic<int> nextPlan;
+		int maxRounds;              //local search passes per machine
+
+		static void score(const Planogram& p, const vector<int>& owner, vector<double>& hours); //sorted, selling items only
+		static bool better(const vector<double>& a, const vector<double>& b);
+		static DWORD WINAPI threadMain(LPVOID arg);
+		void work();
+
+		PlanogramOptimizer(const PlanogramOptimizer&);
+		PlanogramOptimizer& operator=(const PlanogramOptimizer&);
+
+	public:
+		PlanogramOptimizer(int rounds = 100);
+
+		void solve(Planogram& p) const;                       //one machine
+		int solveFleet(vector<Planogram>& plans, int numThreads); //every machine, returns how many
+		static double evaluate(const Planogram& p);           //hours until the first item of the layout runs out, -1 if nothing sells
+		static void printPlan(const Planogram& p, ostream& out);
+};
+
+//-----------------------------------------------------------------plans-----------------------------------------------------------------
+int Planogram::findItem(const string& name) const {
+	for (int i = 0; i < (int)items.size(); i++) {
+		if (items[i].name == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+//------------------------------------------------------------------constructor-----------------------------------------------------------------
+PlanogramOptimizer::PlanogramOptimizer(int rounds) {
+	fleet = nullptr;
+	nextPlan = 0;
+	maxRounds = rounds;
+}
+
+//-----------------------------------------------------------------scoring-----------------------------------------------------------------
+void PlanogramOptimizer::score(const Planogram& p, const vector<int>& owner, vector<double>& hours) {
+	vector<int> units(p.items.size(), 0);
+
+	for (size_t s = 0; s < owner.size(); s++) {
+		if (owner[s] >= 0) {
+			units[owner[s]] += p.slots[s].depth;
+		}
+	}
+
+	hours.clear();
+	for (size_t i = 0; i < p.items.size(); i++) {
+		if (p.items[i].rate > 0.0) {
+			hours.push_back(units[i] / p.items[i].rate); //an item left out counts as already empty
+		}
+	}
+	sort(hours.begin(), hours.end());
+}
+
+bool PlanogramOptimizer::better(const vector<double>& a, const vector<double>& b) {
+	for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+		if (a[i] > b[i] + 1e-9) {
+			return true;
+		}
+		if (a[i] < b[i] - 1e-9) {
+			return false;
+		}
+	}
+	return false;
+}
+
+double PlanogramOptimizer::evaluate(const Planogram& p) {
+	vector<int> owner(p.slots.size());
+	vector<double> hours;
+
+	for (size_t s = 0; s < p.slots.size(); s++) {
+		owner[s] = p.slots[s].item;
+	}
+	score(p, owner, hours);
+	return hours.empty() ? -1.0 : hours[0];
+}
+
+//-----------------------------------------------------------------solving-----------------------------------------------------------------
+void PlanogramOptimizer::solve(Planogram& p) const {
+	int numItems = (int)p.items.size();
+	int numSlots = (int)p.slots.size();
+	vector<int> byRate(numItems), byDepth(numSlots), owner(numSlots, -1), facings(numItems, 0);
+
+	p.hoursBefore = evaluate(p);
+
+	for (int i = 0; i < numItems; i++) {
+		byRate[i] = i;
+	}
+	for (int s = 0; s < numSlots; s++) {
+		byDepth[s] = s;
+	}
+	stable_sort(byRate.begin(), byRate.end(), [&p](int a, int b) { return p.items[a].rate > p.items[b].rate; });
+	stable_sort(byDepth.begin(), byDepth.end(), [&p](int a, int b) { return p.slots[a].depth > p.slots[b].depth; });
+
+	//greedy: one slot for each of the fastest items, then the rest to whichever runs out first
+	int placed = min(numItems, numSlots);
+	for (int i = 0; i < placed; i++) {
+		owner[byDepth[i]] = byRate[i];
+		facings[byRate[i]]++;
+	}
+	for (int d = placed; d < numSlots && placed > 0; d++) {
+		int best = -1;
+		double bestHours = 0.0;
+		for (int i = 0; i < placed; i++) {
+			int k = byRate[i];
+			if (p.items[k].rate <= 0.0) {
+				continue;
+			}
+			int units = 0;
+			for (int s = 0; s < numSlots; s++) {
+				units += (owner[s] == k) ? p.slots[s].depth : 0;
+			}
+			double h = units / p.items[k].rate;
+			if (best < 0 || h < bestHours) {
+				best = k;
+				bestHours = h;
+			}
+		}
+		if (best < 0) {
+			best = byRate[0]; //nothing sells, the spare slots go to the first item
+		}
+		owner[byDepth[d]] = best;
+		facings[best]++;
+	}
+
+	//local search: swap two slots, or move a facing, while the plan improves
+	vector<double> current, candidate;
+	score(p, owner, current);
+	for (int round = 0; round < maxRounds; round++) {
+		bool improved = false;
+
+		for (int a = 0; a < numSlots; a++) {
+			for (int b = a + 1; b < numSlots; b++) {
+				if (owner[a] == owner[b] || p.slots[a].depth == p.slots[b].depth) {
+					continue;
+				}
+				swap(owner[a], owner[b]);
+				score(p, owner, candidate);
+				if (better(candidate, current)) {
+					current.swap(candidate);
+					improved = true;
+				}
+				else {
+					swap(owner[a], owner[b]);
+				}
+			}
+		}
+
+		for (int a = 0; a < numSlots; a++) {
+			int from = owner[a];
+			if (from < 0 || facings[from] < 2) {
+				continue; //every placed item keeps at least one slot
+			}
+			for (int k = 0; k < numItems; k++) {
+				if (k == owner[a] || facings[k] == 0) {
+					continue;
+				}
+				owner[a] = k;
+				score(p, owner, candidate);
+				if (better(candidate, current)) {
+					current.swap(candidate);
+					facings[from]--;
+					facings[k]++;
+					improved = true;
+					break;
+				}
+				owner[a] = from;
+			}
+		}
+
+		//stuck: give the item that runs out first another slot, then swap any two slots
+		if (!improved && !current.empty()) {
+			int low = -1;
+			double lowHours = 0.0;
+			for (int k = 0; k < numItems; k++) {
+				if (facings[k] > 0 && p.items[k].rate > 0.0) {
+					int units = 0;
+					for (int s = 0; s < numSlots; s++) {
+						units += (owner[s] == k) ? p.slots[s].depth : 0;
+					}
+					if (low < 0 || units / p.items[k].rate < lowHours) {
+						low = k;
+						lowHours = units / p.items[k].rate;
+					}
+				}
+			}
+
+			for (int a = 0; a < numSlots && !improved && low >= 0; a++) {
+				int from = owner[a];
+				if (from < 0 || from == low || facings[from] < 2) {
+					continue;
+				}
+				owner[a] = low;
+				for (int b = 0; b < numSlots && !improved; b++) {
+					for (int c = b + 1; c < numSlots && !improved; c++) {
+						if (owner[b] == owner[c] || p.slots[b].depth == p.slots[c].depth) {
+							continue;
+						}
+						swap(owner[b], owner[c]);
+						score(p, owner, candidate);
+						if (better(candidate, current)) {
+							current.swap(candidate);
+							facings[from]--;
+							facings[low]++;
+							improved = true;
+						}
+						else {
+							swap(owner[b], owner[c]);
+						}
+					}
+				}
+				if (!improved) {
+					owner[a] = from;
+				}
+			}
+		}
+
+		if (!improved) {
+			break;
+		}
+	}
+
+	//slots of the same depth are interchangeable: put faster items first and keep facings together
+	for (int first = 0; first < numSlots; ) {
+		int end = first;
+		vector<int> group;
+		while (end < numSlots && p.slots[end].depth == p.slots[first].depth) {
+			group.push_back(owner[end]);
+			end++;
+		}
+		stable_sort(group.begin(), group.end(), [&p](int a, int b) {
+			if (a < 0 || b < 0) {
+				return b < 0 && a >= 0;
+			}
+			return p.items[a].rate != p.items[b].rate ? p.items[a].rate > p.items[b].rate : a < b;
+		});
+		for (int s = first; s < end; s++) {
+			owner[s] = group[s - first];
+		}
+		first = end;
+	}
+
+	for (int s = 0; s < numSlots; s++) {
+		p.slots[s].item = owner[s];
+	}
+	for (int i = 0; i < numItems; i++) {
+		p.items[i].facings = facings[i];
+	}
+	p.hours = current.empty() ? -1.0 : current[0];
+}
+
+int PlanogramOptimizer::solveFleet(vector<Planogram>& plans, int numThreads) {
+	fleet = &plans;
+	nextPlan = 0;
+
+	if (numThreads < 1) {
+		numThreads = 1;
+	}
+
+	//the calling thread works too, and picks up everything if no thread starts
+	vector<HANDLE> threads;
+	for (int i = 1; i < numThreads; i++) {
+		HANDLE t = CreateThread(NULL, 0, threadMain, this, 0, NULL);
+		if (t != NULL) {
+			threads.push_back(t);
+		}
+	}
+
+	work();
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+	fleet = nullptr;
+	return (int)plans.size();
+}
+
+DWORD WINAPI PlanogramOptimizer::threadMain(LPVOID arg) {
+	static_cast<PlanogramOptimizer*>(arg)->work();
+	return 0;
+}
+
+void PlanogramOptimizer::work() {
+	int total = (int)fleet->size();
+
+	for (int index = nextPlan++; index < total; index = nextPlan++) {
+		solve((*fleet)[index]);
+	}
+}
+
+//-----------------------------------------------------------------report-----------------------------------------------------------------
+void PlanogramOptimizer::printPlan(const Planogram& p, ostream& out) {
+	out << "SLOT PLAN\n";
+	out << setw(55) << setfill('-') << "-" << setfill(' ') << endl;
+	out << left << setw(6) << "Slot" << setw(15) << "Item" << right << setw(8) << "Depth" << setw(14) << "Sales/Hour" << endl;
+	for (size_t s = 0; s < p.slots.size(); s++) {
+		const PlanSlot& slot = p.slots[s];
+		out << left << setw(6) << (s + 1) << setw(15) << (slot.item >= 0 ? p.items[slot.item].name : "(empty)") << right << setw(8) << slot.depth;
+		if (slot.item >= 0) {
+			out << setw(14) << fixed << setprecision(2) << p.items[slot.item].rate;
+		}
+		out << endl;
+	}
+	for (size_t i = 0; i < p.items.size(); i++) {
+		if (p.items[i].facings == 0) {
+			out << left << setw(6) << "-" << setw(15) << p.items[i].name << "left out" << endl;
+		}
+	}
+	out << setw(55) << setfill('-') << "-" << setfill(' ') << endl;
+
+	out << left << setw(21) << "Hours Between Visits" << ": ";
+	if (p.hours < 0) {
+		out << "no sales" << endl;
+	}
+	else {
+		out << fixed << setprecision(1) << p.hoursBefore << " -> " << p.hours << endl;
+	}
+	out << left;
+}
+
+#endif
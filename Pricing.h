@@ -0,0 +1,265 @@
+#ifndef _PRICING_
+#define _PRICING_
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <ctime>
+#include <cstdlib>
+
+using namespace std;
+
+//kinds of pricing rules
+enum PriceRuleType {
+	RULE_TIME_OF_DAY = 0,   //adjust between two hours of the day
+	RULE_NEAR_EXPIRY,       //adjust when the oldest lot expires soon
+	RULE_SURGE,             //adjust when the item sells fast
+	RULE_BUNDLE             //adjust when another item was just bought
+};
+
+//one rule as written in the pricing file
+struct PriceRule {
+	int type;           //PriceRuleType
+	int slot;           //item slot (1-based), 0 for every slot
+	double value;       //from hour, hours left, sales per hour or bundle slot
+	int toHour;         //end hour (exclusive) of a time-of-day rule
+	int percent;        //added to the price, negative for a discount
+};
+
+//what a slot needs from the machine to be priced
+enum PriceInput {
+	NEEDS_EXPIRY = 1,   //next expiry of the slot
+	NEEDS_RATE = 2      //current sales rate of the slot
+};
+
+//state of the machine when a price is asked for
+struct PriceContext {
+	long long now;          //seconds since 1970
+	long long nextExpiry;   //earliest expiry in the slot, 0 if none
+	double salesRate;       //sales per hour of the slot
+	unsigned int basket;    //bit (slot - 1) set for items bought in the bundle window
+};
+
+/*
+ * Rules are compiled into one fixed-size table per slot: a percentage for
+ * every hour of the day (all time-of-day rules added up), and one threshold
+ * and percentage each for near-expiry, surge and bundle (the last rule of a
+ * kind wins). Pricing a unit is then a few table lookups and compares, with
+ * no rule list to walk and no allocation.
+ *
+ * File format, one rule per line, '#' starts a comment, slot * means every slot:
+ *   time   <slot> <from hour> <to hour> <percent>
+ *   expiry <slot> <hours left> <percent>
+ *   surge  <slot> <sales per hour> <percent>
+ *   bundle <slot> <bought with slot> <percent>
+ */
+class PricingEngine {
+	private:
+		static const int MAX_SLOTS = 32;
+
+		struct SlotTable {
+			short hourPercent[24];     //time-of-day adjustment per hour
+			int expiryWithin;          //seconds before expiry the discount starts, 0 if no rule
+			short expiryPercent;
+			float surgeRate;           //sales per hour that start the surge, 0 if no rule
+			short surgePercent;
+			unsigned int bundleMask;   //slots that trigger the bundle price
+			short bundlePercent;
+			int needs;                 //PriceInput bits
+		};
+
+		SlotTable tables[MAX_SLOTS];
+		long long zone;                //local time minus UTC in seconds, for the hour of day
+		int numRules;
+
+		void clear();
+		void apply(const PriceRule& rule, SlotTable& t);
+
+	public:
+		static const unsigned long BUNDLE_WINDOW = 120;   //seconds a purchase counts towards a bundle
+
+		PricingEngine();
+
+		bool loadFile(const string& path, string& error);   //parse and compile a pricing file
+		void compile(const vector<PriceRule>& rules);       //replace the tables
+		int getNeeds(int slot) const;                       //PriceInput bits the slot uses
+		double evaluate(int slot, double basePrice, const PriceContext& c) const; //current price of a slot
+		int getNumRules() const;
+};
+
+//------------------------------------------------------------------constructor-----------------------------------------------------------------
+PricingEngine::PricingEngine() {
+	time_t now = time(NULL);
+	tm utc = *gmtime(&now);
+	zone = (long long)now - (long long)mktime(&utc);
+	clear();
+}
+
+void PricingEngine::clear() {
+	for (int s = 0; s < MAX_SLOTS; s++) {
+		SlotTable& t = tables[s];
+		for (int h = 0; h < 24; h++) {
+			t.hourPercent[h] = 0;
+		}
+		t.expiryWithin = 0;
+		t.expiryPercent = 0;
+		t.surgeRate = 0.0f;
+		t.surgePercent = 0;
+		t.bundleMask = 0;
+		t.bundlePercent = 0;
+		t.needs = 0;
+	}
+	numRules = 0;
+}
+
+//-----------------------------------------------------------------rules-----------------------------------------------------------------
+bool PricingEngine::loadFile(const string& path, string& error) {
+	ifstream file(path.c_str());
+	if (!file) {
+		error = "cannot open " + path;
+		return false;
+	}
+
+	vector<PriceRule> rules;
+	string line;
+	int lineNo = 0;
+
+	while (getline(file, line)) {
+		lineNo++;
+		if (!line.empty() && line[line.length() - 1] == '\r') {
+			line.erase(line.length() - 1);
+		}
+
+		stringstream ss(line);
+		string kind, slotText;
+		if (!(ss >> kind) || kind[0] == '#') {
+			continue;
+		}
+
+		PriceRule r;
+		bool ok = (bool)(ss >> slotText);
+		r.slot = (slotText == "*") ? 0 : atoi(slotText.c_str());
+		r.toHour = 0;
+
+		if (kind == "time") {
+			r.type = RULE_TIME_OF_DAY;
+			ok = ok && (ss >> r.value >> r.toHour >> r.percent) && r.value >= 0 && r.value < 24 && r.toHour >= 0 && r.toHour <= 24;
+		}
+		else if (kind == "expiry") {
+			r.type = RULE_NEAR_EXPIRY;
+			ok = ok && (ss >> r.value >> r.percent) && r.value > 0;
+		}
+		else if (kind == "surge") {
+			r.type = RULE_SURGE;
+			ok = ok && (ss >> r.value >> r.percent) && r.value > 0;
+		}
+		else if (kind == "bundle") {
+			r.type = RULE_BUNDLE;
+			ok = ok && (ss >> r.value >> r.percent) && r.value >= 1 && r.value <= MAX_SLOTS;
+		}
+		else {
+			ok = false;
+		}
+
+		if (!ok || r.slot < 0 || r.slot > MAX_SLOTS || r.percent < -100 || r.percent > 1000) {
+			stringstream msg;
+			msg << path << ":" << lineNo << ": invalid pricing rule";
+			error = msg.str();
+			return false;
+		}
+		rules.push_back(r);
+	}
+
+	compile(rules);
+	return true;
+}
+
+void PricingEngine::compile(const vector<PriceRule>& rules) {
+	clear();
+
+	for (size_t i = 0; i < rules.size(); i++) {
+		if (rules[i].slot == 0) {
+			for (int s = 0; s < MAX_SLOTS; s++) {
+				apply(rules[i], tables[s]);
+			}
+		}
+		else {
+			apply(rules[i], tables[rules[i].slot - 1]);
+		}
+	}
+	numRules = (int)rules.size();
+}
+
+void PricingEngine::apply(const PriceRule& rule, SlotTable& t) {
+	switch (rule.type) {
+		case RULE_TIME_OF_DAY: {
+			//a window like 22 to 6 wraps past midnight, equal hours mean the whole day
+			int from = (int)rule.value;
+			int hours = (rule.toHour % 24 - from + 24) % 24;
+			if (hours == 0) {
+				hours = 24;
+			}
+			for (int k = 0; k < hours; k++) {
+				t.hourPercent[(from + k) % 24] += rule.percent;
+			}
+			break;
+		}
+		case RULE_NEAR_EXPIRY:
+			t.expiryWithin = (int)(rule.value * 3600);
+			t.expiryPercent = rule.percent;
+			t.needs |= NEEDS_EXPIRY;
+			break;
+		case RULE_SURGE:
+			t.surgeRate = (float)rule.value;
+			t.surgePercent = rule.percent;
+			t.needs |= NEEDS_RATE;
+			break;
+		case RULE_BUNDLE:
+			t.bundleMask |= 1u << ((int)rule.value - 1);
+			t.bundlePercent = rule.percent;
+			break;
+	}
+}
+
+//-----------------------------------------------------------------pricing-----------------------------------------------------------------
+int PricingEngine::getNeeds(int slot) const {
+	return (slot >= 1 && slot <= MAX_SLOTS) ? tables[slot - 1].needs : 0;
+}
+
+double PricingEngine::evaluate(int slot, double basePrice, const PriceContext& c) const {
+	if (slot < 1 || slot > MAX_SLOTS) {
+		return basePrice;
+	}
+
+	const SlotTable& t = tables[slot - 1];
+	long long local = c.now + zone;
+	int percent = t.hourPercent[(local % 86400 + 86400) % 86400 / 3600];
+
+	if (t.expiryWithin > 0 && c.nextExpiry > 0 && c.nextExpiry - c.now <= t.expiryWithin) {
+		percent += t.expiryPercent;
+	}
+	if (t.surgeRate > 0.0f && c.salesRate >= t.surgeRate) {
+		percent += t.surgePercent;
+	}
+	if (t.bundleMask & c.basket) {
+		percent += t.bundlePercent;
+	}
+	if (percent == 0) {
+		return basePrice;
+	}
+	if (percent < -90) {
+		percent = -90; //never give an item away
+	}
+
+	//round to 5 sen, the smallest coin
+	double price = floor(basePrice * (100 + percent) / 100.0 * 20 + 0.5) / 20.0;
+	return (price < 0.05) ? 0.05 : price;
+}
+
+int PricingEngine::getNumRules() const {
+	return numRules;
+}
+
+#endif
@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <string>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
 
 using namespace std;
 
@@ -15,7 +18,28 @@ class Queue {
 		int front;
 		int rear;
 		
+		typedef integral_constant<bool, is_trivial<T>::value> Trivial; //true when memcpy can copy T
+		
+		static void copyItems(T* dest, const T* src, int count, true_type);   //memcpy copy
+		static void copyItems(T* dest, const T* src, int count, false_type);  //element by element copy
+		void copyOut(T* dest, int count) const;                                //copy the first count items in FIFO order
+		
 	public:
+		//iterator over the items from front to rear
+		class const_iterator {
+			private:
+				const Queue<T>* queue;
+				int pos;      //position counted from the front
+			public:
+				const_iterator(const Queue<T>* q, int p) : queue(q), pos(p) {}
+				const T& operator*() const { return queue->queueArray[(queue->front + pos) % queue->queueSize]; }
+				const T* operator->() const { return &**this; }
+				const_iterator& operator++() { pos++; return *this; }
+				bool operator==(const const_iterator& other) const { return pos == other.pos; }
+				bool operator!=(const const_iterator& other) const { return pos != other.pos; }
+		};
+		
+
 		Queue(int size); 
 		~Queue();
 		void enqueue(T newItem); 			//add new item(s) to the queue (admin function)
@@ -24,6 +48,17 @@ class Queue {
 		bool isEmpty() const;               //check if queue is empty
 		void clear();                       //reset the queue to 0 if there is no stock left (admin function)
 		int getNumItem() const;
+		
+		//bulk operations, at most two copies each because the array wraps around once
+		int enqueue_n(const T* items, int count);   //add up to count items, returns how many fitted
+		int enqueue_n(int count, const T& item);    //add up to count copies of item, returns how many fitted
+		int dequeue_n(T* items, int count);         //remove up to count items in FIFO order, items may be nullptr to discard
+		bool peek(T &item) const;                   //copy the front item without removing it
+		int getCapacity() const;                    //maximum number of items
+		void reserve(int size);                     //grow the capacity, keeps FIFO order
+		bool resize(int size);                      //set the capacity, false if the items would not fit
+		const_iterator begin() const;
+		const_iterator end() const;
 };
 
 template <class T>
@@ -99,4 +134,125 @@ int Queue<T>::getNumItem() const {
 	return numItem;
 }
 
+//-----------------------------------------------------------------bulk operations-----------------------------------------------------------------
+template <class T>
+void Queue<T>::copyItems(T* dest, const T* src, int count, true_type) {
+	if (count > 0) {
+		memcpy(dest, src, count * sizeof(T));
+	}
+}
+
+template <class T>
+void Queue<T>::copyItems(T* dest, const T* src, int count, false_type) {
+	for (int i = 0; i < count; i++) {
+		dest[i] = src[i];
+	}
+}
+
+template <class T>
+void Queue<T>::copyOut(T* dest, int count) const {
+	int first = min(count, queueSize - front);   //from front to the end of the array
+	copyItems(dest, queueArray + front, first, Trivial());
+	copyItems(dest + first, queueArray, count - first, Trivial()); //wrapped part
+}
+
+template <class T>
+int Queue<T>::enqueue_n(const T* items, int count) {
+	count = min(count, queueSize - numItem);
+	if (count <= 0) {
+		return 0;
+	}
+	
+	int start = (rear + 1) % queueSize;
+	int first = min(count, queueSize - start);
+	copyItems(queueArray + start, items, first, Trivial());
+	copyItems(queueArray, items + first, count - first, Trivial());
+	
+	rear = (rear + count) % queueSize;
+	numItem += count;
+	return count;
+}
+
+template <class T>
+int Queue<T>::enqueue_n(int count, const T& item) {
+	count = min(count, queueSize - numItem);
+	if (count <= 0) {
+		return 0;
+	}
+	
+	int start = (rear + 1) % queueSize;
+	int first = min(count, queueSize - start);
+	fill(queueArray + start, queueArray + start + first, item);
+	fill(queueArray, queueArray + (count - first), item);
+	
+	rear = (rear + count) % queueSize;
+	numItem += count;
+	return count;
+}
+
+template <class T>
+int Queue<T>::dequeue_n(T* items, int count) {
+	count = min(count, numItem);
+	if (count <= 0) {
+		return 0;
+	}
+	
+	if (items) {
+		copyOut(items, count);
+	}
+	
+	front = (front + count) % queueSize;
+	numItem -= count;
+	return count;
+}
+
+template <class T>
+bool Queue<T>::peek(T &item) const {
+	if (isEmpty()) {
+		return false;
+	}
+	item = queueArray[front];
+	return true;
+}
+
+template <class T>
+int Queue<T>::getCapacity() const {
+	return queueSize;
+}
+
+template <class T>
+void Queue<T>::reserve(int size) {
+	if (size > queueSize) {
+		resize(size);
+	}
+}
+
+template <class T>
+bool Queue<T>::resize(int size) {
+	if (size < numItem || size <= 0) {
+		return false;
+	}
+	
+	//copy the items to the start of the new array in FIFO order
+	T* newArray = new T[size];
+	copyOut(newArray, numItem);
+	
+	delete[] queueArray;
+	queueArray = newArray;
+	queueSize = size;
+	front = 0;
+	rear = (numItem == 0) ? queueSize - 1 : numItem - 1;
+	return true;
+}
+
+template <class T>
+typename Queue<T>::const_iterator Queue<T>::begin() const {
+	return const_iterator(this, 0);
+}
+
+template <class T>
+typename Queue<T>::const_iterator Queue<T>::end() const {
+	return const_iterator(this, numItem);
+}
+
 #endif
@@ -0,0 +1,777 @@
+#ifndef _REPLICATION_
+#define _REPLICATION_
+
+#include <windows.h>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include "Vending_Machine.h"
+
+using namespace std;
+
+//what a delta line changes
+enum DeltaField {
+	DELTA_STOCK = 1,      //units and capacity of a slot
+	DELTA_PRICE = 2,      //price of a slot
+	DELTA_NAME = 4,       //item name of a slot
+	DELTA_CASH = 8,       //money inside the machine
+	DELTA_TITLE = 16      //machine title
+};
+
+//one slot of a replicated machine
+struct ReplicaSlot {
+	string name;
+	double price;
+	int stock;
+	int capacity;
+};
+
+//one machine as the publisher or the aggregator knows it
+struct ReplicaMachine {
+	unsigned long seq;          //last batch applied, 0 if none
+	string title;
+	double money;
+	vector<ReplicaSlot> slots;
+	long long batches;          //batches applied
+	long long lines;            //changes applied
+};
+
+/*
+ * The changes of one machine over one window, one spool file each. A full
+ * batch carries every field and replaces the machine, a partial one only
+ * carries the fields that changed in the window:
+ *   DELTA <machine> <seq> <FULL|PART> <slots>
+ *   S <slot> <stock> <capacity>
+ *   P <slot> <price>
+ *   N <slot> <name>
+ *   C <money>
+ *   T <title>
+ *   END
+ */
+struct DeltaBatch {
+	struct Line {
+		int field;          //DeltaField
+		int slot;           //1-based, 0 for cash and title
+		int stock;
+		int capacity;
+		double value;       //price or money
+		string text;        //name or title
+	};
+
+	int machine;
+	unsigned long seq;
+	bool full;
+	int numSlots;
+	vector<Line> lines;
+
+	static const int MAX_SLOTS = 1000;       //more than any machine has, a larger header is corrupt
+
+	void write(ostream& out) const;
+	bool read(istream& in);                  //false if malformed or cut short
+	void apply(ReplicaMachine& m) const;
+};
+
+/*
+ * Machine side of replication. Subscribed to the event bus of a machine, it
+ * keeps the latest value of every slot and marks the fields that changed; a
+ * background thread turns the marks into one batch per window, so a slot
+ * that sells ten units in a window costs one line and an idle machine costs
+ * one read of its ack file.
+ *
+ * Batches go to the spool directory as m<machine>-<seq>.delta, written to a
+ * .tmp file and renamed so the aggregator never reads half a batch, and are
+ * kept until m<machine>.ack says they were applied. While the spool cannot
+ * be written they wait in memory and go out in order once it can. When the
+ * aggregator asks for a resync, the batches after its last acknowledged
+ * sequence number are written again, or a full batch if they are no longer
+ * kept. A new publisher continues the sequence of the spool and starts with
+ * a full batch.
+ */
+class DeltaPublisher : public EventSubscriber {
+	public:
+		static const int MAX_KEPT = 1024;            //unacknowledged batches kept for resending
+		static const unsigned long RESYNC_MS = 5000; //repeat a resync the aggregator keeps asking for
+
+	private:
+		struct Kept {
+			unsigned long seq;
+			string text;
+			bool written;
+		};
+
+		CRITICAL_SECTION lock;
+		ReplicaMachine known;         //latest value of every field
+		vector<int> dirty;            //DeltaField bits per slot, index 0 for cash and title
+		bool needFull;                //next batch carries every field
+		deque<Kept> kept;             //batches not acknowledged yet, oldest first
+		unsigned long nextSeq;
+		unsigned long acked;          //last batch the aggregator applied
+		bool resyncDone;              //a resync was answered at resyncAck
+		unsigned long resyncAck;
+		DWORD resyncTick;
+
+		int machine;
+		string dir;
+		VendingMachine* vm;
+		atomic<bool> running;
+		HANDLE thread;
+		unsigned long windowMs;
+		long long numBatches;
+		long long numLines;
+
+		string getPath(unsigned long seq, const char* ext) const; //m<machine>-<seq>.<ext>, or m<machine>.<ext> for seq 0
+		unsigned long findLastSeq() const;                        //highest batch of this machine in the spool
+		void readAck();
+		static DWORD WINAPI threadMain(LPVOID arg);
+
+		DeltaPublisher(const DeltaPublisher&);
+		DeltaPublisher& operator=(const DeltaPublisher&);
+
+	public:
+		DeltaPublisher(int machineId, const string& spoolDir, unsigned long window = 250);
+		~DeltaPublisher();
+
+		bool start(VendingMachine* m);           //subscribe and ship in the background, call on the machine's thread
+		void stop();                             //ship what is left and unsubscribe, same thread as start()
+		void onEvent(const MachineEvent& e);
+		int flush();                             //one window: read the ack, build and write batches, returns batches written
+
+		unsigned long getAcked();
+		long long getNumBatches();               //batches built so far
+		long long getNumLines();                 //changes in them
+};
+
+/*
+ * Central side of replication. Polls a spool directory shared by the
+ * publishers, applies their batches in sequence order to a mirror of the
+ * whole fleet, acknowledges them and deletes the files, so a poll only reads
+ * what arrived since the last one. A full batch makes the batches before it
+ * unnecessary. A machine the mirror does not know, or whose next batch has
+ * been missing for too many polls, gets the resync flag in its ack file.
+ */
+class DeltaAggregator {
+	private:
+		struct Pending {
+			int machine;
+			unsigned long seq;
+			string file;
+
+			bool operator<(const Pending& p) const { return machine != p.machine ? machine < p.machine : seq < p.seq; }
+		};
+
+		string dir;
+		map<int, ReplicaMachine> mirror;
+		map<int, int> stalled;        //polls a machine has waited for a missing batch
+		int stallPolls;
+		long long numApplied;
+		long long numSkipped;         //duplicates and batches replaced by a full one
+
+		bool writeAck(int machine, unsigned long seq, bool resync) const;
+		int applyMachine(int machine, const vector<Pending>& files);
+
+	public:
+		DeltaAggregator(const string& spoolDir, int stall = 20);
+
+		int poll();                              //apply every batch that is ready, returns how many
+		int resyncAll();                         //ask every machine with an ack file for a full batch
+		void run(unsigned long intervalMs = 250);//poll forever, print the fleet after changes
+
+		const ReplicaMachine* getMachine(int machine) const; //nullptr if not mirrored yet
+		int getNumMachines() const;
+		long long getNumApplied() const;
+		long long getNumSkipped() const;
+		void printFleet(ostream& out) const;
+};
+
+//-----------------------------------------------------------------batches-----------------------------------------------------------------
+void DeltaBatch::write(ostream& out) const {
+	out << fixed << setprecision(2);
+	out << "DELTA " << machine << ' ' << seq << ' ' << (full ? "FULL" : "PART") << ' ' << numSlots << '\n';
+	for (size_t i = 0; i < lines.size(); i++) {
+		const Line& l = lines[i];
+		switch (l.field) {
+			case DELTA_STOCK: out << "S " << l.slot << ' ' << l.stock << ' ' << l.capacity << '\n'; break;
+			case DELTA_PRICE: out << "P " << l.slot << ' ' << l.value << '\n'; break;
+			case DELTA_NAME:  out << "N " << l.slot << ' ' << l.text << '\n'; break;
+			case DELTA_CASH:  out << "C " << l.value << '\n'; break;
+			default:          out << "T " << l.text << '\n'; break;
+		}
+	}
+	out << "END\n";
+}
+
+bool DeltaBatch::read(istream& in) {
+	string line, word, kind;
+
+	if (!getline(in, line)) {
+		return false;
+	}
+	istringstream header(line);
+	if (!(header >> word >> machine >> seq >> kind >> numSlots) || word != "DELTA" || (kind != "FULL" && kind != "PART") ||
+		numSlots < 0 || numSlots > MAX_SLOTS) {
+		return false;
+	}
+	full = (kind == "FULL");
+	lines.clear();
+
+	while (getline(in, line)) {
+		if (line == "END") {
+			return true;
+		}
+
+		Line l;
+		l.slot = 0;
+		l.stock = 0;
+		l.capacity = 0;
+		l.value = 0.0;
+		istringstream fields(line.size() > 2 ? line.substr(2) : "");
+		bool ok;
+		switch (line.empty() ? ' ' : line[0]) {
+			case 'S': l.field = DELTA_STOCK; ok = (bool)(fields >> l.slot >> l.stock >> l.capacity); break;
+			case 'P': l.field = DELTA_PRICE; ok = (bool)(fields >> l.slot >> l.value); break;
+			case 'N':
+				l.field = DELTA_NAME;
+				ok = (bool)(fields >> l.slot) && line.find(' ', 2) != string::npos;
+				l.text = ok ? line.substr(line.find(' ', 2) + 1) : ""; //the rest of the line, may hold spaces
+				break;
+			case 'C': l.field = DELTA_CASH;  ok = (bool)(fields >> l.value); break;
+			case 'T': l.field = DELTA_TITLE; l.text = line.size() > 2 ? line.substr(2) : ""; ok = true; break;
+			default:  ok = false; break;
+		}
+		if (!ok || (l.field <= DELTA_NAME && (l.slot < 1 || l.slot > numSlots))) {
+			return false;
+		}
+		lines.push_back(l);
+	}
+	return false; //no END, the batch was cut short
+}
+
+void DeltaBatch::apply(ReplicaMachine& m) const {
+	ReplicaSlot empty = { "", 0.0, 0, 0 };
+
+	if (full) {
+		m.slots.assign(numSlots, empty);
+		m.title.clear();
+		m.money = 0.0;
+	}
+	else if (numSlots > (int)m.slots.size()) {
+		m.slots.resize(numSlots, empty);
+	}
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		const Line& l = lines[i];
+		switch (l.field) {
+			case DELTA_STOCK: m.slots[l.slot - 1].stock = l.stock; m.slots[l.slot - 1].capacity = l.capacity; break;
+			case DELTA_PRICE: m.slots[l.slot - 1].price = l.value; break;
+			case DELTA_NAME:  m.slots[l.slot - 1].name = l.text; break;
+			case DELTA_CASH:  m.money = l.value; break;
+			default:          m.title = l.text; break;
+		}
+	}
+	m.seq = seq;
+	m.batches++;
+	m.lines += lines.size();
+}
+
+//------------------------------------------------------------------publisher-----------------------------------------------------------------
+DeltaPublisher::DeltaPublisher(int machineId, const string& spoolDir, unsigned long window) {
+	InitializeCriticalSection(&lock);
+	known.seq = 0;
+	known.money = 0.0;
+	known.batches = 0;
+	known.lines = 0;
+	needFull = true;
+	nextSeq = 1;
+	acked = 0;
+	resyncDone = false;
+	resyncAck = 0;
+	resyncTick = 0;
+	machine = machineId;
+	dir = spoolDir;
+	vm = nullptr;
+	running = false;
+	thread = NULL;
+	windowMs = window;
+	numBatches = 0;
+	numLines = 0;
+}
+
+DeltaPublisher::~DeltaPublisher() {
+	stop();
+	DeleteCriticalSection(&lock);
+}
+
+string DeltaPublisher::getPath(unsigned long seq, const char* ext) const {
+	ostringstream path;
+	path << dir << "/m" << machine;
+	if (seq > 0) {
+		path << '-' << seq;
+	}
+	path << '.' << ext;
+	return path.str();
+}
+
+unsigned long DeltaPublisher::findLastSeq() const {
+	WIN32_FIND_DATA found;
+	ostringstream pattern;
+	unsigned long last = 0;
+
+	pattern << dir << "/m" << machine << "-*.delta";
+	HANDLE h = FindFirstFile(pattern.str().c_str(), &found);
+	if (h == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+	do {
+		int id;
+		unsigned long seq;
+		if (sscanf(found.cFileName, "m%d-%lu.delta", &id, &seq) == 2 && id == machine && seq > last) {
+			last = seq;
+		}
+	} while (FindNextFile(h, &found));
+	FindClose(h);
+
+	return last;
+}
+
+bool DeltaPublisher::start(VendingMachine* m) {
+	if (running) {
+		return true;
+	}
+
+	//the bus only reports changes, take the current state once
+	EnterCriticalSection(&lock);
+	vm = m;
+	known.slots.resize(vm->getNumQueue());
+	for (int i = 0; i < vm->getNumQueue(); i++) {
+		const Item& item = vm->getItem(i);
+		known.slots[i].name = item.getName();
+		known.slots[i].price = item.getPrice();
+		known.slots[i].stock = item.getNumStockQ();
+		known.slots[i].capacity = item.getMaxSize();
+	}
+	known.title = vm->getTitle();
+	known.money = vm->getTotalMoney();
+	dirty.assign(known.slots.size() + 1, 0);
+	needFull = true;
+	LeaveCriticalSection(&lock);
+	vm->subscribe(this);
+
+	readAck();
+	nextSeq = max(acked, findLastSeq()) + 1; //continue after the batches a previous publisher left
+
+	running = true;
+	thread = CreateThread(NULL, 0, threadMain, this, 0, NULL);
+	if (thread == NULL) {
+		running = false;
+		vm->unsubscribe(this);
+		return false;
+	}
+	return true;
+}
+
+void DeltaPublisher::stop() {
+	if (!running) {
+		return;
+	}
+
+	running = false;
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+	thread = NULL;
+	vm->unsubscribe(this);
+	flush(); //changes of the last window
+}
+
+DWORD WINAPI DeltaPublisher::threadMain(LPVOID arg) {
+	DeltaPublisher* self = static_cast<DeltaPublisher*>(arg);
+
+	while (self->running) {
+		Sleep(self->windowMs);
+		self->flush();
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------changes-----------------------------------------------------------------
+void DeltaPublisher::onEvent(const MachineEvent& e) {
+	EnterCriticalSection(&lock);
+	if (e.type == MACHINE_CASH_CHANGED) {
+		known.money = e.value;
+		dirty[0] |= DELTA_CASH;
+	}
+	else if (e.type == MACHINE_TITLE_CHANGED) {
+		known.title = e.text;
+		dirty[0] |= DELTA_TITLE;
+	}
+	else if (e.slot >= 1) {
+		if (e.slot > (int)known.slots.size()) {
+			known.slots.resize(e.slot);
+			dirty.resize(e.slot + 1, 0);
+		}
+		ReplicaSlot& s = known.slots[e.slot - 1];
+		switch (e.type) {
+			case MACHINE_STOCK_CHANGED: s.stock = e.stock; s.capacity = e.capacity; dirty[e.slot] |= DELTA_STOCK; break;
+			case MACHINE_PRICE_CHANGED: s.price = e.value; dirty[e.slot] |= DELTA_PRICE; break;
+			default:                    s.name = e.text; dirty[e.slot] |= DELTA_NAME; break;
+		}
+	}
+	LeaveCriticalSection(&lock);
+}
+
+//-----------------------------------------------------------------shipping-----------------------------------------------------------------
+void DeltaPublisher::readAck() {
+	ifstream in(getPath(0, "ack").c_str());
+	unsigned long seq;
+	int resync;
+
+	if (!(in >> seq >> resync)) {
+		return; //no aggregator yet
+	}
+
+	EnterCriticalSection(&lock);
+	if (seq > acked) {
+		acked = seq;
+		while (!kept.empty() && kept.front().seq <= seq) {
+			kept.pop_front();
+		}
+	}
+
+	if (resync && (!resyncDone || seq != resyncAck || GetTickCount() - resyncTick >= RESYNC_MS)) {
+		resyncDone = true;
+		resyncAck = seq;
+		resyncTick = GetTickCount();
+		if (!kept.empty() && kept.front().seq <= seq + 1) {
+			for (size_t i = 0; i < kept.size(); i++) {
+				if (kept[i].seq > seq) {
+					kept[i].written = false; //the aggregator lost them, write them again
+				}
+			}
+		}
+		else {
+			needFull = true;
+		}
+	}
+	LeaveCriticalSection(&lock);
+}
+
+int DeltaPublisher::flush() {
+	vector<Kept> toWrite;
+	int written = 0;
+
+	readAck();
+
+	EnterCriticalSection(&lock);
+	bool changed = needFull;
+	for (size_t i = 0; i < dirty.size() && !changed; i++) {
+		changed = (dirty[i] != 0);
+	}
+
+	if (changed) {
+		if ((int)kept.size() >= MAX_KEPT) {
+			kept.clear(); //aggregator is far behind, one full batch replaces them all
+			needFull = true;
+		}
+
+		DeltaBatch b;
+		b.machine = machine;
+		b.seq = nextSeq++;
+		b.full = needFull;
+		b.numSlots = (int)known.slots.size();
+		for (int slot = 0; slot <= b.numSlots; slot++) {
+			int fields = needFull ? (slot == 0 ? DELTA_CASH | DELTA_TITLE : DELTA_STOCK | DELTA_PRICE | DELTA_NAME) : dirty[slot];
+			for (int field = DELTA_STOCK; field <= DELTA_TITLE; field <<= 1) {
+				if (!(fields & field)) {
+					continue;
+				}
+				DeltaBatch::Line l;
+				l.field = field;
+				l.slot = slot;
+				l.stock = 0;
+				l.capacity = 0;
+				l.value = 0.0;
+				if (slot == 0) {
+					l.value = known.money;
+					l.text = known.title;
+				}
+				else {
+					const ReplicaSlot& s = known.slots[slot - 1];
+					l.stock = s.stock;
+					l.capacity = s.capacity;
+					l.value = s.price;
+					l.text = s.name;
+				}
+				b.lines.push_back(l);
+			}
+			dirty[slot] = 0;
+		}
+		needFull = false;
+
+		ostringstream text;
+		b.write(text);
+		Kept k = { b.seq, text.str(), false };
+		kept.push_back(k);
+		numBatches++;
+		numLines += b.lines.size();
+	}
+
+	for (size_t i = 0; i < kept.size(); i++) {
+		if (!kept[i].written) {
+			toWrite.push_back(kept[i]);
+		}
+	}
+	LeaveCriticalSection(&lock);
+
+	//file work happens outside the lock, sales never wait for the disk
+	for (size_t i = 0; i < toWrite.size(); i++) {
+		string tmp = getPath(toWrite[i].seq, "tmp");
+		ofstream out(tmp.c_str(), ios::binary);
+		out << toWrite[i].text;
+		out.close();
+		if (!out || !MoveFileEx(tmp.c_str(), getPath(toWrite[i].seq, "delta").c_str(), MOVEFILE_REPLACE_EXISTING)) {
+			break; //spool unavailable, keep the order and try again next window
+		}
+		written++;
+	}
+
+	EnterCriticalSection(&lock);
+	for (size_t i = 0; i < kept.size() && written > 0; i++) {
+		if (!kept[i].written && kept[i].seq <= toWrite[written - 1].seq) {
+			kept[i].written = true;
+		}
+	}
+	LeaveCriticalSection(&lock);
+
+	return written;
+}
+
+unsigned long DeltaPublisher::getAcked() {
+	EnterCriticalSection(&lock);
+	unsigned long seq = acked;
+	LeaveCriticalSection(&lock);
+	return seq;
+}
+
+long long DeltaPublisher::getNumBatches() {
+	EnterCriticalSection(&lock);
+	long long n = numBatches;
+	LeaveCriticalSection(&lock);
+	return n;
+}
+
+long long DeltaPublisher::getNumLines() {
+	EnterCriticalSection(&lock);
+	long long n = numLines;
+	LeaveCriticalSection(&lock);
+	return n;
+}
+
+//------------------------------------------------------------------aggregator-----------------------------------------------------------------
+DeltaAggregator::DeltaAggregator(const string& spoolDir, int stall) {
+	dir = spoolDir;
+	stallPolls = stall;
+	numApplied = 0;
+	numSkipped = 0;
+}
+
+bool DeltaAggregator::writeAck(int machine, unsigned long seq, bool resync) const {
+	ostringstream name;
+	name << dir << "/m" << machine;
+	string tmp = name.str() + ".acktmp";
+
+	ofstream out(tmp.c_str());
+	out << seq << ' ' << (resync ? 1 : 0) << '\n';
+	out.close();
+	return out && MoveFileEx(tmp.c_str(), (name.str() + ".ack").c_str(), MOVEFILE_REPLACE_EXISTING);
+}
+
+int DeltaAggregator::poll() {
+	WIN32_FIND_DATA found;
+	vector<Pending> files;
+	int applied = 0;
+
+	HANDLE h = FindFirstFile((dir + "/m*.delta").c_str(), &found);
+	if (h != INVALID_HANDLE_VALUE) {
+		do {
+			Pending p;
+			if (sscanf(found.cFileName, "m%d-%lu.delta", &p.machine, &p.seq) == 2) {
+				p.file = dir + "/" + found.cFileName;
+				files.push_back(p);
+			}
+		} while (FindNextFile(h, &found));
+		FindClose(h);
+	}
+	sort(files.begin(), files.end());
+
+	//one machine at a time, in sequence order
+	for (size_t first = 0; first < files.size(); ) {
+		size_t end = first;
+		while (end < files.size() && files[end].machine == files[first].machine) {
+			end++;
+		}
+		applied += applyMachine(files[first].machine, vector<Pending>(files.begin() + first, files.begin() + end));
+		first = end;
+	}
+	return applied;
+}
+
+int DeltaAggregator::applyMachine(int machine, const vector<Pending>& files) {
+	map<int, ReplicaMachine>::iterator it = mirror.find(machine);
+	bool known = (it != mirror.end());
+	unsigned long last = known ? it->second.seq : 0;
+	vector<DeltaBatch> batches(files.size());
+	vector<bool> ok(files.size());
+	int start = 0;
+
+	//a full batch replaces everything before it
+	for (size_t i = 0; i < files.size(); i++) {
+		ifstream in(files[i].file.c_str(), ios::binary);
+		ok[i] = batches[i].read(in) && batches[i].machine == machine && batches[i].seq == files[i].seq;
+		if (ok[i] && batches[i].full && batches[i].seq > last) {
+			start = (int)i;
+		}
+	}
+
+	ReplicaMachine m;
+	if (known) {
+		m = it->second;
+	}
+	else {
+		m.seq = 0;
+		m.money = 0.0;
+		m.batches = 0;
+		m.lines = 0;
+	}
+
+	vector<string> done;
+	int applied = 0;
+	bool gap = false;
+	for (size_t i = 0; i < files.size(); i++) {
+		const DeltaBatch& b = batches[i];
+		if ((int)i < start || (ok[i] && b.seq <= m.seq && (known || applied > 0))) {
+			done.push_back(files[i].file); //old or duplicate
+			numSkipped++;
+			continue;
+		}
+		if (!ok[i]) {
+			done.push_back(files[i].file); //damaged, the resync brings it back
+			gap = true;
+			break;
+		}
+		if (!b.full && (!(known || applied > 0) || b.seq != m.seq + 1)) {
+			gap = true; //an earlier batch has not arrived yet
+			break;
+		}
+		b.apply(m);
+		done.push_back(files[i].file);
+		applied++;
+	}
+
+	if (applied > 0) {
+		mirror[machine] = m;
+		stalled[machine] = 0;
+		numApplied += applied;
+	}
+
+	bool resync = false;
+	if (gap) {
+		int waited = stalled[machine]++;
+		if (known || applied > 0) {
+			resync = ((waited + 1) % stallPolls == 0);
+		}
+		else {
+			resync = (waited % stallPolls == 0); //nothing to build on, ask for a full batch at once
+		}
+	}
+
+	//acknowledge before deleting, a file seen again after a crash is only a duplicate
+	if ((applied == 0 && !resync) || writeAck(machine, m.seq, resync)) {
+		for (size_t i = 0; i < done.size(); i++) {
+			DeleteFile(done[i].c_str());
+		}
+	}
+	return applied;
+}
+
+int DeltaAggregator::resyncAll() {
+	WIN32_FIND_DATA found;
+	int count = 0;
+
+	HANDLE h = FindFirstFile((dir + "/m*.ack").c_str(), &found);
+	if (h == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+	do {
+		int id;
+		if (sscanf(found.cFileName, "m%d.ack", &id) == 1 && mirror.find(id) == mirror.end()) {
+			count += writeAck(id, 0, true) ? 1 : 0;
+		}
+	} while (FindNextFile(h, &found));
+	FindClose(h);
+
+	return count;
+}
+
+void DeltaAggregator::run(unsigned long intervalMs) {
+	resyncAll(); //the mirror starts empty, machines that are idle would never be seen
+
+	while (true) {
+		if (poll() > 0) {
+			printFleet(cout);
+		}
+		Sleep(intervalMs);
+	}
+}
+
+//-----------------------------------------------------------------mirror-----------------------------------------------------------------
+const ReplicaMachine* DeltaAggregator::getMachine(int machine) const {
+	map<int, ReplicaMachine>::const_iterator it = mirror.find(machine);
+	return (it == mirror.end()) ? nullptr : &it->second;
+}
+
+int DeltaAggregator::getNumMachines() const {
+	return (int)mirror.size();
+}
+
+long long DeltaAggregator::getNumApplied() const {
+	return numApplied;
+}
+
+long long DeltaAggregator::getNumSkipped() const {
+	return numSkipped;
+}
+
+void DeltaAggregator::printFleet(ostream& out) const {
+	int units = 0;
+	double money = 0.0;
+
+	for (map<int, ReplicaMachine>::const_iterator it = mirror.begin(); it != mirror.end(); ++it) {
+		for (size_t i = 0; i < it->second.slots.size(); i++) {
+			units += it->second.slots[i].stock;
+		}
+		money += it->second.money;
+	}
+
+	out << fixed << setprecision(2);
+	out << "Fleet: " << mirror.size() << " machines, " << units << " units, RM " << money << "\n";
+	for (map<int, ReplicaMachine>::const_iterator it = mirror.begin(); it != mirror.end(); ++it) {
+		const ReplicaMachine& m = it->second;
+		out << "  m" << left << setw(4) << it->first << " seq " << setw(6) << m.seq << " RM " << right << setw(8) << m.money << "  " << m.title << "\n";
+		for (size_t i = 0; i < m.slots.size(); i++) {
+			const ReplicaSlot& s = m.slots[i];
+			out << "      [" << (i + 1) << "] " << left << setw(15) << s.name << right << setw(3) << s.stock << "/" << left << setw(3) << s.capacity
+				<< " RM " << right << setw(6) << s.price << "\n";
+		}
+	}
+	out << left;
+	out.flush();
+}
+
+#endif
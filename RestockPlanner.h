@@ -0,0 +1,275 @@
+#ifndef _RESTOCK_PLANNER_
+#define _RESTOCK_PLANNER_
+
+#include <windows.h>
+#include <atomic>
+#include <vector>
+#include <cmath>
+#include <ctime>
+
+using namespace std;
+
+//one line of a machine's fill list
+struct FillLine {
+	int slot;          //item slot (1-based)
+	int stock;         //units in the slot now
+	int depth;         //recommended units after the visit
+	int fill;          //units to bring, depth - stock
+	double rate;       //estimated sales per hour
+};
+
+/*
+ * Restock plans driven by demand. Every sale updates an exponentially
+ * weighted sales rate of its slot:
+ *   rate = rate * exp(-elapsed / tau) + 1 / tau
+ * which needs no history and forgets old demand with the given half-life.
+ * The recommended depth of a slot covers the expected sales until the next
+ * visit plus a safety margin, between minDepth and the slot capacity.
+ *
+ * Sales and stock changes only mark their slot dirty. A background thread
+ * recomputes the dirty slots and refreshes every slot once in a while so
+ * rates decay between sales; machines and readers never wait on a full
+ * fleet recompute.
+ */
+class RestockPlanner {
+	private:
+		struct SlotPlan {
+			double rate;          //sales per second at lastSale
+			long long lastSale;   //time of the last sale, 0 if none
+			int stock;
+			int capacity;         //0 while the slot is unused
+			int depth;            //recommended depth, from the last recompute
+			double planRate;      //sales per hour used for depth
+			bool dirty;
+		};
+
+		CRITICAL_SECTION lock;
+		vector<SlotPlan> slots;
+		vector<int> firstRow;         //first row of every machine
+		vector<int> dirtyRows;        //rows waiting for a recompute
+		double tau;                   //decay time constant in seconds
+		double coverHours;            //time until the next visit
+		int minDepth;                 //depth of a slot without demand
+
+		atomic<bool> running;
+		HANDLE thread;
+		unsigned long waitMs;         //recompute interval of the thread
+		unsigned long refreshMs;      //interval for refreshing every slot
+
+		void markDirty(int row);      //lock must be held
+		int computeDepth(double ratePerHour, int capacity) const;
+		static DWORD WINAPI threadMain(LPVOID arg);
+
+		RestockPlanner(const RestockPlanner&);
+		RestockPlanner& operator=(const RestockPlanner&);
+
+	public:
+		RestockPlanner(double halfLifeHours = 24, double cover = 48, int minimum = 3, unsigned long wait = 500);
+		~RestockPlanner();
+
+		int addMachine(int numSlots);                             //reserve slots for a machine, returns its index
+		void removeMachine(int machine);
+		void setStock(int machine, int slot, int stock, int capacity);
+		void recordSale(int machine, int slot, long long now);    //one unit sold
+		void setRate(int machine, int slot, double ratePerHour, long long now); //carry a rate over when items change slots
+
+		int recompute(long long now);                             //recompute the dirty slots, returns how many
+		void refreshAll();                                        //mark every slot dirty
+		bool start();                                             //recompute in a background thread
+		void stop();
+
+		double getRate(int machine, int slot, long long now);     //sales per hour, decayed to now
+		int getFillList(int machine, vector<FillLine>& out);      //slots that need stock, returns units to bring
+};
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+RestockPlanner::RestockPlanner(double halfLifeHours, double cover, int minimum, unsigned long wait) {
+	InitializeCriticalSection(&lock);
+	tau = halfLifeHours * 3600.0 / log(2.0);
+	coverHours = cover;
+	minDepth = minimum;
+	running = false;
+	thread = NULL;
+	waitMs = wait;
+	refreshMs = 600000; //re-plan slots without sales every ten minutes
+}
+
+RestockPlanner::~RestockPlanner() {
+	stop();
+	DeleteCriticalSection(&lock);
+}
+
+//-----------------------------------------------------------------machines-----------------------------------------------------------------
+int RestockPlanner::addMachine(int numSlots) {
+	EnterCriticalSection(&lock);
+	int machine = (int)firstRow.size();
+	firstRow.push_back((int)slots.size());
+
+	SlotPlan empty = { 0.0, 0, 0, 0, 0, 0.0, false };
+	slots.insert(slots.end(), numSlots, empty);
+	LeaveCriticalSection(&lock);
+	return machine;
+}
+
+void RestockPlanner::removeMachine(int machine) {
+	EnterCriticalSection(&lock);
+	int end = (machine + 1 < (int)firstRow.size()) ? firstRow[machine + 1] : (int)slots.size();
+	for (int row = firstRow[machine]; row < end; row++) {
+		slots[row].capacity = 0; //no longer planned
+		slots[row].depth = 0;
+	}
+	LeaveCriticalSection(&lock);
+}
+
+void RestockPlanner::setStock(int machine, int slot, int stock, int capacity) {
+	EnterCriticalSection(&lock);
+	int row = firstRow[machine] + slot - 1;
+	slots[row].stock = stock;
+	if (slots[row].capacity != capacity) {
+		slots[row].capacity = capacity;
+		markDirty(row);
+	}
+	LeaveCriticalSection(&lock);
+}
+
+void RestockPlanner::recordSale(int machine, int slot, long long now) {
+	EnterCriticalSection(&lock);
+	SlotPlan& p = slots[firstRow[machine] + slot - 1];
+	double elapsed = (p.lastSale > 0 && now > p.lastSale) ? (double)(now - p.lastSale) : 0.0;
+	p.rate = p.rate * exp(-elapsed / tau) + 1.0 / tau;
+	p.lastSale = now;
+	markDirty(firstRow[machine] + slot - 1);
+	LeaveCriticalSection(&lock);
+}
+
+void RestockPlanner::setRate(int machine, int slot, double ratePerHour, long long now) {
+	EnterCriticalSection(&lock);
+	int row = firstRow[machine] + slot - 1;
+	slots[row].rate = ratePerHour / 3600.0;
+	slots[row].lastSale = (ratePerHour > 0.0) ? now : 0;
+	markDirty(row);
+	LeaveCriticalSection(&lock);
+}
+
+void RestockPlanner::markDirty(int row) {
+	if (!slots[row].dirty) {
+		slots[row].dirty = true;
+		dirtyRows.push_back(row);
+	}
+}
+
+//-----------------------------------------------------------------planning-----------------------------------------------------------------
+int RestockPlanner::computeDepth(double ratePerHour, int capacity) const {
+	//expected sales until the next visit, plus about one and a half standard deviations (Poisson)
+	double expected = ratePerHour * coverHours;
+	int depth = (int)ceil(expected + 1.65 * sqrt(expected));
+
+	if (depth < minDepth) {
+		depth = minDepth;
+	}
+	return (depth < capacity) ? depth : capacity;
+}
+
+int RestockPlanner::recompute(long long now) {
+	vector<int> rows;
+
+	EnterCriticalSection(&lock);
+	rows.swap(dirtyRows);
+	for (size_t i = 0; i < rows.size(); i++) {
+		SlotPlan& p = slots[rows[i]];
+		double elapsed = (p.lastSale > 0 && now > p.lastSale) ? (double)(now - p.lastSale) : 0.0;
+		p.planRate = p.rate * exp(-elapsed / tau) * 3600.0;
+		p.depth = computeDepth(p.planRate, p.capacity);
+		p.dirty = false;
+	}
+	LeaveCriticalSection(&lock);
+
+	return (int)rows.size();
+}
+
+void RestockPlanner::refreshAll() {
+	EnterCriticalSection(&lock);
+	for (int row = 0; row < (int)slots.size(); row++) {
+		markDirty(row);
+	}
+	LeaveCriticalSection(&lock);
+}
+
+bool RestockPlanner::start() {
+	if (running) {
+		return true;
+	}
+
+	running = true;
+	thread = CreateThread(NULL, 0, threadMain, this, 0, NULL);
+	if (thread == NULL) {
+		running = false;
+		return false;
+	}
+	return true;
+}
+
+void RestockPlanner::stop() {
+	if (!running) {
+		return;
+	}
+
+	running = false;
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+	thread = NULL;
+}
+
+DWORD WINAPI RestockPlanner::threadMain(LPVOID arg) {
+	RestockPlanner* self = static_cast<RestockPlanner*>(arg);
+	unsigned long sinceRefresh = 0;
+
+	while (self->running) {
+		Sleep(self->waitMs);
+
+		sinceRefresh += self->waitMs;
+		if (sinceRefresh >= self->refreshMs) {
+			self->refreshAll(); //let rates of slots without sales decay
+			sinceRefresh = 0;
+		}
+		self->recompute(time(NULL));
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------plans-----------------------------------------------------------------
+double RestockPlanner::getRate(int machine, int slot, long long now) {
+	EnterCriticalSection(&lock);
+	const SlotPlan& p = slots[firstRow[machine] + slot - 1];
+	double elapsed = (p.lastSale > 0 && now > p.lastSale) ? (double)(now - p.lastSale) : 0.0;
+	double rate = p.rate * exp(-elapsed / tau) * 3600.0;
+	LeaveCriticalSection(&lock);
+	return rate;
+}
+
+int RestockPlanner::getFillList(int machine, vector<FillLine>& out) {
+	int total = 0;
+
+	EnterCriticalSection(&lock);
+	int end = (machine + 1 < (int)firstRow.size()) ? firstRow[machine + 1] : (int)slots.size();
+	for (int row = firstRow[machine]; row < end; row++) {
+		const SlotPlan& p = slots[row];
+		if (p.capacity == 0 || p.stock >= p.depth) {
+			continue;
+		}
+
+		FillLine line;
+		line.slot = row - firstRow[machine] + 1;
+		line.stock = p.stock;
+		line.depth = p.depth;
+		line.fill = p.depth - p.stock;
+		line.rate = p.planRate;
+		out.push_back(line);
+		total += line.fill;
+	}
+	LeaveCriticalSection(&lock);
+
+	return total;
+}
+
+#endif
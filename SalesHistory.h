@@ -0,0 +1,491 @@
+#ifndef _SALES_HISTORY_
+#define _SALES_HISTORY_
+
+#include <cstdio>
+#include <io.h>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+//outcome of a recorded sale
+enum SaleStatus {
+	SALE_RECORD_OK = 0,       //item dispensed
+	SALE_RECORD_NO_CHANGE     //refused, the machine could not give change
+};
+
+//one sale, also the record layout of the history file
+struct SaleRecord {
+	long long time;       //seconds since 1970
+	int machine;          //machine id
+	int slot;             //item slot (1-based)
+	int priceCents;
+	int tenderedCents;
+	int changeCents;      //change given, or the change that could not be given
+	int status;           //SaleStatus
+};
+
+//sales of one slot, for the top sellers
+struct SlotSales {
+	int machine;
+	int slot;
+	long long units;
+	long long revenueCents;
+};
+
+/*
+ * Append-only sales history stored by column. Rows are collected in an open
+ * segment; every SEGMENT_ROWS rows the segment is sealed and each column is
+ * packed as base + offset in 1, 2 or 4 bytes, whichever fits the segment.
+ * Sealed segments keep their time range, so queries skip segments outside
+ * the asked period without unpacking them.
+ *
+ * Queries unpack one segment at a time into int columns and scan them four
+ * rows at a time with SSE2 compares (plain loops without SSE2). Every sale is
+ * also appended to the history file, which is read back on open().
+ */
+class SalesHistory {
+	private:
+		static const int SEGMENT_ROWS = 4096;
+		enum { COL_TIME, COL_MACHINE, COL_SLOT, COL_PRICE, COL_TENDERED, COL_CHANGE, COL_STATUS, NUM_COLUMNS };
+
+		//one packed column of a sealed segment
+		struct Column {
+			long long base;                 //smallest value, offsets are added to it
+			int width;                      //bytes per offset: 1, 2 or 4
+			vector<unsigned char> data;
+		};
+
+		struct Segment {
+			int rows;
+			long long minTime;
+			long long maxTime;
+			Column columns[NUM_COLUMNS];
+		};
+
+		//unpacked rows of one segment, time is kept relative to timeBase
+		struct Block {
+			int rows;
+			long long timeBase;
+			int* col[NUM_COLUMNS];
+		};
+
+		vector<Segment> segments;             //sealed segments
+		vector<long long> openRows[NUM_COLUMNS]; //rows of the segment being filled
+		FILE* file;                           //history file, nullptr if not persisted
+		long long numRows;
+		mutable vector<int> scratch;          //unpack buffer for queries
+
+		void append(const SaleRecord& r);     //add a row in memory
+		void seal();                          //pack the open rows into a segment
+		static void pack(const vector<long long>& values, Column& c);
+		static void unpack(const Column& c, int rows, int* out, long long subtract);
+		int getNumBlocks() const;
+		bool loadBlock(int index, long long from, long long to, Block& b) const; //false if the block is outside [from, to)
+		static void timeRange(const Block& b, long long from, long long to, int& lo, int& hi);
+
+		//scan kernels
+		static void scanSum(const Block& b, int lo, int hi, int machine, int status, int column, long long& count, long long& sum);
+		static int selectRows(const Block& b, int lo, int hi, int machine, int status, int* sel);
+
+	public:
+		SalesHistory();
+		~SalesHistory();
+
+		bool open(const string& path);                  //load the history file and append new sales to it
+		void record(const SaleRecord& r);               //add one sale
+		long long size() const;                         //number of recorded sales
+
+		//queries over [from, to), machine < 0 means every machine
+		long long getRevenueCents(long long from, long long to, int machine) const;
+		long long getUnitsSold(long long from, long long to, int machine) const;
+		double getChangeFailureRate(long long from, long long to, int machine) const; //refused sales / attempts, 0 if none
+		void getRevenueByItemHour(long long from, long long to, int machine, int numSlots, vector<long long>& cents) const; //[slot - 1][hour of day]
+		void getTopSellers(long long from, long long to, int machine, int count, vector<SlotSales>& top) const;
+};
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+SalesHistory::SalesHistory() {
+	file = nullptr;
+	numRows = 0;
+	scratch.resize(SEGMENT_ROWS * NUM_COLUMNS);
+}
+
+SalesHistory::~SalesHistory() {
+	if (file) {
+		fclose(file);
+	}
+}
+
+//-----------------------------------------------------------------recording-----------------------------------------------------------------
+bool SalesHistory::open(const string& path) {
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+
+	//records already in the file
+	long whole = 0;
+	FILE* in = fopen(path.c_str(), "rb");
+	if (in) {
+		SaleRecord r;
+		while (fread(&r, sizeof(r), 1, in) == 1) {
+			append(r);
+			whole++;
+		}
+		fclose(in);
+	}
+
+	//cut off a record left half written by a crash, or every later one would be misaligned
+	file = fopen(path.c_str(), "r+b");
+	if (file == nullptr) {
+		file = fopen(path.c_str(), "w+b");
+	}
+	if (file == nullptr) {
+		return false;
+	}
+	fflush(file);
+	if (_chsize(_fileno(file), whole * (long)sizeof(SaleRecord)) != 0 || fseek(file, 0, SEEK_END) != 0) {
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void SalesHistory::record(const SaleRecord& r) {
+	append(r);
+
+	if (file) {
+		fwrite(&r, sizeof(r), 1, file);
+		fflush(file); //the menus leave through exit(), nothing may wait in the buffer
+	}
+}
+
+long long SalesHistory::size() const {
+	return numRows;
+}
+
+void SalesHistory::append(const SaleRecord& r) {
+	openRows[COL_TIME].push_back(r.time);
+	openRows[COL_MACHINE].push_back(r.machine);
+	openRows[COL_SLOT].push_back(r.slot);
+	openRows[COL_PRICE].push_back(r.priceCents);
+	openRows[COL_TENDERED].push_back(r.tenderedCents);
+	openRows[COL_CHANGE].push_back(r.changeCents);
+	openRows[COL_STATUS].push_back(r.status);
+	numRows++;
+
+	if ((int)openRows[COL_TIME].size() == SEGMENT_ROWS) {
+		seal();
+	}
+}
+
+//-----------------------------------------------------------------segments-----------------------------------------------------------------
+void SalesHistory::seal() {
+	Segment s;
+	const vector<long long>& times = openRows[COL_TIME];
+
+	s.rows = (int)times.size();
+	s.minTime = *min_element(times.begin(), times.end());
+	s.maxTime = *max_element(times.begin(), times.end());
+
+	for (int c = 0; c < NUM_COLUMNS; c++) {
+		pack(openRows[c], s.columns[c]);
+		openRows[c].clear();
+	}
+	segments.push_back(s);
+}
+
+void SalesHistory::pack(const vector<long long>& values, Column& c) {
+	long long low = *min_element(values.begin(), values.end());
+	long long high = *max_element(values.begin(), values.end());
+	unsigned long long range = (unsigned long long)(high - low);
+
+	c.base = low;
+	c.width = (range < 0x100ULL) ? 1 : (range < 0x10000ULL) ? 2 : 4;
+	c.data.resize(values.size() * c.width);
+
+	for (size_t i = 0; i < values.size(); i++) {
+		unsigned long offset = (unsigned long)(values[i] - low);
+		for (int k = 0; k < c.width; k++) {
+			c.data[i * c.width + k] = (unsigned char)(offset >> (8 * k));
+		}
+	}
+}
+
+void SalesHistory::unpack(const Column& c, int rows, int* out, long long subtract) {
+	int base = (int)(c.base - subtract);
+	const unsigned char* d = c.data.data();
+
+	//one loop per width so the compiler can vectorize each
+	if (c.width == 1) {
+		for (int i = 0; i < rows; i++) {
+			out[i] = base + d[i];
+		}
+	}
+	else if (c.width == 2) {
+		for (int i = 0; i < rows; i++) {
+			out[i] = base + (d[2 * i] | (d[2 * i + 1] << 8));
+		}
+	}
+	else {
+		for (int i = 0; i < rows; i++) {
+			out[i] = base + (int)((unsigned long)d[4 * i] | ((unsigned long)d[4 * i + 1] << 8) |
+				((unsigned long)d[4 * i + 2] << 16) | ((unsigned long)d[4 * i + 3] << 24));
+		}
+	}
+}
+
+int SalesHistory::getNumBlocks() const {
+	return (int)segments.size() + (openRows[COL_TIME].empty() ? 0 : 1);
+}
+
+bool SalesHistory::loadBlock(int index, long long from, long long to, Block& b) const {
+	for (int c = 0; c < NUM_COLUMNS; c++) {
+		b.col[c] = &scratch[c * SEGMENT_ROWS];
+	}
+
+	if (index < (int)segments.size()) {
+		const Segment& s = segments[index];
+		if (s.maxTime < from || s.minTime >= to) {
+			return false; //whole segment outside the period
+		}
+
+		b.rows = s.rows;
+		b.timeBase = s.minTime;
+		for (int c = 0; c < NUM_COLUMNS; c++) {
+			unpack(s.columns[c], s.rows, b.col[c], (c == COL_TIME) ? s.minTime : 0);
+		}
+		return true;
+	}
+
+	//open segment, not packed yet
+	const vector<long long>& times = openRows[COL_TIME];
+	b.rows = (int)times.size();
+	b.timeBase = *min_element(times.begin(), times.end());
+	for (int c = 0; c < NUM_COLUMNS; c++) {
+		long long subtract = (c == COL_TIME) ? b.timeBase : 0;
+		for (int i = 0; i < b.rows; i++) {
+			b.col[c][i] = (int)(openRows[c][i] - subtract);
+		}
+	}
+	return true;
+}
+
+void SalesHistory::timeRange(const Block& b, long long from, long long to, int& lo, int& hi) {
+	//period relative to the block, clamped to int
+	long long l = from - b.timeBase;
+	long long h = to - b.timeBase;
+	lo = (l < -2147483647LL) ? -2147483647 : (l > 2147483647LL) ? 2147483647 : (int)l;
+	hi = (h < -2147483647LL) ? -2147483647 : (h > 2147483647LL) ? 2147483647 : (int)h;
+}
+
+//-----------------------------------------------------------------scan kernels-----------------------------------------------------------------
+//count and sum one column over rows with lo <= time < hi, matching machine and status (-1 = any)
+void SalesHistory::scanSum(const Block& b, int lo, int hi, int machine, int status, int column, long long& count, long long& sum) {
+	const int* t = b.col[COL_TIME];
+	const int* m = b.col[COL_MACHINE];
+	const int* st = b.col[COL_STATUS];
+	const int* v = b.col[column];
+	int i = 0;
+
+#if defined(__SSE2__)
+	__m128i vLo = _mm_set1_epi32(lo);
+	__m128i vHi = _mm_set1_epi32(hi);
+	__m128i vMachine = _mm_set1_epi32(machine);
+	__m128i vStatus = _mm_set1_epi32(status);
+	__m128i vCount = _mm_setzero_si128();
+	__m128i vSum = _mm_setzero_si128();   //four lanes, each adds at most SEGMENT_ROWS / 4 ints
+
+	for (; i + 4 <= b.rows; i += 4) {
+		__m128i tv = _mm_loadu_si128((const __m128i*)(t + i));
+		__m128i match = _mm_andnot_si128(_mm_cmplt_epi32(tv, vLo), _mm_cmplt_epi32(tv, vHi));
+		if (machine >= 0) {
+			match = _mm_and_si128(match, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(m + i)), vMachine));
+		}
+		if (status >= 0) {
+			match = _mm_and_si128(match, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(st + i)), vStatus));
+		}
+		vCount = _mm_sub_epi32(vCount, match); //match lanes are -1
+		vSum = _mm_add_epi32(vSum, _mm_and_si128(match, _mm_loadu_si128((const __m128i*)(v + i))));
+	}
+
+	int lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, vCount);
+	count += (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm_storeu_si128((__m128i*)lanes, vSum);
+	sum += (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+	for (; i < b.rows; i++) {
+		if (t[i] >= lo && t[i] < hi && (machine < 0 || m[i] == machine) && (status < 0 || st[i] == status)) {
+			count++;
+			sum += v[i];
+		}
+	}
+}
+
+//indices of the matching rows, returns how many
+int SalesHistory::selectRows(const Block& b, int lo, int hi, int machine, int status, int* sel) {
+	const int* t = b.col[COL_TIME];
+	const int* m = b.col[COL_MACHINE];
+	const int* st = b.col[COL_STATUS];
+	int n = 0;
+	int i = 0;
+
+#if defined(__SSE2__)
+	__m128i vLo = _mm_set1_epi32(lo);
+	__m128i vHi = _mm_set1_epi32(hi);
+	__m128i vMachine = _mm_set1_epi32(machine);
+	__m128i vStatus = _mm_set1_epi32(status);
+
+	for (; i + 4 <= b.rows; i += 4) {
+		__m128i tv = _mm_loadu_si128((const __m128i*)(t + i));
+		__m128i match = _mm_andnot_si128(_mm_cmplt_epi32(tv, vLo), _mm_cmplt_epi32(tv, vHi));
+		if (machine >= 0) {
+			match = _mm_and_si128(match, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(m + i)), vMachine));
+		}
+		if (status >= 0) {
+			match = _mm_and_si128(match, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(st + i)), vStatus));
+		}
+
+		int bits = _mm_movemask_ps(_mm_castsi128_ps(match));
+		for (int k = 0; k < 4; k++) {
+			sel[n] = i + k;
+			n += (bits >> k) & 1; //no branch, unselected rows are overwritten
+		}
+	}
+#endif
+
+	for (; i < b.rows; i++) {
+		if (t[i] >= lo && t[i] < hi && (machine < 0 || m[i] == machine) && (status < 0 || st[i] == status)) {
+			sel[n++] = i;
+		}
+	}
+	return n;
+}
+
+//-----------------------------------------------------------------queries-----------------------------------------------------------------
+long long SalesHistory::getRevenueCents(long long from, long long to, int machine) const {
+	long long count = 0;
+	long long sum = 0;
+	Block b;
+
+	for (int k = 0; k < getNumBlocks(); k++) {
+		if (loadBlock(k, from, to, b)) {
+			int lo, hi;
+			timeRange(b, from, to, lo, hi);
+			scanSum(b, lo, hi, machine, SALE_RECORD_OK, COL_PRICE, count, sum);
+		}
+	}
+	return sum;
+}
+
+long long SalesHistory::getUnitsSold(long long from, long long to, int machine) const {
+	long long count = 0;
+	long long sum = 0;
+	Block b;
+
+	for (int k = 0; k < getNumBlocks(); k++) {
+		if (loadBlock(k, from, to, b)) {
+			int lo, hi;
+			timeRange(b, from, to, lo, hi);
+			scanSum(b, lo, hi, machine, SALE_RECORD_OK, COL_PRICE, count, sum);
+		}
+	}
+	return count;
+}
+
+double SalesHistory::getChangeFailureRate(long long from, long long to, int machine) const {
+	long long attempts = 0;
+	long long failures = 0;
+	long long unused = 0;
+	Block b;
+
+	for (int k = 0; k < getNumBlocks(); k++) {
+		if (loadBlock(k, from, to, b)) {
+			int lo, hi;
+			timeRange(b, from, to, lo, hi);
+			scanSum(b, lo, hi, machine, -1, COL_PRICE, attempts, unused);
+			scanSum(b, lo, hi, machine, SALE_RECORD_NO_CHANGE, COL_PRICE, failures, unused);
+		}
+	}
+	return (attempts > 0) ? (double)failures / attempts : 0.0;
+}
+
+void SalesHistory::getRevenueByItemHour(long long from, long long to, int machine, int numSlots, vector<long long>& cents) const {
+	vector<int> sel(SEGMENT_ROWS);
+	Block b;
+
+	cents.assign(numSlots * 24, 0);
+
+	//local time offset, so hours match the clock on the machine
+	time_t now = time(NULL);
+	tm utc = *gmtime(&now);
+	long long zone = (long long)now - (long long)mktime(&utc);
+
+	for (int k = 0; k < getNumBlocks(); k++) {
+		if (!loadBlock(k, from, to, b)) {
+			continue;
+		}
+		int lo, hi;
+		timeRange(b, from, to, lo, hi);
+		int n = selectRows(b, lo, hi, machine, SALE_RECORD_OK, sel.data());
+
+		for (int j = 0; j < n; j++) {
+			int row = sel[j];
+			int slot = b.col[COL_SLOT][row];
+			if (slot < 1 || slot > numSlots) {
+				continue;
+			}
+			long long local = b.timeBase + b.col[COL_TIME][row] + zone;
+			int hour = (int)((local % 86400 + 86400) % 86400 / 3600);
+			cents[(slot - 1) * 24 + hour] += b.col[COL_PRICE][row];
+		}
+	}
+}
+
+void SalesHistory::getTopSellers(long long from, long long to, int machine, int count, vector<SlotSales>& top) const {
+	map<long long, SlotSales> totals; //keyed by machine and slot
+	vector<int> sel(SEGMENT_ROWS);
+	Block b;
+
+	for (int k = 0; k < getNumBlocks(); k++) {
+		if (!loadBlock(k, from, to, b)) {
+			continue;
+		}
+		int lo, hi;
+		timeRange(b, from, to, lo, hi);
+		int n = selectRows(b, lo, hi, machine, SALE_RECORD_OK, sel.data());
+
+		for (int j = 0; j < n; j++) {
+			int row = sel[j];
+			long long key = ((long long)b.col[COL_MACHINE][row] << 32) | (unsigned int)b.col[COL_SLOT][row];
+			SlotSales& s = totals[key];
+			s.machine = b.col[COL_MACHINE][row];
+			s.slot = b.col[COL_SLOT][row];
+			s.units++;
+			s.revenueCents += b.col[COL_PRICE][row];
+		}
+	}
+
+	top.clear();
+	for (map<long long, SlotSales>::const_iterator it = totals.begin(); it != totals.end(); ++it) {
+		top.push_back(it->second);
+	}
+	sort(top.begin(), top.end(), [](const SlotSales& a, const SlotSales& b) {
+		return a.units != b.units ? a.units > b.units : a.revenueCents > b.revenueCents;
+	});
+	if ((int)top.size() > count) {
+		top.resize(count);
+	}
+}
+
+#endif
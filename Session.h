@@ -0,0 +1,517 @@
+#ifndef _SESSION_
+#define _SESSION_
+
+#include <vector>
+#include <queue>
+#include <utility>
+#include <functional>
+#include <stdexcept>
+#include "Vending_Machine.h"
+
+using namespace std;
+
+//input a session can be waiting for
+enum SessionEventType {
+	EVENT_KEY,      //keypad press, value is the item index or admin option
+	EVENT_COIN,     //cash inserted, amount is the value in RM
+	EVENT_CANCEL,   //cancel / refund button
+	EVENT_TIMEOUT   //no input before the session deadline
+};
+
+//what a session did after being resumed
+enum SessionReply {
+	REPLY_NONE = 0,       //nothing to report
+	REPLY_CREDIT,         //coin accepted, amount is the current credit
+	REPLY_DUE,            //item held, amount still to be paid
+	REPLY_VENDED,         //item dispensed, amount is the change
+	REPLY_REFUNDED,       //credit returned, amount is the refund
+	REPLY_INVALID_ITEM,   //no such item
+	REPLY_OUT_OF_STOCK,   //item sold out
+	REPLY_NO_CHANGE,      //not enough change, credit refunded
+	REPLY_INVALID_AMOUNT, //coin or value not accepted
+	REPLY_DONE            //admin operation applied, amount is the result
+};
+
+struct SessionEvent {
+	int type;       //SessionEventType
+	int key;        //for EVENT_KEY
+	double amount;  //for EVENT_COIN and admin values
+};
+
+/*
+ * A customer session is a resumable state machine: every call to resume()
+ * runs until the next input is needed and then returns, so the whole
+ * session lives in this small object instead of on a blocked call stack.
+ * One thread can drive as many sessions as it holds objects for.
+ */
+class CustomerSession {
+	private:
+		enum State { IDLE, PAYING };
+
+		VendingMachine* vm;
+		int state;
+		int selected;             //item index being paid for (1-based), 0 if none
+		long long hold;           //unit reserved on the machine for the selected item, -1 if none
+		double credit;            //cash inserted and not yet spent
+		double amount;            //value that goes with the last reply
+		unsigned long deadline;   //tick count when the session times out, 0 if none
+		unsigned long timeoutMs;  //how long to wait for the next input
+
+		int vend(unsigned long now);   //try to sell the selected item with the current credit
+		int refund();                  //return all credit and go back to idle
+		void drop();                   //forget the selected item and give its unit back
+
+	public:
+		CustomerSession();
+		CustomerSession(VendingMachine* machine, unsigned long timeout);
+
+		int resume(const SessionEvent& ev, unsigned long now); //feed one input, returns a SessionReply
+		void setMachine(VendingMachine* machine);           //switch machine, only when nothing is pending
+
+		double getCredit() const;
+		double getAmount() const;
+		int getSelected() const;
+		unsigned long getDeadline() const;
+		bool isIdle() const;                                //no credit and no item held
+};
+
+/*
+ * Admin session for the common one-slot operations, fed the same way:
+ * KEY option (1 replenish, 2 change price, 3 add funds), then KEY item index
+ * for options 1 and 2, then the value as a COIN event (quantity, price or amount).
+ */
+class AdminSession {
+	private:
+		enum State { CHOOSE_OPTION, CHOOSE_ITEM, ENTER_VALUE };
+
+		VendingMachine* vm;
+		int state;
+		int option;
+		int itemIndex;
+		double amount;
+		unsigned long deadline;
+		unsigned long timeoutMs;
+
+	public:
+		AdminSession();
+		AdminSession(VendingMachine* machine, unsigned long timeout);
+
+		int resume(const SessionEvent& ev, unsigned long now); //feed one input, returns a SessionReply
+		void setMachine(VendingMachine* machine);           //switch machine, starts over
+		double getAmount() const;
+		unsigned long getDeadline() const;
+};
+
+/*
+ * Owns many sessions and delivers timeouts to them. Every id has a customer
+ * session and an admin session on the same machine, so one client can buy
+ * and service. Session ids are reused after close(), deadlines sit in a
+ * min-heap with at most one live entry per id: a deadline that moves later
+ * is pushed again only when its old entry comes due, so input does not grow
+ * the heap. Stale entries are skipped when they reach the top.
+ */
+class SessionScheduler {
+	private:
+		typedef pair<unsigned long, int> Deadline;  //(tick count, session id)
+
+		vector<CustomerSession> sessions;
+		vector<AdminSession> admins;    //admin session of each id
+		vector<bool> active;
+		vector<int> freeIds;
+		priority_queue<Deadline, vector<Deadline>, greater<Deadline> > deadlines;
+		vector<unsigned long> queued;   //deadline of the live heap entry of each id, 0 if none
+		unsigned long timeoutMs;
+		int numActive;
+
+		void track(int id);    //remember the session deadline after it was resumed
+
+	public:
+		SessionScheduler(unsigned long timeout);
+
+		int open(VendingMachine* machine);                              //start a session, returns its id
+		void close(int id);                                             //end a session, the id can be reused
+		int post(int id, const SessionEvent& ev, unsigned long now);    //resume a session with an input
+		int postAdmin(int id, const SessionEvent& ev, unsigned long now); //resume the admin session of id with an input
+		int expire(unsigned long now, vector<int>& expired, vector<int>& replies); //deliver due customer timeouts, admin ones start over silently
+		CustomerSession& get(int id);
+		AdminSession& getAdmin(int id);
+		int getNumActive() const;
+};
+
+//-----------------------------------------------------------------customer session-----------------------------------------------------------------
+CustomerSession::CustomerSession() {
+	vm = nullptr;
+	state = IDLE;
+	selected = 0;
+	hold = -1;
+	credit = 0.0;
+	amount = 0.0;
+	deadline = 0;
+	timeoutMs = 0;
+}
+
+CustomerSession::CustomerSession(VendingMachine* machine, unsigned long timeout) {
+	vm = machine;
+	state = IDLE;
+	selected = 0;
+	hold = -1;
+	credit = 0.0;
+	amount = 0.0;
+	deadline = 0;
+	timeoutMs = timeout;
+}
+
+int CustomerSession::resume(const SessionEvent& ev, unsigned long now) {
+	amount = 0.0;
+
+	switch (ev.type) {
+		case EVENT_COIN:
+			if (ev.amount <= 0) {
+				return REPLY_INVALID_AMOUNT;
+			}
+			credit += ev.amount;
+			deadline = now + timeoutMs;
+
+			if (state == PAYING) {
+				return vend(now);
+			}
+			amount = credit;
+			return REPLY_CREDIT;
+
+		case EVENT_KEY:
+			if (ev.key < 1 || ev.key > vm->getNumQueue()) {
+				return REPLY_INVALID_ITEM;
+			}
+			if (ev.key != selected) {
+				drop();
+				hold = vm->reserveItem(ev.key, now, timeoutMs); //unit stays ours until paid or timed out
+				if (hold < 0) {
+					state = IDLE;
+					return REPLY_OUT_OF_STOCK;
+				}
+			}
+			selected = ev.key;
+			state = PAYING;
+			deadline = now + timeoutMs;
+			return vend(now);
+
+		case EVENT_CANCEL:
+			return refund();
+
+		case EVENT_TIMEOUT:
+			//only act on the deadline that is currently set
+			if (deadline == 0 || now < deadline) {
+				return REPLY_NONE;
+			}
+			if (credit > 0) {
+				return refund();
+			}
+			drop();
+			state = IDLE;
+			deadline = 0;
+			return REPLY_NONE;
+	}
+	return REPLY_NONE;
+}
+
+int CustomerSession::vend(unsigned long now) {
+	//price locked when the unit was held, the current one if the hold expired
+	double price = vm->getHoldPrice(hold);
+	if (price == 0.0) {
+		price = vm->getCurrentPrice(selected);
+	}
+
+	if (credit < price) {
+		amount = price - credit;
+		return REPLY_DUE; //suspend until more coins arrive
+	}
+
+	double change;
+	int result = vm->sellReserved(hold, credit, change);
+	hold = -1; //released by the sale, or already expired
+
+	if (result == SALE_HOLD_EXPIRED) {
+		result = vm->sellItem(selected, credit, change);
+	}
+
+	switch (result) {
+		case SALE_OK:
+			credit = 0.0;
+			amount = change;
+			state = IDLE;
+			selected = 0;
+			deadline = 0;
+			return REPLY_VENDED;
+		case SALE_NO_CHANGE:
+			refund();
+			return REPLY_NO_CHANGE;
+		case SALE_OUT_OF_STOCK:
+			//hold expired and the unit was sold to another session, keep the credit
+			state = IDLE;
+			selected = 0;
+			deadline = now + timeoutMs;
+			return REPLY_OUT_OF_STOCK;
+		default:
+			state = IDLE;
+			selected = 0;
+			return REPLY_INVALID_ITEM;
+	}
+}
+
+int CustomerSession::refund() {
+	drop();
+	amount = credit;
+	credit = 0.0;
+	state = IDLE;
+	deadline = 0;
+	return REPLY_REFUNDED;
+}
+
+void CustomerSession::drop() {
+	if (hold >= 0) {
+		vm->releaseItem(hold);
+		hold = -1;
+	}
+	selected = 0;
+}
+
+void CustomerSession::setMachine(VendingMachine* machine) {
+	if (!isIdle()) {
+		throw logic_error ("Cannot switch machine during a purchase!");
+	}
+	vm = machine;
+}
+
+double CustomerSession::getCredit() const {
+	return credit;
+}
+
+double CustomerSession::getAmount() const {
+	return amount;
+}
+
+int CustomerSession::getSelected() const {
+	return selected;
+}
+
+unsigned long CustomerSession::getDeadline() const {
+	return deadline;
+}
+
+bool CustomerSession::isIdle() const {
+	return (state == IDLE && credit == 0);
+}
+
+//-----------------------------------------------------------------admin session-----------------------------------------------------------------
+AdminSession::AdminSession() {
+	vm = nullptr;
+	state = CHOOSE_OPTION;
+	option = 0;
+	itemIndex = 0;
+	amount = 0.0;
+	deadline = 0;
+	timeoutMs = 0;
+}
+
+AdminSession::AdminSession(VendingMachine* machine, unsigned long timeout) {
+	vm = machine;
+	state = CHOOSE_OPTION;
+	option = 0;
+	itemIndex = 0;
+	amount = 0.0;
+	deadline = 0;
+	timeoutMs = timeout;
+}
+
+int AdminSession::resume(const SessionEvent& ev, unsigned long now) {
+	amount = 0.0;
+
+	//cancel or timeout at any step starts over
+	if (ev.type == EVENT_CANCEL || (ev.type == EVENT_TIMEOUT && deadline != 0 && now >= deadline)) {
+		state = CHOOSE_OPTION;
+		deadline = 0;
+		return REPLY_NONE;
+	}
+	deadline = now + timeoutMs;
+
+	switch (state) {
+		case CHOOSE_OPTION:
+			if (ev.type != EVENT_KEY || ev.key < 1 || ev.key > 3) {
+				return REPLY_INVALID_ITEM;
+			}
+			option = ev.key;
+			state = (option == 3) ? ENTER_VALUE : CHOOSE_ITEM;
+			return REPLY_NONE;
+
+		case CHOOSE_ITEM:
+			if (ev.type != EVENT_KEY || ev.key < 1 || ev.key > vm->getNumQueue()) {
+				return REPLY_INVALID_ITEM;
+			}
+			itemIndex = ev.key;
+			state = ENTER_VALUE;
+			return REPLY_NONE;
+
+		case ENTER_VALUE: {
+			if (ev.type != EVENT_COIN) {
+				return REPLY_INVALID_AMOUNT;
+			}
+
+			bool applied;
+			if (option == 1) {
+				amount = vm->restockItem(itemIndex, static_cast<int>(ev.amount));
+				applied = (ev.amount >= 1);
+			}
+			else if (option == 2) {
+				applied = vm->setItemPrice(itemIndex, ev.amount);
+				amount = ev.amount;
+			}
+			else {
+				applied = vm->addMoney(ev.amount);
+				amount = vm->getTotalMoney();
+			}
+
+			if (!applied) {
+				return REPLY_INVALID_AMOUNT; //stay here and wait for a valid value
+			}
+			state = CHOOSE_OPTION;
+			deadline = 0;
+			return REPLY_DONE;
+		}
+	}
+	return REPLY_NONE;
+}
+
+void AdminSession::setMachine(VendingMachine* machine) {
+	vm = machine;
+	state = CHOOSE_OPTION;
+	deadline = 0;
+}
+
+double AdminSession::getAmount() const {
+	return amount;
+}
+
+unsigned long AdminSession::getDeadline() const {
+	return deadline;
+}
+
+//-----------------------------------------------------------------scheduler-----------------------------------------------------------------
+SessionScheduler::SessionScheduler(unsigned long timeout) {
+	timeoutMs = timeout;
+	numActive = 0;
+}
+
+int SessionScheduler::open(VendingMachine* machine) {
+	int id;
+
+	if (!freeIds.empty()) {
+		id = freeIds.back();
+		freeIds.pop_back();
+		sessions[id] = CustomerSession(machine, timeoutMs);
+		admins[id] = AdminSession(machine, timeoutMs);
+		active[id] = true;
+		queued[id] = 0;
+	}
+	else {
+		id = (int)sessions.size();
+		sessions.push_back(CustomerSession(machine, timeoutMs));
+		admins.push_back(AdminSession(machine, timeoutMs));
+		active.push_back(true);
+		queued.push_back(0);
+	}
+
+	numActive++;
+	return id;
+}
+
+void SessionScheduler::close(int id) {
+	if (id < 0 || id >= (int)sessions.size() || !active[id]) {
+		return;
+	}
+
+	//give back any held unit, the client is gone
+	SessionEvent ev = { EVENT_CANCEL, 0, 0.0 };
+	sessions[id].resume(ev, 0);
+	admins[id].resume(ev, 0);
+
+	active[id] = false;
+	queued[id] = 0;
+	freeIds.push_back(id);
+	numActive--;
+}
+
+int SessionScheduler::post(int id, const SessionEvent& ev, unsigned long now) {
+	int reply = get(id).resume(ev, now);
+	track(id);
+	return reply;
+}
+
+int SessionScheduler::postAdmin(int id, const SessionEvent& ev, unsigned long now) {
+	int reply = getAdmin(id).resume(ev, now);
+	track(id);
+	return reply;
+}
+
+int SessionScheduler::expire(unsigned long now, vector<int>& expired, vector<int>& replies) {
+	int count = 0;
+
+	while (!deadlines.empty() && deadlines.top().first <= now) {
+		Deadline due = deadlines.top();
+		deadlines.pop();
+
+		//skip closed sessions and entries replaced by an earlier deadline
+		int id = due.second;
+		if (!active[id] || queued[id] != due.first) {
+			continue;
+		}
+		queued[id] = 0;
+
+		SessionEvent ev = { EVENT_TIMEOUT, 0, 0.0 };
+		unsigned long adminDeadline = admins[id].getDeadline();
+		if (adminDeadline != 0 && adminDeadline <= now) {
+			admins[id].resume(ev, now); //a half entered admin operation starts over
+		}
+		unsigned long deadline = sessions[id].getDeadline();
+		if (deadline != 0 && deadline <= now) {
+			expired.push_back(id);
+			replies.push_back(sessions[id].resume(ev, now));
+			count++;
+		}
+		track(id); //a deadline moved later by input gets its entry now
+	}
+	return count;
+}
+
+void SessionScheduler::track(int id) {
+	unsigned long deadline = sessions[id].getDeadline();
+	unsigned long adminDeadline = admins[id].getDeadline();
+	if (deadline == 0 || (adminDeadline != 0 && adminDeadline < deadline)) {
+		deadline = adminDeadline; //the earlier of the two
+	}
+
+	//a live entry at or before the deadline is enough, expire() pushes the rest when it comes due
+	if (deadline != 0 && (queued[id] == 0 || deadline < queued[id])) {
+		deadlines.push(Deadline(deadline, id));
+		queued[id] = deadline;
+	}
+}
+
+CustomerSession& SessionScheduler::get(int id) {
+	if (id < 0 || id >= (int)sessions.size() || !active[id]) {
+		throw out_of_range ("Invalid session id!");
+	}
+	return sessions[id];
+}
+
+AdminSession& SessionScheduler::getAdmin(int id) {
+	if (id < 0 || id >= (int)admins.size() || !active[id]) {
+		throw out_of_range ("Invalid session id!");
+	}
+	return admins[id];
+}
+
+int SessionScheduler::getNumActive() const {
+	return numActive;
+}
+
+#endif
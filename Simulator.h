@@ -0,0 +1,485 @@
+#ifndef _SIMULATOR_
+#define _SIMULATOR_
+
+#include <windows.h>
+#include <atomic>
+#include <vector>
+#include <queue>
+#include <random>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "Vending_Machine.h"
+
+using namespace std;
+
+//what the simulated customers do and which machines to try
+struct SimSettings {
+	double arrivalsPerHour;    //mean customers per hour (Poisson arrivals)
+	double hours;              //length of one run
+	double restockHours;       //time between restock visits, 0 for none
+	double exactShare;         //share of customers paying the exact price
+	int runs;                  //runs per configuration
+	unsigned long seed;
+	vector<double> weights;    //relative preference of each slot, equal if empty
+	vector<int> depths;        //slot depths to try
+	vector<double> floats;     //starting cash to try
+
+	SimSettings();
+	bool loadFile(const string& path, string& error);
+};
+
+//outcome of one run
+struct SimRun {
+	int customers;
+	int sales;
+	int lostSales;             //chosen slot was empty
+	int changeFailures;        //change > totalMoney, sale refused
+	double firstSellOut;       //hours until the first slot ran empty, -1 if none did
+	vector<double> slotSellOut; //hours until each slot ran empty, -1 if it did not
+};
+
+//one configuration summed over its runs
+struct SimResult {
+	int depth;
+	double cashFloat;
+	double sales;              //means per run
+	double lostSales;
+	double changeFailures;
+	double sellOutShare;       //runs in which a slot ran empty
+	double medianSellOut;      //hours, over the runs that sold out, -1 if none did
+	double earlySellOut;       //10th percentile of the same
+	vector<double> slotSellOutShare;  //per slot, runs in which it ran empty
+	vector<double> slotMedianSellOut; //per slot, hours over those runs, -1 if it never ran empty
+};
+
+/*
+ * Discrete-event simulation of one machine layout, run many times per
+ * configuration (slot depth and starting cash) to size slots and floats.
+ * Every run builds a real VendingMachine and sells through sellItem(), so
+ * the stock and change rules are the ones customers meet. Events (customer
+ * arrivals, restock visits, end of run) are taken in time order from a
+ * heap; arrivals are exponentially spaced, the slot is picked by weight and
+ * the customer pays the exact price or with one of the two smallest notes
+ * that cover it.
+ *
+ * Runs are independent and spread over threads that take the next run from
+ * a shared counter. Each thread owns its generator and reseeds it from
+ * (seed, run) so the results do not depend on the number of threads.
+ */
+class Simulator {
+	private:
+		enum SimEventType { SIM_ARRIVAL = 0, SIM_RESTOCK, SIM_END };
+
+		struct SimEvent {
+			double time;           //hours since the start of the run
+			int type;              //SimEventType
+			bool operator>(const SimEvent& other) const { return time > other.time; }
+		};
+
+		vector<string> names;      //layout of the machine being sized
+		vector<double> prices;
+		SimSettings settings;
+		vector<SimRun> results;    //run r of configuration c is at c * settings.runs + r
+		atomic<int> nextRun;
+
+		static DWORD WINAPI threadMain(LPVOID arg);
+		void work(mt19937& rng);                             //run until the counter passes the last run
+		void runOnce(int depth, double cashFloat, mt19937& rng, SimRun& out) const;
+		static double payWith(double price, double exactShare, mt19937& rng);
+
+		Simulator(const Simulator&);
+		Simulator& operator=(const Simulator&);
+
+	public:
+		Simulator(const VendingMachine& vm, const SimSettings& s);
+
+		int getNumConfigs() const;
+		int run(int numThreads);                             //every run of every configuration, returns how many
+		void summarize(vector<SimResult>& out) const;
+		void printReport() const;
+
+		static int getNumProcessors();
+};
+
+//------------------------------------------------------------------settings-----------------------------------------------------------------
+SimSettings::SimSettings() {
+	arrivalsPerHour = 4;
+	hours = 72;
+	restockHours = 48;
+	exactShare = 0.3;
+	runs = 1000;
+	seed = 1;
+	depths.push_back(5);
+	depths.push_back(10);
+	depths.push_back(15);
+	depths.push_back(20);
+	floats.push_back(0);
+	floats.push_back(10);
+	floats.push_back(20);
+	floats.push_back(50);
+}
+
+bool SimSettings::loadFile(const string& path, string& error) {
+	ifstream file(path.c_str());
+	if (!file) {
+		error = "cannot open " + path;
+		return false;
+	}
+
+	string line;
+	int lineNo = 0;
+
+	while (getline(file, line)) {
+		lineNo++;
+		if (!line.empty() && line[line.length() - 1] == '\r') {
+			line.erase(line.length() - 1);
+		}
+		size_t comment = line.find('#');
+		if (comment != string::npos) {
+			line.erase(comment);
+		}
+
+		stringstream ss(line);
+		string key;
+		if (!(ss >> key)) {
+			continue;
+		}
+
+		bool ok = true;
+		if (key == "arrivals") {
+			ok = (ss >> arrivalsPerHour) && arrivalsPerHour > 0;
+		}
+		else if (key == "hours") {
+			ok = (ss >> hours) && hours > 0;
+		}
+		else if (key == "restock") {
+			ok = (ss >> restockHours) && restockHours >= 0;
+		}
+		else if (key == "exact") {
+			ok = (ss >> exactShare) && exactShare >= 0 && exactShare <= 1;
+		}
+		else if (key == "runs") {
+			ok = (ss >> runs) && runs > 0;
+		}
+		else if (key == "seed") {
+			ok = (bool)(ss >> seed);
+		}
+		else if (key == "weights" || key == "depths" || key == "floats") {
+			vector<double> values;
+			double v;
+			while (ss >> v) {
+				ok = ok && v >= 0 && (key != "depths" || (v >= 1 && v <= 1000));
+				values.push_back(v);
+			}
+			ok = ok && !values.empty() && ss.eof();
+
+			if (key == "weights") {
+				weights = values;
+			}
+			else if (key == "depths") {
+				depths.assign(values.begin(), values.end());
+			}
+			else {
+				floats = values;
+			}
+		}
+		else {
+			ok = false;
+		}
+
+		if (!ok) {
+			stringstream msg;
+			msg << path << ":" << lineNo << ": invalid simulation setting";
+			error = msg.str();
+			return false;
+		}
+	}
+	return true;
+}
+
+//------------------------------------------------------------------constructor-----------------------------------------------------------------
+Simulator::Simulator(const VendingMachine& vm, const SimSettings& s) {
+	if (vm.getNumQueue() == 0) {
+		throw invalid_argument ("Nothing to simulate, the machine has no items!");
+	}
+
+	for (int i = 0; i < vm.getNumQueue(); i++) {
+		names.push_back(vm.getItem(i).getName());
+		prices.push_back(vm.getItem(i).getPrice());
+	}
+	settings = s;
+	settings.weights.resize(names.size(), settings.weights.empty() ? 1.0 : 0.0);
+	if (*max_element(settings.weights.begin(), settings.weights.end()) <= 0) {
+		settings.weights.assign(names.size(), 1.0); //nobody would buy anything
+	}
+	nextRun = 0;
+}
+
+int Simulator::getNumConfigs() const {
+	return (int)(settings.depths.size() * settings.floats.size());
+}
+
+int Simulator::getNumProcessors() {
+	SYSTEM_INFO info;
+	info.dwNumberOfProcessors = 1;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+}
+
+//-----------------------------------------------------------------runs-----------------------------------------------------------------
+int Simulator::run(int numThreads) {
+	int total = getNumConfigs() * settings.runs;
+	results.assign(total, SimRun());
+	nextRun = 0;
+
+	if (numThreads < 1) {
+		numThreads = 1;
+	}
+
+	//the calling thread works too, and picks up everything if no thread starts
+	vector<HANDLE> threads;
+	for (int i = 1; i < numThreads; i++) {
+		HANDLE t = CreateThread(NULL, 0, threadMain, this, 0, NULL);
+		if (t != NULL) {
+			threads.push_back(t);
+		}
+	}
+
+	mt19937 rng;
+	work(rng);
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+	return total;
+}
+
+DWORD WINAPI Simulator::threadMain(LPVOID arg) {
+	mt19937 rng; //one generator per thread, never shared
+	static_cast<Simulator*>(arg)->work(rng);
+	return 0;
+}
+
+void Simulator::work(mt19937& rng) {
+	int total = (int)results.size();
+	int numFloats = (int)settings.floats.size();
+
+	for (int index = nextRun++; index < total; index = nextRun++) {
+		int config = index / settings.runs;
+
+		seed_seq seq = { (unsigned int)settings.seed, (unsigned int)index };
+		rng.seed(seq);
+		runOnce((int)settings.depths[config / numFloats], settings.floats[config % numFloats], rng, results[index]);
+	}
+}
+
+void Simulator::runOnce(int depth, double cashFloat, mt19937& rng, SimRun& out) const {
+	int numSlots = (int)names.size();
+	VendingMachine vm(numSlots);
+	for (int i = 0; i < numSlots; i++) {
+		vm.addItem(Item(names[i], prices[i], depth, depth));
+	}
+	if (cashFloat > 0) {
+		vm.addMoney(cashFloat);
+	}
+
+	out.customers = 0;
+	out.sales = 0;
+	out.lostSales = 0;
+	out.changeFailures = 0;
+	out.firstSellOut = -1;
+	out.slotSellOut.assign(numSlots, -1);
+
+	exponential_distribution<double> gap(settings.arrivalsPerHour);
+	discrete_distribution<int> choice(settings.weights.begin(), settings.weights.end());
+	priority_queue<SimEvent, vector<SimEvent>, greater<SimEvent> > events;
+
+	SimEvent first = { gap(rng), SIM_ARRIVAL };
+	SimEvent end = { settings.hours, SIM_END };
+	events.push(first);
+	events.push(end);
+	if (settings.restockHours > 0) {
+		SimEvent visit = { settings.restockHours, SIM_RESTOCK };
+		events.push(visit);
+	}
+
+	while (!events.empty()) {
+		SimEvent e = events.top();
+		events.pop();
+
+		if (e.type == SIM_END) {
+			break;
+		}
+		if (e.type == SIM_RESTOCK) {
+			for (int slot = 1; slot <= numSlots; slot++) {
+				int missing = depth - vm.getItem(slot - 1).getNumStockQ();
+				if (missing > 0) {
+					vm.restockItem(slot, missing);
+				}
+			}
+			e.time += settings.restockHours;
+			events.push(e);
+			continue;
+		}
+
+		//a customer picks an item and pays for it
+		out.customers++;
+		int slot = choice(rng) + 1;
+		double change;
+		int result = vm.sellItem(slot, payWith(prices[slot - 1], settings.exactShare, rng), change);
+
+		if (result == SALE_OK) {
+			out.sales++;
+			if (vm.getItem(slot - 1).getNumStockQ() == 0) {
+				if (out.slotSellOut[slot - 1] < 0) {
+					out.slotSellOut[slot - 1] = e.time;
+				}
+				if (out.firstSellOut < 0) {
+					out.firstSellOut = e.time;
+				}
+			}
+		}
+		else if (result == SALE_NO_CHANGE) {
+			out.changeFailures++;
+		}
+		else {
+			out.lostSales++;
+		}
+
+		e.time += gap(rng);
+		events.push(e);
+	}
+}
+
+double Simulator::payWith(double price, double exactShare, mt19937& rng) {
+	static const double notes[] = { 1, 5, 10, 20, 50, 100 };
+	static const int numNotes = sizeof(notes) / sizeof(notes[0]);
+	uniform_real_distribution<double> share(0.0, 1.0);
+
+	if (share(rng) < exactShare) {
+		return price;
+	}
+
+	int n = 0;
+	while (n < numNotes - 1 && notes[n] < price) {
+		n++;
+	}
+	if (n < numNotes - 1 && share(rng) < 0.5) {
+		n++; //no small note at hand
+	}
+	return (notes[n] >= price) ? notes[n] : price;
+}
+
+//-----------------------------------------------------------------report-----------------------------------------------------------------
+void Simulator::summarize(vector<SimResult>& out) const {
+	int numFloats = (int)settings.floats.size();
+	int numSlots = (int)names.size();
+
+	for (int config = 0; config < getNumConfigs(); config++) {
+		SimResult r;
+		vector<double> sellOuts;
+		vector<vector<double> > slotSellOuts(numSlots);
+		long long sales = 0, lost = 0, noChange = 0;
+
+		for (int k = 0; k < settings.runs; k++) {
+			const SimRun& run = results[config * settings.runs + k];
+			sales += run.sales;
+			lost += run.lostSales;
+			noChange += run.changeFailures;
+			if (run.firstSellOut >= 0) {
+				sellOuts.push_back(run.firstSellOut);
+			}
+			for (int s = 0; s < numSlots; s++) {
+				if (run.slotSellOut[s] >= 0) {
+					slotSellOuts[s].push_back(run.slotSellOut[s]);
+				}
+			}
+		}
+
+		r.depth = (int)settings.depths[config / numFloats];
+		r.cashFloat = settings.floats[config % numFloats];
+		r.sales = (double)sales / settings.runs;
+		r.lostSales = (double)lost / settings.runs;
+		r.changeFailures = (double)noChange / settings.runs;
+		r.sellOutShare = (double)sellOuts.size() / settings.runs;
+		r.medianSellOut = -1;
+		r.earlySellOut = -1;
+
+		if (!sellOuts.empty()) {
+			sort(sellOuts.begin(), sellOuts.end());
+			r.medianSellOut = sellOuts[sellOuts.size() / 2];
+			r.earlySellOut = sellOuts[sellOuts.size() / 10];
+		}
+		for (int s = 0; s < numSlots; s++) {
+			vector<double>& times = slotSellOuts[s];
+			r.slotSellOutShare.push_back((double)times.size() / settings.runs);
+			if (times.empty()) {
+				r.slotMedianSellOut.push_back(-1);
+			}
+			else {
+				nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+				r.slotMedianSellOut.push_back(times[times.size() / 2]);
+			}
+		}
+		out.push_back(r);
+	}
+}
+
+void Simulator::printReport() const {
+	vector<SimResult> rows;
+	summarize(rows);
+
+	cout << "SIMULATION (" << settings.runs << " RUNS OF " << settings.hours << " HOURS, "
+		 << settings.arrivalsPerHour << " CUSTOMERS PER HOUR)\n";
+	cout << setw(78) << setfill('-') << "-" << setfill(' ') << endl;
+	cout << right << setw(6) << "Depth" << setw(9) << "Float" << setw(10) << "Sales" << setw(10) << "Lost"
+		 << setw(11) << "No Change" << setw(10) << "Sold Out" << setw(11) << "Median(h)" << setw(11) << "Early(h)" << endl;
+
+	for (size_t i = 0; i < rows.size(); i++) {
+		const SimResult& r = rows[i];
+		cout << right << setw(6) << r.depth << setw(9) << fixed << setprecision(2) << r.cashFloat
+			 << setw(10) << setprecision(1) << r.sales << setw(10) << r.lostSales << setw(11) << r.changeFailures
+			 << setw(9) << setprecision(0) << r.sellOutShare * 100 << "%";
+		if (r.medianSellOut >= 0) {
+			cout << setw(11) << setprecision(1) << r.medianSellOut << setw(11) << r.earlySellOut << endl;
+		}
+		else {
+			cout << setw(11) << "-" << setw(11) << "-" << endl;
+		}
+	}
+	cout << setw(78) << setfill('-') << "-" << setfill(' ') << endl;
+	cout << "Sales, lost sales and change failures are means per run. Median and early\n"
+		 << "(10th percentile) times to the first empty slot are over the runs that sold out.\n\n";
+
+	//which slots run empty, and when
+	cout << "SELL-OUT BY SLOT (RUNS IN WHICH THE SLOT RAN EMPTY, MEDIAN HOURS)\n";
+	cout << right << setw(6) << "Depth" << setw(9) << "Float";
+	for (size_t s = 0; s < names.size(); s++) {
+		cout << setw(13) << names[s].substr(0, 12);
+	}
+	cout << endl;
+	for (size_t i = 0; i < rows.size(); i++) {
+		const SimResult& r = rows[i];
+		cout << right << setw(6) << r.depth << setw(9) << fixed << setprecision(2) << r.cashFloat;
+		for (size_t s = 0; s < r.slotSellOutShare.size(); s++) {
+			ostringstream cell;
+			cell << fixed << setprecision(0) << r.slotSellOutShare[s] * 100 << "% ";
+			if (r.slotMedianSellOut[s] >= 0) {
+				cell << setprecision(1) << r.slotMedianSellOut[s];
+			}
+			else {
+				cell << "-";
+			}
+			cout << setw(13) << cell.str();
+		}
+		cout << endl;
+	}
+	cout << endl;
+}
+
+#endif
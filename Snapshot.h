@@ -0,0 +1,193 @@
+#ifndef _SNAPSHOT_
+#define _SNAPSHOT_
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstring>
+#include "Epoch.h"
+#include "Aggregate.h"
+
+using namespace std;
+
+//one slot as seen by readers
+struct SlotView {
+	char name[16];      //item name, cut to 15 characters
+	double price;       //catalog price
+	int stock;
+	int sold;
+	double revenue;
+};
+
+//fixed group of slots, copied as a whole when one of them changes
+struct SlotPage {
+	static const int SLOTS = 4;
+	SlotView slots[SLOTS];
+};
+
+//immutable state of a machine at one point in time
+struct MachineVersion {
+	unsigned long version;          //increases with every publish
+	string title;
+	MachineTotals totals;
+	int numSlots;
+	vector<const SlotPage*> pages;  //shared with other versions until a slot on the page changes
+
+	const SlotView& getSlot(int index) const { return pages[index / SlotPage::SLOTS]->slots[index % SlotPage::SLOTS]; }
+};
+
+/*
+ * Multi-version state of a machine. The writer (the thread that owns the
+ * machine) edits a private working copy and publishes it as a new version:
+ * only the pages with a changed slot are copied, the rest are shared with
+ * the previous version, and the new root is swapped in with one atomic
+ * store. Readers take the current version inside an epoch section and see
+ * one consistent point in time for as long as they like; the old version
+ * and its replaced pages are freed once no reader is left in it. Neither
+ * side ever waits for the other.
+ */
+class VersionedState {
+	private:
+		EpochDomain epochs;
+		atomic<MachineVersion*> current;
+		atomic<unsigned long> publishedVersion; //version of current, readable without entering
+		vector<SlotView> working;        //writer's copy of every slot
+		vector<bool> dirtyPages;         //pages changed since the last publish
+		string title;
+		MachineTotals totals;
+		unsigned long nextVersion;
+
+		VersionedState(const VersionedState&);
+		VersionedState& operator=(const VersionedState&);
+
+	public:
+		VersionedState();
+		~VersionedState();
+
+		//writer
+		void setSlot(int index, const string& name, double price, int stock, int sold, double revenue); //0-based slot
+		void setTitle(const string& t);
+		void setTotals(const MachineTotals& t);
+		void publish();                                  //make the working copy the current version
+
+		//readers
+		int registerReader();
+		void unregisterReader(int reader);
+		const MachineVersion* enter(int reader);         //current version, valid until exit()
+		void exit(int reader);
+		unsigned long getVersion() const;                //version of the current state, 0 before the first publish
+};
+
+//------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
+VersionedState::VersionedState() {
+	MachineVersion* first = new MachineVersion();
+	first->version = 0;
+	first->numSlots = 0;
+	first->totals.machines = 1;
+	first->totals.stock = 0;
+	first->totals.money = 0.0;
+	first->totals.sold = 0;
+	first->totals.revenue = 0.0;
+
+	current = first;
+	publishedVersion = 0;
+	totals = first->totals;
+	nextVersion = 1;
+}
+
+VersionedState::~VersionedState() {
+	//readers are gone, pages of the current version are the only ones not retired
+	MachineVersion* last = current.load();
+	for (size_t i = 0; i < last->pages.size(); i++) {
+		delete last->pages[i];
+	}
+	delete last;
+}
+
+//-----------------------------------------------------------------writer-----------------------------------------------------------------
+void VersionedState::setSlot(int index, const string& name, double price, int stock, int sold, double revenue) {
+	if (index >= (int)working.size()) {
+		working.resize(index + 1);
+		dirtyPages.resize(index / SlotPage::SLOTS + 1, true);
+	}
+
+	SlotView& s = working[index];
+	strncpy(s.name, name.c_str(), sizeof(s.name) - 1);
+	s.name[sizeof(s.name) - 1] = '\0';
+	s.price = price;
+	s.stock = stock;
+	s.sold = sold;
+	s.revenue = revenue;
+	dirtyPages[index / SlotPage::SLOTS] = true;
+}
+
+void VersionedState::setTitle(const string& t) {
+	title = t;
+}
+
+void VersionedState::setTotals(const MachineTotals& t) {
+	totals = t;
+}
+
+void VersionedState::publish() {
+	const MachineVersion* old = current.load();
+	MachineVersion* next = new MachineVersion();
+	vector<const SlotPage*> replaced;
+
+	next->version = nextVersion++;
+	next->title = title;
+	next->totals = totals;
+	next->numSlots = (int)working.size();
+	next->pages.resize(dirtyPages.size(), nullptr);
+
+	for (size_t p = 0; p < dirtyPages.size(); p++) {
+		if (!dirtyPages[p] && p < old->pages.size()) {
+			next->pages[p] = old->pages[p]; //unchanged, share it
+			continue;
+		}
+
+		SlotPage* page = new SlotPage();
+		for (int k = 0; k < SlotPage::SLOTS && p * SlotPage::SLOTS + k < working.size(); k++) {
+			page->slots[k] = working[p * SlotPage::SLOTS + k];
+		}
+		next->pages[p] = page;
+		if (p < old->pages.size()) {
+			replaced.push_back(old->pages[p]);
+		}
+		dirtyPages[p] = false;
+	}
+
+	current.store(next);
+	publishedVersion = next->version;
+
+	//the old root and its replaced pages are only reachable by readers already inside
+	epochs.retire(const_cast<MachineVersion*>(old));
+	for (size_t i = 0; i < replaced.size(); i++) {
+		epochs.retire(const_cast<SlotPage*>(replaced[i]));
+	}
+	epochs.reclaim();
+}
+
+//-----------------------------------------------------------------readers-----------------------------------------------------------------
+int VersionedState::registerReader() {
+	return epochs.registerReader();
+}
+
+void VersionedState::unregisterReader(int reader) {
+	epochs.unregisterReader(reader);
+}
+
+const MachineVersion* VersionedState::enter(int reader) {
+	epochs.enter(reader);
+	return current.load();
+}
+
+void VersionedState::exit(int reader) {
+	epochs.exit(reader);
+}
+
+unsigned long VersionedState::getVersion() const {
+	return publishedVersion.load();
+}
+
+#endif
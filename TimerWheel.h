@@ -0,0 +1,216 @@
+#ifndef _TIMER_WHEEL_
+#define _TIMER_WHEEL_
+
+#include <vector>
+
+using namespace std;
+
+/*
+ * Hierarchical timer wheel: 4 levels of 64 slots, one tick is tickMs
+ * milliseconds. A timer sits in the lowest level whose range covers its
+ * delay and moves down one level each time the level below wraps around.
+ * Scheduling, cancelling and expiring a timer are all O(1); timers live in
+ * a node pool linked by index, so no allocation happens once the pool has
+ * grown to the number of outstanding timers.
+ */
+class TimerWheel {
+	private:
+		static const int LEVELS = 4;
+		static const int SLOT_BITS = 6;
+		static const int SLOTS = 1 << SLOT_BITS;   //64 slots per level
+		static const int MASK = SLOTS - 1;
+
+		struct Node {
+			unsigned long long expireTick;  //tick when the timer fires
+			int payload;                    //value handed back on expiry
+			int prev;                       //neighbours in the slot list, -1 if none
+			int next;
+			int level;                      //where the node is linked, -1 if free
+			int slot;
+			unsigned int generation;        //bumped on every reuse, makes stale handles harmless
+		};
+
+		vector<Node> nodes;
+		vector<int> freeNodes;
+		int heads[LEVELS][SLOTS];           //first node of every slot list, -1 if empty
+		unsigned long long currentTick;     //ticks processed so far
+		unsigned long long nowMs;           //wheel time in milliseconds
+		unsigned long lastTime;             //last tick count given to advance()
+		unsigned long tickMs;
+		int count;                          //number of pending timers
+
+		void link(int index);               //put a node in the slot matching its expiry
+		void unlink(int index);             //take a node out of its slot list
+		void release(int index);            //return a node to the pool
+		void cascade(int level);            //move the current slot of a level down
+
+	public:
+		TimerWheel(unsigned long now, unsigned long tickLength = 10);
+
+		long long schedule(unsigned long delayMs, int payload);  //start a timer, returns its handle
+		bool cancel(long long handle);                           //stop a timer, false if it already fired
+		int advance(unsigned long now, vector<int> &expired);    //fire due timers, payloads go to expired
+		int size() const;                                        //number of pending timers
+};
+
+//------------------------------------------------------------------constructor-----------------------------------------------------------------
+TimerWheel::TimerWheel(unsigned long now, unsigned long tickLength) {
+	for (int l = 0; l < LEVELS; l++) {
+		for (int s = 0; s < SLOTS; s++) {
+			heads[l][s] = -1;
+		}
+	}
+
+	tickMs = (tickLength > 0) ? tickLength : 1;
+	currentTick = 0;
+	nowMs = 0;
+	lastTime = now;
+	count = 0;
+}
+
+//-----------------------------------------------------------------timers-----------------------------------------------------------------
+long long TimerWheel::schedule(unsigned long delayMs, int payload) {
+	int index;
+
+	if (!freeNodes.empty()) {
+		index = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else {
+		index = (int)nodes.size();
+		Node n;
+		n.generation = 0;
+		nodes.push_back(n);
+	}
+
+	Node& n = nodes[index];
+	n.expireTick = (nowMs + delayMs + tickMs - 1) / tickMs;
+	if (n.expireTick <= currentTick) {
+		n.expireTick = currentTick + 1; //never fire in the past
+	}
+	n.payload = payload;
+	link(index);
+	count++;
+
+	return ((long long)n.generation << 32) | index;
+}
+
+bool TimerWheel::cancel(long long handle) {
+	int index = (int)(handle & 0xFFFFFFFFLL);
+	unsigned int generation = (unsigned int)(handle >> 32);
+
+	if (handle < 0 || index >= (int)nodes.size() || nodes[index].level < 0 || nodes[index].generation != generation) {
+		return false;
+	}
+
+	unlink(index);
+	release(index);
+	return true;
+}
+
+int TimerWheel::advance(unsigned long now, vector<int> &expired) {
+	nowMs += now - lastTime; //unsigned difference also works when the tick count wraps
+	lastTime = now;
+
+	unsigned long long targetTick = nowMs / tickMs;
+	int fired = 0;
+
+	while (currentTick < targetTick) {
+		if (count == 0) {
+			currentTick = targetTick; //nothing pending, skip the idle ticks
+			break;
+		}
+		currentTick++;
+
+		//when a level wraps to slot 0, the slot above it moves down, highest level first
+		int top = 0;
+		while (top + 1 < LEVELS && (currentTick & ((1ULL << (SLOT_BITS * (top + 1))) - 1)) == 0) {
+			top++;
+		}
+		for (int l = top; l >= 1; l--) {
+			cascade(l);
+		}
+
+		int slot = (int)(currentTick & MASK);
+		while (heads[0][slot] != -1) {
+			int index = heads[0][slot];
+			unlink(index);
+
+			if (nodes[index].expireTick > currentTick) {
+				link(index); //clamped far timer, not due yet
+				continue;
+			}
+
+			expired.push_back(nodes[index].payload);
+			release(index);
+			fired++;
+		}
+	}
+	return fired;
+}
+
+int TimerWheel::size() const {
+	return count;
+}
+
+//-----------------------------------------------------------------slot lists-----------------------------------------------------------------
+void TimerWheel::link(int index) {
+	Node& n = nodes[index];
+	unsigned long long delta = n.expireTick - currentTick;
+	unsigned long long tick = n.expireTick;
+	int level = 0;
+
+	while (level < LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1)))) {
+		level++;
+	}
+
+	//beyond the top level range, park in the furthest slot and re-link on cascade
+	if (delta >= (1ULL << (SLOT_BITS * LEVELS))) {
+		tick = currentTick + (1ULL << (SLOT_BITS * LEVELS)) - 1;
+	}
+
+	n.level = level;
+	n.slot = (int)((tick >> (SLOT_BITS * level)) & MASK);
+	n.prev = -1;
+	n.next = heads[level][n.slot];
+
+	if (n.next != -1) {
+		nodes[n.next].prev = index;
+	}
+	heads[level][n.slot] = index;
+}
+
+void TimerWheel::unlink(int index) {
+	Node& n = nodes[index];
+
+	if (n.prev != -1) {
+		nodes[n.prev].next = n.next;
+	}
+	else {
+		heads[n.level][n.slot] = n.next;
+	}
+	if (n.next != -1) {
+		nodes[n.next].prev = n.prev;
+	}
+}
+
+void TimerWheel::release(int index) {
+	nodes[index].level = -1;
+	nodes[index].generation++;
+	freeNodes.push_back(index);
+	count--;
+}
+
+void TimerWheel::cascade(int level) {
+	int slot = (int)((currentTick >> (SLOT_BITS * level)) & MASK);
+	int index = heads[level][slot];
+	heads[level][slot] = -1;
+
+	while (index != -1) {
+		int next = nodes[index].next;
+		link(index);
+		index = next;
+	}
+}
+
+#endif
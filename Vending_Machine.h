@@ -10,11 +10,41 @@
 #include <limits>
 #include <windows.h>
 #include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <ctime>
 #include "Item.h"
+#include "InputReader.h"
+#include "TimerWheel.h"
+#include "Catalog.h"
+#include "Expiry.h"
+#include "Aggregate.h"
+#include "SalesHistory.h"
+#include "Alert.h"
+#include "FleetStock.h"
+#include "RestockPlanner.h"
+#include "Pricing.h"
+#include "Snapshot.h"
+#include "EventBus.h"
+#include "GridRenderer.h"
+#include "MemoryAccount.h"
+#include "Planogram.h"
 
 using namespace std;
 
-class VendingMachine {
+//result codes for a non-interactive sale
+enum SaleResult {
+	SALE_OK = 0,          //item dispensed
+	SALE_INVALID_ITEM,    //item index out of range
+	SALE_OUT_OF_STOCK,    //no stock left in the item queue
+	SALE_INSUFFICIENT,    //amount paid is lower than the price
+	SALE_NO_CHANGE,       //not enough money in the machine to give change
+	SALE_HOLD_EXPIRED     //the reservation was released before payment completed
+};
+
+class VendingMachine : protected MemoryOwner, public ExpiryTarget, public StockListener {
 	private:
 		Item* itemArray;   		//dynamic array of Items
 		int itemArraySize;  	//user input size
@@ -23,7 +53,74 @@ class VendingMachine {
 		
 		int totalStock;     	//total items inside VM, eg. 5 items * 20 stock = 100 items total
 		double totalMoney;  	//the total amount of cash inside VM
+		int* itemSold;          //units sold per item
+		double* itemRevenue;    //money taken per item
+		long long unitsSold;    //units sold over all items
+		double totalRevenue;    //money taken over all items
+		double cashlessRevenue; //part of totalRevenue paid by card or e-wallet, never in the cash box
+		FleetAggregate* fleet;  //fleet totals this machine reports to, nullptr if none
+		SalesHistory* history;  //where every sale is recorded, nullptr if not kept
+		int machineId;          //machine number in the sales history and alerts
+		int* lowThreshold;      //per item, stock at or below this raises a low stock alert
+		AlertQueue* alerts;     //where threshold crossings go, nullptr if nobody listens
+		FleetStock* stockMirror;//flat copy of slot data for fleet scans, nullptr if not mirrored
+		int mirrorMachine;      //machine index in stockMirror
+		RestockPlanner* planner;//demand estimates and fill lists, nullptr if not planned
+		int plannerMachine;     //machine index in planner
+		PricingEngine* pricing; //dynamic price rules, nullptr for fixed prices
+		unsigned int basketMask;//items sold in the current bundle window, bit (item - 1)
+		long long basketTime;   //time of the last sale, starts the bundle window
+		VersionedState state;   //published versions of the machine for consistent reads
+		int stateReader;        //this machine's own reader slot in state
+		int updateDepth;        //open beginUpdate() calls, versions are held back while above 0
+		bool statePending;      //a publish was held back by an update
+		int* pendingEvents;     //per slot (0 for the machine), bit (1 << type) of events held back by an update
+		EventBus events;        //changes of this machine for displays, metrics and clients
+		GridRenderer grid;      //item grid, redrawn from events
 	    string machineTitle;    //title of the vending machine
+	    InputReader* input;     //buffered reader for all menu input, owned by the console, nullptr if none
+	    
+	    //a unit held for a customer between selection and payment
+	    struct Hold {
+	    	int itemOpt;            //item index (1-based), 0 if the hold is free
+	    	double price;           //price when the unit was selected, kept if the catalog changes
+	    	long long timer;        //expiry timer in holdTimers
+	    	unsigned int generation;//bumped on every reuse, makes stale hold ids harmless
+		};
+	    int* itemReserved;      //units currently held per item
+	    vector<Hold> holds;     //pool of holds, indexed by the low half of a hold id
+	    vector<int> freeHolds;
+	    TimerWheel holdTimers;  //expiry of every outstanding hold
+	    
+	    int findHold(long long holdId) const;                //index of an active hold, -1 if expired or invalid
+	    int completeSale(int itemOpt, double price, double totalPaid, double &change, bool cash = true); //shared end of every sale
+	    void changeMoney(double amount);                     //add cash, keeps the fleet totals in step
+	    void recordSale(int itemOpt, double price, double totalPaid, double change, int status); //append to the sales history
+	    void postAlert(int type, int itemOpt, int stock);    //send one alert to the subscribers
+	    void mirrorSlot(int itemOpt);                        //copy one slot into the stock mirror
+	    void mirrorCash();                                   //copy the cash into the stock mirror
+	    void refreshSlot(int itemOpt);                       //copy one item into the working version
+	    void publishState();                                 //publish the working version to readers
+	    void postEvent(int type, int itemOpt);               //tell the subscribers about a change, itemOpt 0 for machine events
+	    void changeTitle(const string& title);               //set, publish and announce the machine title
+	    
+	    CatalogWatcher* catalog;  //source of names and prices, nullptr if not attached
+	    int catalogReader;        //epoch reader slot in the watcher
+	    unsigned long catalogVersion; //last version copied into the items
+	    vector<CatalogEntry> catalogApplied; //entries of that version, to tell which lines changed
+	    static const CatalogEntry* findEntry(const vector<CatalogEntry>& entries, const string& name); //nullptr if no line has the name
+	    
+	    ExpiryIndex ownExpiry;    //expiry index used unless a shared one is set
+	    ExpiryIndex* expiryIndex; //where new lots are indexed
+	    int expiredUnits;         //units purged because their lot expired
+	    void indexLots(int itemOpt);                         //add every lot of a slot to the expiry index
+	    
+	    //input helpers, end of input closes the program like the Exit option
+	    bool readInt(int &value);                            //read one integer line, value is 0 if invalid
+	    bool readMoney(double &value);                       //read one amount line, value is 0 if invalid
+	    char readYesNo();                                    //read one Y/N line, returns 'Y', 'N' or 0 if invalid
+	    bool readText(char* text, int size);                 //read one line of text, empty if invalid
+	    void checkInput(int result);                         //exit on end of input
 		
 	public:
 		VendingMachine(int size);                            //constructor
@@ -31,6 +128,7 @@ class VendingMachine {
 		void addItem(const Item& item);                      //add item to vending machine
 		
 		void mainMenu(); 					   			     //menu to select 3 options
+		void setInput(InputReader* reader);                  //read menu input from reader, nullptr for a machine without a console
 		
 		//show Items 
 		void printItems() const;                             //print the vending machine interface like in question
@@ -52,6 +150,9 @@ class VendingMachine {
 	    void changePrice();                                  //change the price of an item
 	    void changeName();		     						 //change the title and stock header name
 	    void addFunds();   			                   	     //add funds to the vending machine
+	    void salesReport();                                  //show sales analytics from the history
+	    void restockByPlan();                                //fill the slots the restock planner asks for
+	    void replanSlots();                                  //give fast sellers more and deeper slots
     	 
 	    void reset();						  	 	         //clear screen purpose 
 
@@ -62,15 +163,116 @@ class VendingMachine {
 	    
 	    bool isEmpty() const; 					  	   	    //check if vending machine is empty
 	    bool isFull() const;  					  		    //check if vending machine is full
+	    
+	    //non-interactive operations (used by server mode, no prompts or screen output)
+	    int getNumQueue() const;                             //get the number of items in the machine
+	    int getNumSlots() const;                             //get the number of slots the machine was built with
+	    const Item& getItem(int index) const;                //get item by 0-based index
+	    int getTotalStock() const;                           //get total stock inside the machine
+	    double getTotalMoney() const;                        //get total money inside the machine
+	    string getTitle() const;                             //get the machine title
+	    int sellItem(int itemOpt, double totalPaid, double &change); //complete a sale, returns a SaleResult
+	    int restockItem(int itemOpt, int stock, long long expiry = 0); //add one lot to an item without prompting, returns number added
+	    bool setItemPrice(int itemOpt, double price);        //change the price of an item without prompting
+	    bool setItemDepth(int itemOpt, int depth);           //change the capacity of a slot, false if the stock would not fit
+	    bool addMoney(double amount);                        //add funds to the machine without prompting
+	    int clearItem(int itemOpt);                          //reset the stock of one item to zero, returns units removed
+	    
+	    //reservations, hold one unit from selection until payment completes or times out
+	    static const unsigned long HOLD_MS = 120000;         //how long a console customer may take to pay
+	    long long reserveItem(int itemOpt, unsigned long now, unsigned long holdMs); //returns a hold id, -1 if nothing available
+	    bool releaseItem(long long holdId);                  //give a held unit back
+	    int sellReserved(long long holdId, double totalPaid, double &change); //sell the held unit, returns a SaleResult
+	    int sellCashless(long long holdId, int itemOpt, double authorized); //sell the held unit, or any free unit of itemOpt if the hold expired, booked at the amount authorized
+	    double getCashlessRevenue() const;                   //money taken by card and e-wallet
+	    int expireHolds(unsigned long now);                  //release holds that timed out, returns how many
+	    int getAvailableStock(int itemOpt) const;            //stock that is not held by anyone
+	    double getHoldPrice(long long holdId) const;         //price locked by a hold, 0 if expired
+	    
+	    //catalog hot-reload
+	    void attachCatalog(CatalogWatcher* watcher);         //take names and prices from a watched catalog
+	    bool syncCatalog();                                  //copy a newer catalog version into the items, true if changed
+	    
+	    //perishable stock
+	    void setExpiryIndex(ExpiryIndex* index);             //share one expiry index between machines, nullptr for the machine's own
+	    int sweepExpired(long long now);                     //purge every due lot in the index, returns units removed
+	    int purgeSlot(int itemOpt, long long now);           //purge expired lots of one item, returns units removed
+	    int getExpiredUnits() const;                         //units purged so far
+	    
+	    //aggregates, kept up to date on every change so reads are O(1)
+	    void stockChanged(int itemOpt, int delta);           //called by the items on every stock change
+	    MachineTotals getTotals() const;                     //stock, cash and sales totals of this machine
+	    int getItemSold(int itemOpt) const;                  //units sold of an item
+	    double getItemRevenue(int itemOpt) const;            //money taken for an item
+	    void setFleet(FleetAggregate* f);                    //report changes to fleet totals, nullptr to stop
+	    
+	    //sales history
+	    void setHistory(SalesHistory* h, int id);            //record every sale in h as machine id
+	    void printSalesReport(long long from, long long to); //print analytics for [from, to) without prompting
+	    
+	    //stock alerts, checked on every stock change
+	    static const int DEFAULT_LOW_STOCK = 3;              //threshold of a new machine
+	    void setAlerts(AlertQueue* queue);                   //post threshold crossings to queue, nullptr to stop
+	    bool setLowStockThreshold(int itemOpt, int threshold); //stock at or below threshold raises an alert
+	    int getLowStockThreshold(int itemOpt) const;
+	    
+	    //structure-of-arrays mirror for fleet-wide scans
+	    void setFleetStock(FleetStock* mirror);              //keep slot counts, capacities, prices and cash in mirror
+	    void priceChanged(int itemOpt, double price);        //called by the items on every price change
+	    
+	    //demand-driven restocking
+	    void setPlanner(RestockPlanner* p);                  //feed sales and stock to p, nullptr to stop
+	    int getFillList(vector<FillLine>& out);              //slots to fill on the next visit, returns units to bring
+	    
+	    //dynamic pricing
+	    void setPricing(PricingEngine* engine);              //price items with engine, nullptr for the fixed prices
+	    double getCurrentPrice(int itemOpt);                 //price a customer pays now
+	    
+	    //slot planning
+	    void fillPlanogram(Planogram& p, const vector<double>& slotRates) const; //items, rates and layout of this machine, slotRates per hour by slot
+	    int applyPlanogram(const Planogram& p);              //rearrange every slot at once, returns units that no longer fit, -1 if refused
+	    
+	    //versioned state, readers get a consistent copy without blocking sales
+	    void nameChanged(int itemOpt);                       //called by the items when renamed
+	    int registerSnapshotReader();                        //reader slot for another thread
+	    void unregisterSnapshotReader(int reader);
+	    const MachineVersion* enterSnapshot(int reader);     //current version, valid until exitSnapshot()
+	    void exitSnapshot(int reader);
+	    int getOwnReader() const;                            //reader slot for the thread that runs the machine
+	    void beginUpdate();                                  //hold back versions and events until endUpdate(), calls nest
+	    void endUpdate();                                    //publish everything changed since beginUpdate() as one version, one event per slot and type
+	    
+	    //change notifications, delivered on the thread that runs the machine
+	    void subscribe(EventSubscriber* s, int mask = MACHINE_ALL_EVENTS);
+	    void unsubscribe(EventSubscriber* s);
+	    
+	    //persistence, for machines kept on disk while idle
+	    void saveState(ostream& out) const;                  //title, cash, sales counters and every item with its lots
+	    bool loadState(istream& in);                         //restore into a machine without items, false if malformed
+	    
+	    //memory accounting, every allocation of the machine is charged to its account
+	    int getMemoryAccount() const;
+	    MemoryUsage getMemoryUsage() const;                  //live bytes and blocks of this machine
+	    void printMemory() const;                            //live memory per subsystem and per item
 };
 
 //------------------------------------------------------------------constructor & destructor-----------------------------------------------------------------
-VendingMachine::VendingMachine(int size) {
+VendingMachine::VendingMachine(int size) : MemoryOwner("VendingMachine"), holdTimers(GetTickCount()) {
 	//initialize number of item queue in the vending machine
 	maxSize = 5;
 	itemArraySize = size;
-	itemArray = new Item[itemArraySize];
+	{
+		MemoryScope scope(memoryAccount, MEM_ITEMS); //the rest of the machine is charged to MEM_OTHER
+		itemArray = new Item[itemArraySize];
+	}
+	itemReserved = new int[itemArraySize]();
 	numQueue = 0;
+	input = nullptr;
+	catalog = nullptr;
+	catalogReader = -1;
+	catalogVersion = 0;
+	expiryIndex = &ownExpiry;
+	expiredUnits = 0;
 	
 	//cannot run if size is over maximum 
 	if (itemArraySize > maxSize) {
@@ -80,11 +282,55 @@ VendingMachine::VendingMachine(int size) {
 	//initialize stock and money
 	totalStock = 0;
 	totalMoney = 0.00;
-	machineTitle = "INTI Vending Machine";
+	itemSold = new int[itemArraySize]();
+	itemRevenue = new double[itemArraySize]();
+	unitsSold = 0;
+	totalRevenue = 0.00;
+	cashlessRevenue = 0.00;
+	fleet = nullptr;
+	history = nullptr;
+	machineId = 1;
+	alerts = nullptr;
+	stockMirror = nullptr;
+	mirrorMachine = -1;
+	planner = nullptr;
+	plannerMachine = -1;
+	pricing = nullptr;
+	basketMask = 0;
+	basketTime = 0;
+	stateReader = state.registerReader();
+	updateDepth = 0;
+	statePending = false;
+	pendingEvents = new int[itemArraySize + 1]();
+	events.subscribe(&grid);
+	lowThreshold = new int[itemArraySize];
+	for (int i = 0; i < itemArraySize; i++) {
+		lowThreshold[i] = DEFAULT_LOW_STOCK;
+	}
+	changeTitle("INTI Vending Machine");
+	constructed(); //allocations from here on belong to the caller again
 } 
 
 VendingMachine::~VendingMachine() {
+	if (catalog) {
+		catalog->unregisterReader(catalogReader);
+	}
+	if (expiryIndex != &ownExpiry) {
+		expiryIndex->removeTarget(this);
+	}
+	setFleet(nullptr);
+	setFleetStock(nullptr);
+	setPlanner(nullptr);
+	state.unregisterReader(stateReader);
+	for (int i = 0; i < itemArraySize; i++) {
+		itemArray[i].releaseQ(); //every slot was built from its own item, the machine holds the last copy
+	}
 	delete[] itemArray;
+	delete[] itemReserved;
+	delete[] pendingEvents;
+	delete[] itemSold;
+	delete[] itemRevenue;
+	delete[] lowThreshold;
 }
 
 void VendingMachine::addItem(const Item& item) {
@@ -95,8 +341,13 @@ void VendingMachine::addItem(const Item& item) {
     }
     else {
     	itemArray[numQueue] = item;
+    	itemArray[numQueue].setListener(this, numQueue + 1);
+    	itemArray[numQueue].setMemoryAccount(memoryAccount);
     	numQueue++;
-    	totalStock += item.getNumStockQ();
+    	mirrorSlot(numQueue);
+    	postEvent(MACHINE_NAME_CHANGED, numQueue);
+    	postEvent(MACHINE_PRICE_CHANGED, numQueue);
+    	stockChanged(numQueue, item.getNumStockQ()); //starting stock was added before the listener
 	}
 }
 
@@ -105,6 +356,8 @@ void VendingMachine::mainMenu() {
 	int option1;
 
 	do {
+		syncCatalog(); //pick up catalog changes between customers
+		sweepExpired(time(NULL));
 		cout << "\n\n";
 		cout << "\t\t\t\t ====================\n";
 		cout << "\t\t\t\t      WELCOME TO\n\n";
@@ -114,8 +367,7 @@ void VendingMachine::mainMenu() {
 		cout << "\t\t\t\t2 " << left << setw(18) << "[Inventory-Admin" << "]\n";
 		cout << "\t\t\t\t3 " << left << setw(18) << "[Exit" << "]\n\n";
 		cout << "\t\t\tEnter Option: ";
-		cin >> option1;
-		cin.ignore(numeric_limits<streamsize>::max(),'\n'); 
+		readInt(option1);
 		
 		switch(option1) {
 			case 1:
@@ -135,77 +387,16 @@ void VendingMachine::mainMenu() {
 				exit(0);
 				break;
 			default:
-				//Case 1: if user enter double, char or string
-				if (cin.fail()){
-					reset();
-					cout << "\t\t\t\t    INVALID OPTION\n";
-					cout << "\t\t\t     PLEASE ENTER A VALID OPTION\n";
-					cin.clear(); //clear failbit and ignore remaining input
-					cin.ignore(numeric_limits<streamsize>::max(),'\n');
-				}
-				//Case 2: if user enter int not which is not in range
-				else{
-					reset();
-					cout << "\t\t\t\t    INVALID OPTION\n";
-					cout << "\t\t\t     PLEASE ENTER A VALID OPTION\n";
-				}
+				//if user enter double, char, string or int which is not in range
+				reset();
+				cout << "\t\t\t\t    INVALID OPTION\n";
+				cout << "\t\t\t     PLEASE ENTER A VALID OPTION\n";
 		}
 	} while (option1 != 3);	
 }
 
 void VendingMachine::printItems() const {
-	
-	cout << "\n\n\t\t\t\t\t\t[" << machineTitle << "] \n\n\n";
-	
-    int maxSize = itemArray[0].getMaxSize(); //all items have same max stock size, 20
-    int nLength[numQueue];                   //array to store lengths of item names
-    int midpoint[numQueue];                  //array to store midpoints of item names
-    int blank = 0;
-    
-    cout << "\t\t";
-    for (int i=0; i<numQueue; i++) {
-    	//get item name length and the midpoint of the name
-    	string name = getItemName(itemArray[i]) + " [" + to_string(i+1) + "] ";
-    	nLength[i] = name.length();
-		midpoint[i] = name.length() / 2;
-    	
-    	//display item name
-    	cout << left << setw(15) << name << string(5,' ');
-	} cout << endl << "\t\t";
-	
-	//display dashes
-	for (int i=0; i < 20*numQueue-10; i++) {
-		cout << "-";
-	} cout << endl;
-	
-	//print characters representing item stock
-	for (int i=0; i<maxSize; i++) { //for number of rows
-		cout << "\t\t";
-		for (int j=0; j<numQueue; j++) { //for types of items
-			int stock = getItemStock(itemArray[j]); //get current stock of the item
-			blank = maxSize - stock; //calculate number of blanks
-			
-			//if there is no stock
-			if (stock == 0){
-				if (i == 0){
-					cout << left << setw(15) << setfill(' ') << "<Out of Stock> " << string(5, ' ');
-				}
-				else {
-					cout << string(20, ' ');
-				}
-			}
-			//if in stock
-			else {
-				if (i < blank) {
-					cout << string(midpoint[j], ' ') << " " << string(19-midpoint[j], ' ');
-				}
-				else {
-					cout << string(midpoint[j],' ') << getItemChar(itemArray[j]) << string(19-midpoint[j], ' ');
-				}				
-			}
-		} cout << endl;
-	}
-	cout << endl;  
+	grid.draw(cout); //kept current by the stock, price, name and title events
 }
 
 void VendingMachine::selectItem() { 
@@ -221,12 +412,12 @@ void VendingMachine::selectItem() {
 		
 		do { 
 			cout << "Enter Option" << ": ";
-			cin >> itemOpt;
+			readInt(itemOpt);
 			
 			//Case 1: enter a valid choice
 			if (itemOpt >= 1 && itemOpt <= numQueue) {
-				//Case 1a: if item is out of stock
-				if (itemArray[itemOpt - 1].getNumStockQ() == 0) {
+				//Case 1a: if item is out of stock or every unit is held by other customers
+				if (getAvailableStock(itemOpt) <= 0) {
 					validOpt = false;
 					reset();
 					printItems();
@@ -235,8 +426,6 @@ void VendingMachine::selectItem() {
 				//Case 1b: if item is in stock, continue with making payment
 				else {
 					reset();
-					cin.clear();
-					cin.ignore(numeric_limits<streamsize>::max(),'\n'); // Clear input buffer
                     transSuccess = makePayment(itemOpt); // Attempt to make payment for selected item
                     validOpt = true; // Valid option selected, exit loop
                 }
@@ -246,24 +435,12 @@ void VendingMachine::selectItem() {
             	reset();
 				mainMenu(); // Return to main menu
 			}
-			//Case 3: invalid choice
+			//Case 3: invalid choice, non-integer input or integer not in range
 			else {
-				//Case 3a: if user enters non-integer input
-				if (cin.fail()) {
-					reset();
-					printItems();
-					cout << "INVALID OPTION\n";
-					cout << "PLEASE ENTER A VALID OPTION\n\n";
-					cin.clear(); // Clear failbit and ignore remaining input
-					cin.ignore(numeric_limits<streamsize>::max(),'\n');
-				}
-				//Case 3b: if user enters integer not in range
-				else {
-					reset();
-					printItems();
-					cout << "INVALID OPTION\n";
-					cout << "PLEASE ENTER A VALID OPTION\n\n";
-				}
+				reset();
+				printItems();
+				cout << "INVALID OPTION\n";
+				cout << "PLEASE ENTER A VALID OPTION\n\n";
             }
 		} while (!validOpt); //repeat until a valid option is chosen
 		
@@ -271,8 +448,7 @@ void VendingMachine::selectItem() {
 		if (transSuccess) {
             do {
                 cout << "Buy Another Item (Y/N): ";
-                cin >> ctnShopping;
-                ctnShopping = toupper(ctnShopping);
+                ctnShopping = readYesNo();
 
                 if (ctnShopping != 'Y' && ctnShopping != 'N') {
                 	reset();
@@ -301,7 +477,8 @@ void VendingMachine::selectItem() {
 }
 	
 bool VendingMachine::makePayment(int itemOpt) {
-    double price = itemArray[itemOpt - 1].getPrice(); //get price of the selected item
+    long long hold = reserveItem(itemOpt, GetTickCount(), HOLD_MS); //keep one unit for this customer while paying
+    double price = (hold >= 0) ? getHoldPrice(hold) : getCurrentPrice(itemOpt); //the price the hold will charge
     double totalPaid = 0.0;                           //initialize total amount paid by the user
     double money;                                     //variable to store each amount entered by the user
     
@@ -311,11 +488,9 @@ bool VendingMachine::makePayment(int itemOpt) {
     while (totalPaid < price) {
         cout << "Please Pay RM " << fixed << setprecision(2) << price - totalPaid << " to Purchase Item\n\n";
         cout << "Enter Amount: RM ";
-        cin >> money;
+        readMoney(money);
         
         if (money <= 0) {
-        	cin.clear(); // Clear failbit and ignore remaining input
-			cin.ignore(numeric_limits<streamsize>::max(),'\n');
             cout << "\n\nINVALID AMOUNT! PLEASE ENTER A VALID VALUE!\n";
             Sleep(1000);
             reset();
@@ -335,8 +510,7 @@ bool VendingMachine::makePayment(int itemOpt) {
             //prompt user to cancel transaction if amount is insufficient
             do {
                 cout << "Cancel Transaction (Y/N): ";
-                cin >> reply;
-                reply = toupper(reply);
+                reply = readYesNo();
         
                 if (reply != 'Y' && reply != 'N') {
                     reset();
@@ -347,6 +521,7 @@ bool VendingMachine::makePayment(int itemOpt) {
         
             if (reply == 'Y') {
                 reset();
+                releaseItem(hold);
                 refundPayment(totalPaid); //refund the amount paid
                 return false; //transaction cancelled
             }
@@ -354,27 +529,30 @@ bool VendingMachine::makePayment(int itemOpt) {
         }
     }
     
-    //payment successful, now check if change can be provided
-    double change = totalPaid - price;
+    //payment successful, now check if change can be provided and dispense the item
+    double change;
+    int result = sellReserved(hold, totalPaid, change);
+    
+    if (result == SALE_HOLD_EXPIRED) {
+    	result = sellItem(itemOpt, totalPaid, change); //took too long, sell if there is still a free unit
+	}
     
-    if (change > totalMoney) {
-        cout << "!!!SORRY, NOT ENOUGH CHANGE IN MACHINE!!!\n";
+    if (result != SALE_OK) {
+    	if (result == SALE_NO_CHANGE) {
+        	cout << "!!!SORRY, NOT ENOUGH CHANGE IN MACHINE!!!\n";
+		}
+		else {
+			cout << "!!!SORRY, ITEM IS NO LONGER AVAILABLE!!!\n";
+		}
         Sleep(1800); 
         reset();
+        releaseItem(hold); //still held if the sale was refused before the unit was taken
         refundPayment(totalPaid); //refund the amount paid
         return false; //cannot provide change, transaction failed
     }
     
-    //able to provide change, proceed with the transaction
-    totalMoney += price - change; //update the machine's total money
-    
     reset(); 
     
-    //update item stock and total stock count
-    Item item;
-    itemArray[itemOpt - 1].removeStockFromQ(item);
-    totalStock--;
-    
     printItems(); //display items after transaction
     
     cout << "!!!PAYMENT SUCCESSFUL!!!\n";
@@ -424,7 +602,7 @@ void VendingMachine::logRegMenu() {
 		cout << "\t\t\t\tPress 1 to LOGIN : " << endl;
 		cout << "\t\t\t\tPress 2 to REGISTER : " << endl;
 		cout << "\t\t\t\tChoice => ";
-		cin >> c;
+		readInt(c);
 		
 		cout<<"\n";
 		
@@ -445,15 +623,14 @@ void VendingMachine::logRegMenu() {
 }
 
 void VendingMachine::registration() {
-	string ruserid,rpassword;
+	char ruserid[64], rpassword[64];
 	reset();
-	cin.ignore();
 	
 	cout<<"\t\t\t\tEnter the Username: ";
-	getline(cin,ruserid);
+	readText(ruserid, sizeof(ruserid));
 	
 	cout<<"\t\t\t\tEnter the Password: ";
-	getline(cin,rpassword);
+	readText(rpassword, sizeof(rpassword));
 	
 	ofstream fl("records.txt");
 	fl << ruserid << ' ' << rpassword << endl;
@@ -466,16 +643,16 @@ void VendingMachine::registration() {
 
 void VendingMachine::login() {
 	int count = 0;
-	string password,userid,id,pass;
+	char password[64], userid[64];
+	string id, pass;
 	
 	cout << "\t\t\t\tPlease Enter the Username & Password \n\n";
-	cin.ignore();
 	
 	cout << "\t\t\t\tUSERNAME: ";
-	getline(cin,userid);
+	readText(userid, sizeof(userid));
 	
 	cout << "\t\t\t\tPASSWORD: ";
-	getline(cin,password);
+	readText(password, sizeof(password));
 	
 	ifstream input("records.txt"); //read data from file
 	
@@ -522,8 +699,17 @@ void VendingMachine::exportFile() {
 
 void VendingMachine::adminMenu() {
 	int option2;
+	vector<StockAlert> pending; //alerts raised since the admin menu was last shown
 	
 	do {
+		pending.clear();
+		if (alerts && alerts->drain(pending) > 0) {
+			cout << "\t\t\t\t   STOCK ALERTS\n";
+			for (size_t i = 0; i < pending.size(); i++) {
+				cout << "\t\t\t" << left << setw(12) << AlertQueue::getTypeName(pending[i].type)
+					 << setw(15) << getItemName(itemArray[pending[i].slot - 1]) << pending[i].stock << " left\n";
+			}
+		}
 		cout << "\n\n";
 		cout << "\t\t\t\t    ==========\n";
 		cout << "\t\t\t\t    Admin Menu\n";
@@ -534,9 +720,12 @@ void VendingMachine::adminMenu() {
 		cout << "\t\t\t4 " << left << setw(35) << "[Change Price" << "]\n";
 		cout << "\t\t\t5 " << left << setw(35) << "[Change Title or Stock Header Name" << "]\n";
 		cout << "\t\t\t6 " << left << setw(35) << "[Allocate Extra Funds" << "]\n";
-		cout << "\t\t\t7 " << left << setw(35) << "[Return to Main Menu" << "]\n\n";
+		cout << "\t\t\t7 " << left << setw(35) << "[Sales Report" << "]\n";
+		cout << "\t\t\t8 " << left << setw(35) << "[Restock by Plan" << "]\n";
+		cout << "\t\t\t9 " << left << setw(35) << "[Re-plan Slots" << "]\n";
+		cout << "\t\t\t10 " << left << setw(34) << "[Return to Main Menu" << "]\n\n";
 		cout << "\t\t\t\tEnter Option: ";
-		cin >> option2;
+		readInt(option2);
 
 		switch(option2) {
 			case 1:
@@ -564,6 +753,18 @@ void VendingMachine::adminMenu() {
 				addFunds();
 				break;
 			case 7:
+				reset();
+				salesReport();
+				break;
+			case 8:
+				reset();
+				restockByPlan();
+				break;
+			case 9:
+				reset();
+				replanSlots();
+				break;
+			case 10:
 				reset();
 				mainMenu();
 				break;
@@ -572,7 +773,7 @@ void VendingMachine::adminMenu() {
 				cout << "\t\t\t\t      INVALID OPTION\n";
 				cout << "\t\t\t\tPLEASE ENTER A VALID OPTION\n";
 		} 
-	} while (option2 != 7);	
+	} while (option2 != 10);	
 }
 
 void VendingMachine::replenishStock() {
@@ -585,13 +786,9 @@ void VendingMachine::replenishStock() {
         cout << "\t\t\t\tEnter Item Index to Replenish Stock [1-" << numQueue << "]\n";
         cout << "\t\t\t\tReturn to Admin Menu [" << numQueue + 1 << "]\n\n";
         cout << setw(32) << "\t\t\t\tEnter Option" << ": ";
-        cin >> itemIndex;
-        cin.ignore(numeric_limits<streamsize>::max(),'\n'); //same bug as menu
         
         //if the input is a char, double or string
-        if (cin.fail()){
-        	cin.clear();
-        	cin.ignore(numeric_limits<streamsize>::max(),'\n');
+        if (!readInt(itemIndex)){
             reset();
             cout << "\t\t\t\tINVALID OPTION\n";
             cout << "\t\t\t\tPLEASE ENTER A VALID OPTION\n\n";
@@ -618,15 +815,12 @@ void VendingMachine::replenishStock() {
     do {
     	reset();
         cout << setw(32) << "\t\t\t\tEnter Additional Stock Quantity" << ": ";
-        cin >> stock;
         
         //Case 1: invalid input -- double, char, string
-        if (cin.fail()){
+        if (!readInt(stock)){
             reset();
             cout << "\t\t\t\tINVALID OPTION\n";
             cout << "\t\t\t\tPLEASE ENTER A VALID OPTION\n\n";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(),'\n');
             valid = false; 
             Sleep(1500);
         }
@@ -648,12 +842,21 @@ void VendingMachine::replenishStock() {
         }
         //Case 3: Valid input for how many added items
         else {
+        	int days; //shelf life of this lot
+        	
+        	cout << setw(32) << "\t\t\t\tEnter Shelf Life in Days (0 = no expiry)" << ": ";
+        	while (!readInt(days) || days < 0) {
+        		cout << "\t\t\t\tINVALID NUMBER OF DAYS\n";
+        		cout << setw(32) << "\t\t\t\tEnter Shelf Life in Days (0 = no expiry)" << ": ";
+			}
+			long long expiry = (days > 0) ? time(NULL) + days * 86400LL : 0;
+			
             Item& item = itemArray[itemIndex - 1];
-            int addedCount = item.addStockToQ(stock);  
+            int addedCount = item.addStockToQ(stock, expiry);  
             
             if (addedCount > 0) {
                 cout << "\t\t\t\t!!!STOCK REPLENISHED SUCCESSFULLY!!!\n\n";
-                totalStock += addedCount;
+                expiryIndex->add(expiry, this, itemIndex);
             }
             valid = true;
         }
@@ -670,28 +873,28 @@ void VendingMachine::dispSummary() {
     cout << "MACHINE SUMMARY\n";
     cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
 
-    //display each item's name and current stock
-    for (int i=0; i<numQueue; i++) {
-        cout << left << setw(15) << getItemName(itemArray[i]) << ": " << right << setw(2) << getItemStock(itemArray[i]) << " in stock\n";
-    }
-    
-    //calculate and display total stock across all items
-    int calculatedTotalStock = 0;
-    for (int i=0; i<numQueue; i++) {
-        calculatedTotalStock += getItemStock(itemArray[i]);
+    //read one published version so the items and the totals always agree
+    const MachineVersion* v = enterSnapshot(stateReader);
+    for (int i=0; i<v->numSlots; i++) {
+        const SlotView& s = v->getSlot(i);
+        cout << left << setw(15) << s.name << ": " << right << setw(2) << s.stock << " in stock, " << s.sold << " sold\n";
     }
     
-    //display total stock and total money in the machine
     cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
-    cout << left << setw(15) << "Total Stock" << ": " << calculatedTotalStock << endl;
-    cout << left << setw(15) << "Total Money" << ": " << fixed << setprecision(2) << totalMoney << endl;
-    cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl << endl;
+    cout << left << setw(15) << "Total Stock" << ": " << v->totals.stock << endl;
+    cout << left << setw(15) << "Total Money" << ": " << fixed << setprecision(2) << v->totals.money << endl;
+    cout << left << setw(15) << "Units Sold" << ": " << v->totals.sold << endl;
+    cout << left << setw(15) << "Revenue" << ": " << fixed << setprecision(2) << v->totals.revenue << endl;
+    exitSnapshot(stateReader);
+    cout << left << setw(15) << "Expired Units" << ": " << expiredUnits << endl;
+    cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
+    printMemory();
+    cout << endl;
 
     //prompt user to return to admin menu
     do {
         cout << "Return to Admin Menu (Y): ";
-        cin >> exit;
-        exit = toupper(exit);
+        exit = readYesNo();
 
         if (exit != 'Y') {
             reset();
@@ -709,8 +912,7 @@ void VendingMachine::resetStock() {
 	char confirmation; //variable to store users confirmation choice
 	
 	cout << "Reset All Stock to 0? (Y/N): ";
-	cin >> confirmation;
-	confirmation = toupper(confirmation); //convert input to uppercase
+	confirmation = readYesNo(); //'Y', 'N' or 0 if invalid
 
 	if (confirmation == 'Y' || confirmation == 'N') {
 		reset(); //clear screen and reset display
@@ -721,11 +923,9 @@ void VendingMachine::resetStock() {
 		else {
 			//reset stock of all items to 0
 			for (int i = 0; i < numQueue; i++) {
-				itemArray[i].clearItemQ();
+				itemArray[i].clearItemQ(); //each item reports its own stock change
 			}
 			
-			totalStock = 0; //reset total stock counter
-			
 			cout << "\t\t\t    !!!ALL STOCK HAS BEEN RESET TO 0!!!\n\n";
 		}
 	}
@@ -749,7 +949,7 @@ void VendingMachine::changePrice() {
 	cout << "\t\t\t\tEnter Item Index to Change Price [1-" << numQueue << "]\n";
 	cout << "\t\t\t\tReturn to Admin Menu [" << numQueue + 1 << "]\n\n";
 	cout << setw(15) << "\t\t\t\tEnter Option" << ": ";
-	cin >> itemIndex; //get user's choice for item index
+	readInt(itemIndex); //get user's choice for item index
 	
 	if (itemIndex == numQueue+1) {
 		reset();
@@ -764,7 +964,7 @@ void VendingMachine::changePrice() {
 	}
 	
 	cout << setw(15) << "\t\t\t\tEnter New Price" << ": RM ";
-	cin >> newPrice; //get userr input for new price
+	readMoney(newPrice); //get userr input for new price
 	
 	Item& item = itemArray[itemIndex - 1]; //get reference to the selected item
     
@@ -797,20 +997,21 @@ void VendingMachine::changeName() {
 	cout << "2. Stock Header Name\n";
 	cout << "3. Return to Admin Menu\n\n";
 	cout << "Enter Choice" << ": ";
-	cin >> choice;
-	cin.ignore();
+	readInt(choice);
 	
-	string newName; //variable to store new name input
+	string newName;  //variable to store new name input
+	char text[128];  //line read from the user
 	
 	if (choice == 1) {
 		cout << "Enter New Name" << ": ";
-		getline(cin, newName); //get new machine title from user input
+		readText(text, sizeof(text)); //get new machine title from user input
+		newName = text;
 		
 		for (char &c : newName) {
 			c = toupper(c); //convert all characters to uppercase
 		}
 		
-		machineTitle = newName; //set new machine title
+		changeTitle(newName); //set new machine title
 		
 		reset(); //clear screen and reset display
 		
@@ -825,8 +1026,7 @@ void VendingMachine::changeName() {
 
     	do {
         	cout << "\t\t\t\tEnter Item Index to Change [1-" << numQueue << "]: ";
-        	cin >> itemIndex;
-        	cin.ignore();
+        	readInt(itemIndex);
 		
         	if (itemIndex <= 0 || itemIndex > numQueue) {
             	cout << "\n\t\t\t\tINVALID INDEX\n";
@@ -836,7 +1036,8 @@ void VendingMachine::changeName() {
 
         	do {
             	cout << "\t\t\t\tEnter New Name: ";
-            	getline(cin, newName);
+            	readText(text, sizeof(text));
+            	newName = text;
 
             	if (newName.length() > 15) {
                 	cout << "\n\t\t\t\t!!!ITEM NAME FAILED TO CHANGE!!!\n";
@@ -880,16 +1081,16 @@ void VendingMachine::addFunds() {
 	cout << "1. Add Funds\n";
 	cout << "2. Return to Admin Menu\n\n";
 	cout << setw(22) << "Enter Choice" << ": ";
-	cin >> choice;
+	readInt(choice);
 	
 	if (choice == 1) {
 		cout << "Enter Additional Funds: RM ";
-		cin >> amount; 
+		readMoney(amount); 
 		
 		reset();
 		
 		if (amount > 0) {
-			totalMoney += amount; //add funds to total money
+			changeMoney(amount); //add funds to total money
 			
 			//display success message with new total money
 			cout << "\t\t\t  " << setw(6) << setfill('*') << "*" << " FUNDS ADDED SUCCESSFULLY " << setw(6) << setfill('*') << "*" << setfill(' ') << endl;
@@ -929,6 +1130,59 @@ void VendingMachine::addFunds() {
     adminMenu();
 }
 
+//-----------------------------------------------------------------input helpers-----------------------------------------------------------------
+void VendingMachine::setInput(InputReader* reader) {
+	input = reader;
+}
+
+bool VendingMachine::readInt(int &value) {
+	int result = (input != nullptr) ? input->readInt(value) : (int)READ_EOF;
+	checkInput(result);
+	
+	if (result != READ_OK) {
+		value = 0;
+		return false;
+	}
+	return true;
+}
+
+bool VendingMachine::readMoney(double &value) {
+	int result = (input != nullptr) ? input->readMoney(value) : (int)READ_EOF;
+	checkInput(result);
+	
+	if (result != READ_OK) {
+		value = 0.0;
+		return false;
+	}
+	return true;
+}
+
+char VendingMachine::readYesNo() {
+	char answer;
+	int result = (input != nullptr) ? input->readYesNo(answer) : (int)READ_EOF;
+	checkInput(result);
+	
+	return (result == READ_OK) ? answer : 0;
+}
+
+bool VendingMachine::readText(char* text, int size) {
+	int result = (input != nullptr) ? input->readText(text, size) : (int)READ_EOF;
+	checkInput(result);
+	
+	if (result != READ_OK) {
+		text[0] = '\0';
+		return false;
+	}
+	return true;
+}
+
+void VendingMachine::checkInput(int result) {
+	if (result == READ_EOF) {
+		cout << "\n\n\t\t\t\tEND OF INPUT. HAVE A NICE DAY!\n\n";
+		exit(0);
+	}
+}
+
 //use to clear screen 
 void VendingMachine::reset() {
 	system("cls");
@@ -956,5 +1210,1195 @@ bool VendingMachine::isFull() const {
 	return (numQueue==maxSize);
 }
 
-#endif
+//-----------------------------------------------------------------non-interactive operations-----------------------------------------------------------------
+int VendingMachine::getNumSlots() const {
+	return itemArraySize;
+}
+
+int VendingMachine::getNumQueue() const {
+	return numQueue;
+}
+
+const Item& VendingMachine::getItem(int index) const {
+	if (index < 0 || index >= numQueue) {
+		throw out_of_range ("Invalid item index!");
+	}
+	return itemArray[index];
+}
+
+int VendingMachine::getTotalStock() const {
+	return totalStock;
+}
+
+double VendingMachine::getTotalMoney() const {
+	return totalMoney;
+}
+
+string VendingMachine::getTitle() const {
+	return machineTitle;
+}
+
+int VendingMachine::sellItem(int itemOpt, double totalPaid, double &change) {
+	change = 0.0;
+	
+	if (itemOpt < 1 || itemOpt > numQueue) {
+		return SALE_INVALID_ITEM;
+	}
+	
+	if (getAvailableStock(itemOpt) <= 0) {
+		return SALE_OUT_OF_STOCK; //empty, or every unit left is held for another customer
+	}
+	
+	return completeSale(itemOpt, getCurrentPrice(itemOpt), totalPaid, change);
+}
 
+int VendingMachine::completeSale(int itemOpt, double price, double totalPaid, double &change, bool cash) {
+	Item& selected = itemArray[itemOpt - 1];
+	
+	if (selected.isItemQEmpty()) {
+		return SALE_OUT_OF_STOCK; //a held unit can still be purged when its lot expires
+	}
+	if (totalPaid < price) {
+		return SALE_INSUFFICIENT;
+	}
+	
+	//check if change can be provided, a cashless payment is for the price only
+	change = cash ? totalPaid - price : 0.0;
+	if (change > totalMoney) {
+		recordSale(itemOpt, price, totalPaid, change, SALE_RECORD_NO_CHANGE);
+		change = 0.0;
+		return SALE_NO_CHANGE;
+	}
+	
+	//the machine keeps the price, the rest goes back to the customer as change
+	if (cash) {
+		totalMoney += price;
+	}
+	else {
+		cashlessRevenue += price;
+	}
+	itemSold[itemOpt - 1]++;
+	itemRevenue[itemOpt - 1] += price;
+	unitsSold++;
+	totalRevenue += price;
+	if (fleet) {
+		fleet->addSale(price, cash);
+	}
+	mirrorCash();
+	if (planner) {
+		planner->recordSale(plannerMachine, itemOpt, time(NULL));
+	}
+	
+	//items bought close together count towards a bundle
+	long long now = time(NULL);
+	if (now - basketTime > (long long)PricingEngine::BUNDLE_WINDOW) {
+		basketMask = 0;
+	}
+	if (itemOpt <= 32) {
+		basketMask |= 1u << (itemOpt - 1);
+	}
+	basketTime = now;
+	recordSale(itemOpt, price, totalPaid, change, SALE_RECORD_OK);
+	
+	//update item stock, the item reports the change to stockChanged()
+	Item item;
+	selected.removeStockFromQ(item);
+	if (cash) {
+		postEvent(MACHINE_CASH_CHANGED, 0);
+	}
+	
+	return SALE_OK;
+}
+
+int VendingMachine::restockItem(int itemOpt, int stock, long long expiry) {
+	if (itemOpt < 1 || itemOpt > numQueue || stock <= 0) {
+		return 0;
+	}
+	
+	Item& item = itemArray[itemOpt - 1];
+	int space = item.getMaxSize() - item.getNumStockQ();
+	int addedCount = item.addStockToQ(stock < space ? stock : space, expiry); //never overflow, so no queue full message
+	
+	if (addedCount > 0) {
+		expiryIndex->add(expiry, this, itemOpt);
+	}
+
+	return addedCount;
+}
+
+bool VendingMachine::setItemPrice(int itemOpt, double price) {
+	if (itemOpt < 1 || itemOpt > numQueue || price <= 0) {
+		return false;
+	}
+
+	itemArray[itemOpt - 1].setPrice(price);
+	return true;
+}
+
+bool VendingMachine::setItemDepth(int itemOpt, int depth) {
+	if (itemOpt < 1 || itemOpt > numQueue || !itemArray[itemOpt - 1].setDepth(depth)) {
+		return false;
+	}
+
+	mirrorSlot(itemOpt);
+	if (planner) {
+		planner->setStock(plannerMachine, itemOpt, itemArray[itemOpt - 1].getNumStockQ(), depth);
+	}
+	postEvent(MACHINE_STOCK_CHANGED, itemOpt); //carries the new capacity
+	return true;
+}
+
+bool VendingMachine::addMoney(double amount) {
+	if (amount <= 0) {
+		return false;
+	}
+
+	changeMoney(amount);
+	return true;
+}
+
+int VendingMachine::clearItem(int itemOpt) {
+	if (itemOpt < 1 || itemOpt > numQueue) {
+		return 0;
+	}
+	
+	int removed = itemArray[itemOpt - 1].getNumStockQ();
+	itemArray[itemOpt - 1].clearItemQ(); //the item reports its own stock change
+	return removed;
+}
+
+//-----------------------------------------------------------------reservations-----------------------------------------------------------------
+long long VendingMachine::reserveItem(int itemOpt, unsigned long now, unsigned long holdMs) {
+	expireHolds(now); //units from abandoned holds become available first
+	
+	if (getAvailableStock(itemOpt) <= 0) {
+		return -1;
+	}
+	
+	int index;
+	if (!freeHolds.empty()) {
+		index = freeHolds.back();
+		freeHolds.pop_back();
+	}
+	else {
+		index = (int)holds.size();
+		Hold h;
+		h.generation = 0;
+		holds.push_back(h);
+	}
+	
+	Hold& h = holds[index];
+	h.itemOpt = itemOpt;
+	h.price = getCurrentPrice(itemOpt);
+	h.timer = holdTimers.schedule(holdMs, index);
+	itemReserved[itemOpt - 1]++;
+	
+	return ((long long)h.generation << 32) | index;
+}
+
+bool VendingMachine::releaseItem(long long holdId) {
+	int index = findHold(holdId);
+	
+	if (index < 0) {
+		return false;
+	}
+	
+	Hold& h = holds[index];
+	holdTimers.cancel(h.timer);
+	itemReserved[h.itemOpt - 1]--;
+	h.itemOpt = 0;
+	h.generation++;
+	freeHolds.push_back(index);
+	
+	return true;
+}
+
+int VendingMachine::sellReserved(long long holdId, double totalPaid, double &change) {
+	int index = findHold(holdId);
+	change = 0.0;
+	
+	if (index < 0) {
+		return SALE_HOLD_EXPIRED;
+	}
+	
+	int itemOpt = holds[index].itemOpt;
+	double price = holds[index].price;
+	if (totalPaid < price) {
+		return SALE_INSUFFICIENT; //keep holding, the customer may still add money
+	}
+	
+	//the held unit goes back to the pool and is sold straight away at the held price
+	releaseItem(holdId);
+	return completeSale(itemOpt, price, totalPaid, change);
+}
+
+int VendingMachine::sellCashless(long long holdId, int itemOpt, double authorized) {
+	double change;
+	int index = findHold(holdId);
+	
+	if (index < 0) {
+		//the hold ran out while the payment was authorized, any free unit will do at the price that was captured
+		if (itemOpt < 1 || itemOpt > numQueue) {
+			return SALE_INVALID_ITEM;
+		}
+		if (getAvailableStock(itemOpt) <= 0) {
+			return SALE_OUT_OF_STOCK;
+		}
+		return completeSale(itemOpt, authorized, authorized, change, false);
+	}
+	
+	itemOpt = holds[index].itemOpt;
+	double price = holds[index].price;
+	if (authorized < price) {
+		return SALE_INSUFFICIENT;
+	}
+	
+	releaseItem(holdId);
+	return completeSale(itemOpt, authorized, authorized, change, false);
+}
+
+double VendingMachine::getCashlessRevenue() const {
+	return cashlessRevenue;
+}
+
+int VendingMachine::expireHolds(unsigned long now) {
+	vector<int> expired;
+	holdTimers.advance(now, expired);
+	
+	for (size_t i = 0; i < expired.size(); i++) {
+		Hold& h = holds[expired[i]];
+		itemReserved[h.itemOpt - 1]--;
+		h.itemOpt = 0;
+		h.generation++;
+		freeHolds.push_back(expired[i]);
+	}
+	return (int)expired.size();
+}
+
+int VendingMachine::getAvailableStock(int itemOpt) const {
+	if (itemOpt < 1 || itemOpt > numQueue) {
+		return 0;
+	}
+	return itemArray[itemOpt - 1].getNumStockQ() - itemReserved[itemOpt - 1];
+}
+
+double VendingMachine::getHoldPrice(long long holdId) const {
+	int index = findHold(holdId);
+	return (index < 0) ? 0.0 : holds[index].price;
+}
+
+int VendingMachine::findHold(long long holdId) const {
+	int index = (int)(holdId & 0xFFFFFFFFLL);
+	unsigned int generation = (unsigned int)(holdId >> 32);
+	
+	if (holdId < 0 || index >= (int)holds.size() || holds[index].itemOpt == 0 || holds[index].generation != generation) {
+		return -1;
+	}
+	return index;
+}
+
+//-----------------------------------------------------------------catalog hot-reload-----------------------------------------------------------------
+void VendingMachine::attachCatalog(CatalogWatcher* watcher) {
+	if (catalog) {
+		catalog->unregisterReader(catalogReader);
+	}
+	
+	catalog = watcher;
+	catalogReader = catalog->registerReader();
+	catalogVersion = 0;
+	catalogApplied.clear(); //every line is new to this machine
+	syncCatalog();
+}
+
+bool VendingMachine::syncCatalog() {
+	//cheap check first, most calls find nothing new
+	if (catalog == nullptr || catalog->getVersion() == catalogVersion) {
+		return false;
+	}
+	
+	const Catalog* c = catalog->enter(catalogReader);
+	if (c == nullptr) {
+		catalog->exit(catalogReader);
+		return false;
+	}
+	
+	beginUpdate(); //readers see the whole reload in one version
+	if (!c->title.empty() && c->title != machineTitle) {
+		changeTitle(c->title);
+	}
+	
+	//only what the file changed since the last version, so edits from the menu, the server
+	//or a batch survive a reload that does not touch them. Lines are matched to slots by
+	//item name: a slot plan moves items around and may give one item several slots.
+	for (int i = 0; i < (int)c->entries.size(); i++) {
+		const CatalogEntry& entry = c->entries[i];
+		const CatalogEntry* before = findEntry(catalogApplied, entry.name);
+		
+		//a new name where the old line's name is gone is that item renamed
+		if (before == nullptr && i < (int)catalogApplied.size() && findEntry(c->entries, catalogApplied[i].name) == nullptr) {
+			before = &catalogApplied[i];
+		}
+		
+		//existing slots keep their stock, every slot of the item is updated
+		const string& current = (before != nullptr) ? before->name : entry.name;
+		bool found = false;
+		for (int s = 0; s < numQueue; s++) {
+			if (itemArray[s].getName() != current) {
+				continue;
+			}
+			found = true;
+			if (before == nullptr || entry.name != before->name) {
+				itemArray[s].setName(entry.name);
+			}
+			if (before == nullptr || entry.price != before->price) {
+				itemArray[s].setPrice(entry.price);
+			}
+			if (entry.depth > 0 && (before == nullptr || entry.depth != before->depth)) {
+				setItemDepth(s + 1, entry.depth); //kept if the stock would not fit
+			}
+		}
+		
+		//an item new to the catalog fills an empty slot
+		if (!found && before == nullptr && !isFull()) {
+			addItem(Item(entry.name, entry.price, entry.stock, (entry.depth > 0) ? entry.depth : Item().getMaxSize()));
+		}
+	}
+	catalogVersion = c->version;
+	catalogApplied = c->entries;
+	endUpdate();
+	
+	catalog->exit(catalogReader); //c must not be used after this
+	return true;
+}
+
+const CatalogEntry* VendingMachine::findEntry(const vector<CatalogEntry>& entries, const string& name) {
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].name == name) {
+			return &entries[i];
+		}
+	}
+	return nullptr;
+}
+
+//-----------------------------------------------------------------perishable stock-----------------------------------------------------------------
+void VendingMachine::setExpiryIndex(ExpiryIndex* index) {
+	expiryIndex->removeTarget(this); //the new index takes over every lot
+	expiryIndex = (index != nullptr) ? index : &ownExpiry;
+	
+	//index the lots already in the machine
+	for (int i = 1; i <= numQueue; i++) {
+		indexLots(i);
+	}
+}
+
+void VendingMachine::indexLots(int itemOpt) {
+	vector<Lot> lots;
+	itemArray[itemOpt - 1].getLots(lots);
+	for (size_t i = 0; i < lots.size(); i++) {
+		expiryIndex->add(lots[i].expiry, this, itemOpt);
+	}
+}
+
+int VendingMachine::sweepExpired(long long now) {
+	return expiryIndex->sweep(now);
+}
+
+int VendingMachine::purgeSlot(int itemOpt, long long now) {
+	if (itemOpt < 1 || itemOpt > numQueue) {
+		return 0;
+	}
+	
+	int removed = itemArray[itemOpt - 1].purgeExpired(now);
+	expiredUnits += removed;
+	return removed;
+}
+
+int VendingMachine::getExpiredUnits() const {
+	return expiredUnits;
+}
+
+//-----------------------------------------------------------------aggregates-----------------------------------------------------------------
+void VendingMachine::stockChanged(int itemOpt, int delta) {
+	totalStock += delta;
+	if (fleet) {
+		fleet->addStock(delta);
+	}
+	if (stockMirror && itemOpt >= 1 && itemOpt <= numQueue) {
+		stockMirror->setCount(stockMirror->getFirstRow(mirrorMachine) + itemOpt - 1, itemArray[itemOpt - 1].getNumStockQ());
+	}
+	if (planner && itemOpt >= 1 && itemOpt <= numQueue) {
+		planner->setStock(plannerMachine, itemOpt, itemArray[itemOpt - 1].getNumStockQ(), itemArray[itemOpt - 1].getMaxSize());
+	}
+	
+	//a sale updates money and counts first, so this publish shows the whole sale at once
+	refreshSlot(itemOpt);
+	publishState();
+	postEvent(MACHINE_STOCK_CHANGED, itemOpt);
+	
+	if (alerts == nullptr || itemOpt < 1 || itemOpt > numQueue) {
+		return;
+	}
+	
+	//only a change that crosses a threshold raises an alert, so each costs two compares
+	int after = itemArray[itemOpt - 1].getNumStockQ();
+	int before = after - delta;
+	int threshold = lowThreshold[itemOpt - 1];
+	
+	if (after == 0 && before > 0) {
+		postAlert(ALERT_SOLD_OUT, itemOpt, after);
+	}
+	else if (after <= threshold && before > threshold) {
+		postAlert(ALERT_LOW_STOCK, itemOpt, after);
+	}
+	else if (after > threshold && before <= threshold) {
+		postAlert(ALERT_RESTOCKED, itemOpt, after);
+	}
+}
+
+void VendingMachine::changeMoney(double amount) {
+	totalMoney += amount;
+	if (fleet) {
+		fleet->addMoney(amount);
+	}
+	mirrorCash();
+	publishState();
+	postEvent(MACHINE_CASH_CHANGED, 0);
+}
+
+MachineTotals VendingMachine::getTotals() const {
+	MachineTotals t;
+	t.machines = 1;
+	t.stock = totalStock;
+	t.money = totalMoney;
+	t.sold = unitsSold;
+	t.revenue = totalRevenue;
+	return t;
+}
+
+int VendingMachine::getItemSold(int itemOpt) const {
+	if (itemOpt < 1 || itemOpt > numQueue) {
+		return 0;
+	}
+	return itemSold[itemOpt - 1];
+}
+
+double VendingMachine::getItemRevenue(int itemOpt) const {
+	if (itemOpt < 1 || itemOpt > numQueue) {
+		return 0.0;
+	}
+	return itemRevenue[itemOpt - 1];
+}
+
+void VendingMachine::setFleet(FleetAggregate* f) {
+	if (fleet) {
+		fleet->leave(getTotals());
+	}
+	fleet = f;
+	if (fleet) {
+		fleet->join(getTotals());
+	}
+}
+
+//-----------------------------------------------------------------sales history-----------------------------------------------------------------
+void VendingMachine::setHistory(SalesHistory* h, int id) {
+	history = h;
+	machineId = id;
+}
+
+void VendingMachine::recordSale(int itemOpt, double price, double totalPaid, double change, int status) {
+	if (history == nullptr) {
+		return;
+	}
+	
+	SaleRecord r;
+	r.time = time(NULL);
+	r.machine = machineId;
+	r.slot = itemOpt;
+	r.priceCents = (int)floor(price * 100 + 0.5);
+	r.tenderedCents = (int)floor(totalPaid * 100 + 0.5);
+	r.changeCents = (int)floor(change * 100 + 0.5);
+	r.status = status;
+	history->record(r);
+}
+
+void VendingMachine::printSalesReport(long long from, long long to) {
+	if (history == nullptr) {
+		cout << "NO SALES HISTORY KEPT\n";
+		return;
+	}
+	
+	cout << "SALES REPORT (" << history->size() << " RECORDS)\n";
+	cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
+	cout << left << setw(15) << "Units Sold" << ": " << history->getUnitsSold(from, to, machineId) << endl;
+	cout << left << setw(15) << "Revenue" << ": " << fixed << setprecision(2) << history->getRevenueCents(from, to, machineId) / 100.0 << endl;
+	cout << left << setw(15) << "No Change" << ": " << fixed << setprecision(1) << history->getChangeFailureRate(from, to, machineId) * 100 << "% of sales\n";
+	
+	//best selling items
+	vector<SlotSales> top;
+	history->getTopSellers(from, to, machineId, 5, top);
+	cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
+	cout << "TOP SELLERS\n";
+	for (size_t i = 0; i < top.size(); i++) {
+		string name = (top[i].slot <= numQueue) ? getItemName(itemArray[top[i].slot - 1]) : "Slot";
+		cout << left << setw(15) << name << ": " << top[i].units << " sold, RM " << fixed << setprecision(2) << top[i].revenueCents / 100.0 << endl;
+	}
+	
+	//revenue per item for every hour of the day that had sales
+	vector<long long> cents;
+	history->getRevenueByItemHour(from, to, machineId, numQueue, cents);
+	cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
+	cout << "REVENUE PER HOUR (RM)\n";
+	cout << left << setw(6) << "Hour";
+	for (int i = 0; i < numQueue; i++) {
+		cout << right << setw(11) << getItemName(itemArray[i]).substr(0, 10);
+	}
+	cout << endl;
+	for (int hour = 0; hour < 24; hour++) {
+		long long hourTotal = 0;
+		for (int i = 0; i < numQueue; i++) {
+			hourTotal += cents[i * 24 + hour];
+		}
+		if (hourTotal == 0) {
+			continue;
+		}
+		
+		cout << right << setw(2) << setfill('0') << hour << ":00" << setfill(' ') << " ";
+		for (int i = 0; i < numQueue; i++) {
+			cout << right << setw(11) << fixed << setprecision(2) << cents[i * 24 + hour] / 100.0;
+		}
+		cout << endl;
+	}
+	cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl << endl;
+}
+
+void VendingMachine::salesReport() {
+	int days;    //length of the report period
+	char exit;   //variable to store user's exit choice
+	
+	cout << "Report Period in Days (0 = all): ";
+	while (!readInt(days) || days < 0) {
+		cout << "INVALID NUMBER OF DAYS\n";
+		cout << "Report Period in Days (0 = all): ";
+	}
+	
+	long long to = time(NULL) + 1;
+	long long from = (days > 0) ? to - days * 86400LL : 0;
+	
+	reset();
+	printSalesReport(from, to);
+	
+	do {
+		cout << "Return to Admin Menu (Y): ";
+		exit = readYesNo();
+		
+		if (exit != 'Y') {
+			cout << "PLEASE ENTER 'Y' TO EXIT\n\n";
+		}
+	} while (exit != 'Y');
+	
+	reset();
+}
+
+//-----------------------------------------------------------------stock alerts-----------------------------------------------------------------
+void VendingMachine::setAlerts(AlertQueue* queue) {
+	alerts = queue;
+}
+
+bool VendingMachine::setLowStockThreshold(int itemOpt, int threshold) {
+	if (itemOpt < 1 || itemOpt > numQueue || threshold < 0) {
+		return false;
+	}
+	
+	lowThreshold[itemOpt - 1] = threshold;
+	return true;
+}
+
+int VendingMachine::getLowStockThreshold(int itemOpt) const {
+	if (itemOpt < 1 || itemOpt > numQueue) {
+		return 0;
+	}
+	return lowThreshold[itemOpt - 1];
+}
+
+void VendingMachine::postAlert(int type, int itemOpt, int stock) {
+	StockAlert a;
+	a.type = type;
+	a.machine = machineId;
+	a.slot = itemOpt;
+	a.stock = stock;
+	a.time = time(NULL);
+	alerts->post(a);
+}
+
+//-----------------------------------------------------------------stock mirror-----------------------------------------------------------------
+void VendingMachine::setFleetStock(FleetStock* mirror) {
+	if (stockMirror) {
+		stockMirror->removeMachine(mirrorMachine);
+	}
+	stockMirror = mirror;
+	mirrorMachine = -1;
+	
+	if (stockMirror) {
+		//rows for every slot the machine can hold, slots added later fill their row
+		mirrorMachine = stockMirror->addMachine(itemArraySize);
+		for (int i = 1; i <= numQueue; i++) {
+			mirrorSlot(i);
+		}
+		mirrorCash();
+	}
+}
+
+void VendingMachine::mirrorSlot(int itemOpt) {
+	if (stockMirror == nullptr) {
+		return;
+	}
+	
+	const Item& item = itemArray[itemOpt - 1];
+	stockMirror->setSlot(stockMirror->getFirstRow(mirrorMachine) + itemOpt - 1, item.getNumStockQ(),
+		item.getMaxSize(), (int)floor(item.getPrice() * 100 + 0.5));
+}
+
+void VendingMachine::mirrorCash() {
+	if (stockMirror) {
+		stockMirror->setCash(mirrorMachine, (int)floor(totalMoney * 100 + 0.5));
+	}
+}
+
+void VendingMachine::priceChanged(int itemOpt, double price) {
+	if (stockMirror && itemOpt >= 1 && itemOpt <= numQueue) {
+		stockMirror->setPrice(stockMirror->getFirstRow(mirrorMachine) + itemOpt - 1, (int)floor(price * 100 + 0.5));
+	}
+	refreshSlot(itemOpt);
+	publishState();
+	postEvent(MACHINE_PRICE_CHANGED, itemOpt);
+}
+
+//-----------------------------------------------------------------restock planner-----------------------------------------------------------------
+void VendingMachine::setPlanner(RestockPlanner* p) {
+	if (planner) {
+		planner->removeMachine(plannerMachine);
+	}
+	planner = p;
+	plannerMachine = -1;
+	
+	if (planner) {
+		plannerMachine = planner->addMachine(itemArraySize);
+		for (int i = 0; i < numQueue; i++) {
+			planner->setStock(plannerMachine, i + 1, itemArray[i].getNumStockQ(), itemArray[i].getMaxSize());
+		}
+	}
+}
+
+int VendingMachine::getFillList(vector<FillLine>& out) {
+	if (planner == nullptr) {
+		return 0;
+	}
+	return planner->getFillList(plannerMachine, out);
+}
+
+void VendingMachine::restockByPlan() {
+	vector<FillLine> lines;
+	char confirmation; //variable to store users confirmation choice
+	
+	if (planner == nullptr) {
+		cout << "\t\t\t\t   NO RESTOCK PLANNER\n\n";
+		return;
+	}
+	planner->recompute(time(NULL)); //pick up the latest sales before showing the plan
+	int units = getFillList(lines);
+	
+	if (lines.empty()) {
+		cout << "\t\t\t    !!!ALL ITEMS ARE STOCKED TO PLAN!!!\n\n";
+		return;
+	}
+	
+	cout << "RESTOCK PLAN\n";
+	cout << setw(55) << setfill('-') << "-" << setfill(' ') << endl;
+	cout << left << setw(15) << "Item" << right << setw(8) << "Stock" << setw(8) << "Depth" << setw(8) << "Fill" << setw(14) << "Sales/Hour" << endl;
+	for (size_t i = 0; i < lines.size(); i++) {
+		cout << left << setw(15) << getItemName(itemArray[lines[i].slot - 1]) << right << setw(8) << lines[i].stock
+			 << setw(8) << lines[i].depth << setw(8) << lines[i].fill << setw(14) << fixed << setprecision(2) << lines[i].rate << endl;
+	}
+	cout << setw(55) << setfill('-') << "-" << setfill(' ') << endl;
+	cout << left << setw(15) << "Units to Add" << ": " << units << endl << endl;
+	
+	cout << "Apply Restock Plan? (Y/N): ";
+	confirmation = readYesNo();
+	reset();
+	
+	if (confirmation == 'Y') {
+		int added = 0;
+		for (size_t i = 0; i < lines.size(); i++) {
+			added += restockItem(lines[i].slot, lines[i].fill);
+		}
+		cout << "\t\t\t    !!!" << added << " UNITS ADDED FROM PLAN!!!\n\n";
+	}
+	else {
+		cout << "\t\t\t    !!!RESTOCK PLAN NOT APPLIED!!!\n\n";
+	}
+}
+
+void VendingMachine::replanSlots() {
+	char confirmation; //variable to store users confirmation choice
+	
+	if (planner == nullptr) {
+		cout << "\t\t\t\t   NO RESTOCK PLANNER\n\n";
+		return;
+	}
+	
+	//sales rates come from the restock planner
+	long long now = time(NULL);
+	vector<double> rates(numQueue);
+	for (int i = 0; i < numQueue; i++) {
+		rates[i] = planner->getRate(plannerMachine, i + 1, now);
+	}
+	Planogram plan;
+	fillPlanogram(plan, rates);
+	PlanogramOptimizer().solve(plan);
+	PlanogramOptimizer::printPlan(plan, cout);
+	cout << endl;
+	
+	cout << "Apply Slot Plan? (Y/N): ";
+	confirmation = readYesNo();
+	reset();
+	
+	if (confirmation == 'Y') {
+		int removed = applyPlanogram(plan);
+		if (removed < 0) {
+			cout << "\t\t\t!!!A CUSTOMER IS PAYING, TRY AGAIN LATER!!!\n\n";
+		}
+		else {
+			cout << "\t\t\t    !!!SLOTS REARRANGED, " << removed << " UNITS TO TAKE OUT!!!\n\n";
+		}
+	}
+	else {
+		cout << "\t\t\t    !!!SLOT PLAN NOT APPLIED!!!\n\n";
+	}
+}
+
+//-----------------------------------------------------------------slot planning-----------------------------------------------------------------
+void VendingMachine::fillPlanogram(Planogram& p, const vector<double>& slotRates) const {
+	p.machine = machineId;
+	p.items.clear();
+	p.slots.clear();
+	p.hoursBefore = -1.0;
+	p.hours = -1.0;
+	
+	//an item in several slots is one item with several facings
+	for (int i = 0; i < itemArraySize; i++) {
+		PlanSlot slot = { Item().getMaxSize(), -1 }; //empty slots take the default depth
+		if (i < numQueue) {
+			const Item& item = itemArray[i];
+			int k = p.findItem(item.getName());
+			if (k < 0) {
+				PlanItem added = { item.getName(), item.getPrice(), 0.0, 0 };
+				p.items.push_back(added);
+				k = (int)p.items.size() - 1;
+			}
+			p.items[k].rate += (i < (int)slotRates.size()) ? slotRates[i] : 0.0;
+			p.items[k].facings++;
+			slot.depth = item.getMaxSize();
+			slot.item = k;
+		}
+		p.slots.push_back(slot);
+	}
+}
+
+int VendingMachine::applyPlanogram(const Planogram& p) {
+	int numItems = (int)p.items.size();
+	int used = 0;
+	
+	//filled slots first, at least as many as now, and nobody holding a unit
+	while (used < (int)p.slots.size() && p.slots[used].item >= 0) {
+		used++;
+	}
+	if ((int)p.slots.size() > itemArraySize || used < numQueue) {
+		return -1;
+	}
+	for (int s = 0; s < (int)p.slots.size(); s++) {
+		if ((s >= used && p.slots[s].item >= 0) || p.slots[s].item >= numItems || p.slots[s].depth <= 0) {
+			return -1;
+		}
+	}
+	for (int i = 0; i < numQueue; i++) {
+		if (itemReserved[i] > 0) {
+			return -1;
+		}
+	}
+	
+	//take every unit out, grouped by item; nobody hears about it until the new layout is complete
+	long long now = time(NULL);
+	vector<vector<Lot> > lots(numItems);
+	vector<Lot> unplanned;
+	vector<int> sold(numItems, 0), threshold(numItems, (int)DEFAULT_LOW_STOCK), facings(numItems, 0);
+	vector<double> revenue(numItems, 0.0), rate(numItems, 0.0);
+	int before = totalStock;
+	
+	for (int s = 0; s < used; s++) {
+		facings[p.slots[s].item]++;
+	}
+	
+	for (int i = 0; i < numQueue; i++) {
+		Item& item = itemArray[i];
+		int k = p.findItem(item.getName());
+		item.setListener(nullptr, i + 1);
+		item.takeLots(k >= 0 ? lots[k] : unplanned);
+		if (k >= 0) {
+			sold[k] += itemSold[i];
+			revenue[k] += itemRevenue[i];
+			threshold[k] = lowThreshold[i];
+			rate[k] += planner ? planner->getRate(plannerMachine, i + 1, now) : 0.0;
+		}
+	}
+	for (int k = 0; k < numItems; k++) {
+		//lots that expire first are sold first, lots that never expire last
+		stable_sort(lots[k].begin(), lots[k].end(), [](const Lot& a, const Lot& b) {
+			return a.expiry != 0 && (b.expiry == 0 || a.expiry < b.expiry);
+		});
+	}
+	
+	//refill the slots in their new order, facings of an item fill one after another
+	vector<size_t> next(numItems, 0);
+	vector<bool> first(numItems, true);
+	for (int s = 0; s < used; s++) {
+		int k = p.slots[s].item;
+		const PlanItem& planned = p.items[k];
+		
+		if (s < numQueue) {
+			itemArray[s].setDepth(p.slots[s].depth);
+			itemArray[s].setName(planned.name);
+			itemArray[s].setPrice(planned.price);
+		}
+		else {
+			itemArray[s] = Item(planned.name, planned.price, 0, p.slots[s].depth);
+			itemArray[s].setListener(nullptr, s + 1);
+			itemArray[s].setMemoryAccount(memoryAccount);
+		}
+		
+		int space = p.slots[s].depth;
+		while (space > 0 && next[k] < lots[k].size()) {
+			Lot& lot = lots[k][next[k]];
+			int moved = itemArray[s].addStockToQ(min(space, lot.quantity), lot.expiry);
+			lot.quantity -= moved;
+			space -= moved;
+			if (lot.quantity == 0) {
+				next[k]++;
+			}
+		}
+		
+		itemSold[s] = first[k] ? sold[k] : 0; //counts stay with the first facing
+		itemRevenue[s] = first[k] ? revenue[k] : 0.0;
+		lowThreshold[s] = threshold[k];
+		first[k] = false;
+	}
+	
+	//whatever did not fit goes back to the operator
+	int removed = 0;
+	for (size_t i = 0; i < unplanned.size(); i++) {
+		removed += unplanned[i].quantity;
+	}
+	for (int k = 0; k < numItems; k++) {
+		for (size_t i = next[k]; i < lots[k].size(); i++) {
+			removed += lots[k][i].quantity;
+		}
+	}
+	numQueue = used;
+	
+	//everyone sees the new layout at once, in one published version
+	totalStock = 0;
+	for (int s = 0; s < numQueue; s++) {
+		totalStock += itemArray[s].getNumStockQ();
+	}
+	if (fleet) {
+		fleet->addStock(totalStock - before);
+	}
+	for (int s = 0; s < numQueue; s++) {
+		Item& item = itemArray[s];
+		int k = p.slots[s].item;
+		item.setListener(this, s + 1);
+		indexLots(s + 1); //the entries of the old layout point at other slots now
+		mirrorSlot(s + 1);
+		if (planner) {
+			planner->setRate(plannerMachine, s + 1, rate[k] / facings[k], now); //facings share the sales
+			planner->setStock(plannerMachine, s + 1, item.getNumStockQ(), item.getMaxSize());
+		}
+		refreshSlot(s + 1);
+	}
+	publishState();
+	for (int s = 1; s <= numQueue; s++) {
+		postEvent(MACHINE_NAME_CHANGED, s);
+		postEvent(MACHINE_PRICE_CHANGED, s);
+		postEvent(MACHINE_STOCK_CHANGED, s);
+	}
+	
+	return removed;
+}
+
+//-----------------------------------------------------------------dynamic pricing-----------------------------------------------------------------
+void VendingMachine::setPricing(PricingEngine* engine) {
+	pricing = engine;
+}
+
+double VendingMachine::getCurrentPrice(int itemOpt) {
+	const Item& item = itemArray[itemOpt - 1];
+	if (pricing == nullptr) {
+		return item.getPrice();
+	}
+	
+	//only look up what the slot's rules use
+	PriceContext c;
+	int needs = pricing->getNeeds(itemOpt);
+	c.now = time(NULL);
+	c.nextExpiry = (needs & NEEDS_EXPIRY) ? item.getNextExpiry() : 0;
+	c.salesRate = (needs & NEEDS_RATE) && planner ? planner->getRate(plannerMachine, itemOpt, c.now) : 0.0;
+	c.basket = (c.now - basketTime <= (long long)PricingEngine::BUNDLE_WINDOW) ? basketMask : 0;
+	
+	return pricing->evaluate(itemOpt, item.getPrice(), c);
+}
+
+//-----------------------------------------------------------------versioned state-----------------------------------------------------------------
+void VendingMachine::refreshSlot(int itemOpt) {
+	if (itemOpt < 1 || itemOpt > numQueue) {
+		return;
+	}
+	
+	MemoryScope scope(memoryAccount, MEM_STATE);
+	const Item& item = itemArray[itemOpt - 1];
+	state.setSlot(itemOpt - 1, item.getName(), item.getPrice(), item.getNumStockQ(), itemSold[itemOpt - 1], itemRevenue[itemOpt - 1]);
+}
+
+void VendingMachine::publishState() {
+	if (updateDepth > 0) {
+		statePending = true; //endUpdate() publishes once for the whole update
+		return;
+	}
+	
+	MemoryScope scope(memoryAccount, MEM_STATE);
+	state.setTitle(machineTitle);
+	state.setTotals(getTotals());
+	state.publish();
+}
+
+void VendingMachine::nameChanged(int itemOpt) {
+	refreshSlot(itemOpt);
+	publishState();
+	postEvent(MACHINE_NAME_CHANGED, itemOpt);
+}
+
+void VendingMachine::beginUpdate() {
+	updateDepth++;
+}
+
+void VendingMachine::endUpdate() {
+	if (updateDepth == 0 || --updateDepth > 0) {
+		return;
+	}
+	
+	if (statePending) {
+		statePending = false;
+		publishState();
+	}
+	for (int slot = 0; slot <= itemArraySize; slot++) {
+		int mask = pendingEvents[slot];
+		pendingEvents[slot] = 0;
+		for (int type = 0; mask != 0; type++, mask >>= 1) {
+			if (mask & 1) {
+				postEvent(type, slot);
+			}
+		}
+	}
+}
+
+int VendingMachine::registerSnapshotReader() {
+	return state.registerReader();
+}
+
+void VendingMachine::unregisterSnapshotReader(int reader) {
+	state.unregisterReader(reader);
+}
+
+const MachineVersion* VendingMachine::enterSnapshot(int reader) {
+	return state.enter(reader);
+}
+
+void VendingMachine::exitSnapshot(int reader) {
+	state.exit(reader);
+}
+
+int VendingMachine::getOwnReader() const {
+	return stateReader;
+}
+
+//-----------------------------------------------------------------events-----------------------------------------------------------------
+void VendingMachine::postEvent(int type, int itemOpt) {
+	if (!events.hasSubscribers(type)) {
+		return;
+	}
+	if (updateDepth > 0) {
+		pendingEvents[(itemOpt >= 1 && itemOpt <= numQueue) ? itemOpt : 0] |= 1 << type; //events carry the slot as it is when sent
+		return;
+	}
+	
+	MemoryScope scope(memoryAccount, MEM_EVENTS, itemOpt);
+	MachineEvent e;
+	string name;
+	e.type = type;
+	e.machine = machineId;
+	e.slot = 0;
+	e.stock = 0;
+	e.capacity = 0;
+	e.value = totalMoney;
+	e.text = machineTitle.c_str();
+	
+	if (itemOpt >= 1 && itemOpt <= numQueue) {
+		const Item& item = itemArray[itemOpt - 1];
+		name = item.getName();
+		e.slot = itemOpt;
+		e.stock = item.getNumStockQ();
+		e.capacity = item.getMaxSize();
+		e.value = item.getPrice();
+		e.text = name.c_str();
+	}
+	events.publish(e);
+}
+
+void VendingMachine::changeTitle(const string& title) {
+	machineTitle = title;
+	publishState();
+	postEvent(MACHINE_TITLE_CHANGED, 0);
+}
+
+void VendingMachine::subscribe(EventSubscriber* s, int mask) {
+	events.subscribe(s, mask);
+}
+
+void VendingMachine::unsubscribe(EventSubscriber* s) {
+	events.unsubscribe(s);
+}
+
+//-----------------------------------------------------------------persistence-----------------------------------------------------------------
+/*
+ * One line per field, names last so they may contain spaces:
+ *   TITLE <title>
+ *   CASH <money> <cashless revenue>
+ *   SOLD <units> <revenue>
+ *   ITEM <price> <depth> <low stock threshold> <sold> <revenue> <name>
+ *   LOT <units> <expiry>          lots of the item above, oldest first
+ *   END
+ */
+void VendingMachine::saveState(ostream& out) const {
+	out << fixed << setprecision(2);
+	out << "TITLE " << machineTitle << '\n';
+	out << "CASH " << totalMoney << ' ' << cashlessRevenue << '\n';
+	out << "SOLD " << unitsSold << ' ' << totalRevenue << '\n';
+	
+	for (int i = 0; i < numQueue; i++) {
+		const Item& item = itemArray[i];
+		vector<Lot> lots;
+		item.getLots(lots);
+		
+		out << "ITEM " << item.getPrice() << ' ' << item.getMaxSize() << ' ' << lowThreshold[i] << ' '
+			<< itemSold[i] << ' ' << itemRevenue[i] << ' ' << item.getName() << '\n';
+		for (size_t l = 0; l < lots.size(); l++) {
+			out << "LOT " << lots[l].quantity << ' ' << lots[l].expiry << '\n';
+		}
+	}
+	out << "END\n";
+}
+
+bool VendingMachine::loadState(istream& in) {
+	if (numQueue != 0) {
+		return false;
+	}
+	
+	string line;
+	bool ended = false;
+	beginUpdate(); //readers see the machine once it is complete
+	
+	while (!ended && getline(in, line)) {
+		if (!line.empty() && line[line.length() - 1] == '\r') {
+			line.erase(line.length() - 1);
+		}
+		istringstream fields(line);
+		string key;
+		fields >> key;
+		
+		bool ok = true;
+		if (key == "TITLE") {
+			machineTitle = (line.length() > 6) ? line.substr(6) : "";
+		}
+		else if (key == "CASH") {
+			ok = (bool)(fields >> totalMoney >> cashlessRevenue);
+		}
+		else if (key == "SOLD") {
+			ok = (bool)(fields >> unitsSold >> totalRevenue);
+		}
+		else if (key == "ITEM") {
+			double price, revenue;
+			int depth, threshold, sold;
+			string name;
+			ok = (bool)(fields >> price >> depth >> threshold >> sold >> revenue) && getline(fields >> ws, name) &&
+				numQueue < itemArraySize && depth > 0 && threshold >= 0;
+			if (ok) {
+				addItem(Item(name, price, 0, depth));
+				lowThreshold[numQueue - 1] = threshold;
+				itemSold[numQueue - 1] = sold;
+				itemRevenue[numQueue - 1] = revenue;
+			}
+		}
+		else if (key == "LOT") {
+			int units;
+			long long expiry;
+			ok = (bool)(fields >> units >> expiry) && numQueue > 0 && units > 0 && restockItem(numQueue, units, expiry) == units;
+		}
+		else if (key == "END") {
+			ended = true;
+		}
+		else {
+			ok = key.empty(); //blank lines are fine
+		}
+		
+		if (!ok) {
+			endUpdate();
+			return false;
+		}
+	}
+	
+	for (int i = 1; i <= numQueue; i++) {
+		refreshSlot(i); //counters were set after the items reported in
+	}
+	publishState();
+	endUpdate();
+	return ended;
+}
+
+//-----------------------------------------------------------------memory-----------------------------------------------------------------
+int VendingMachine::getMemoryAccount() const {
+	return memoryAccount;
+}
+
+MemoryUsage VendingMachine::getMemoryUsage() const {
+	return MemoryRegistry::getUsage(memoryAccount);
+}
+
+void VendingMachine::printMemory() const {
+	MemoryUsage total = getMemoryUsage();
+	
+	cout << left << setw(15) << "Memory" << ": " << total.bytes << " bytes in " << total.blocks << " blocks\n";
+	if (memoryAccount == 0) {
+		cout << "  (no account left for this machine, the figures are every unattributed block)\n";
+	}
+	for (int s = 0; s < MEM_SUBSYSTEMS; s++) {
+		MemoryUsage u = MemoryRegistry::getUsage(memoryAccount, s);
+		if (u.blocks > 0) {
+			cout << left << setw(15) << string("  ") + MemoryRegistry::getSubsystemName(s) << ": " << u.bytes << " bytes\n";
+		}
+	}
+	for (int i = 0; i < numQueue && i < MemoryRegistry::MAX_SLOTS; i++) {
+		MemoryUsage u = MemoryRegistry::getSlotUsage(memoryAccount, i + 1);
+		cout << left << setw(15) << "  " + getItemName(itemArray[i]).substr(0, 13) << ": " << u.bytes << " bytes\n";
+	}
+	cout << setw(35) << setfill('-') << "-" << setfill(' ') << endl;
+}
+
+#endif